@@ -235,6 +235,26 @@ namespace ls
         {
         }
 
+        // creates an array without a buffer, isEmpty() is true for it
+        static SelfType makeEmpty() noexcept
+        {
+            return SelfType(EmptyTag{});
+        }
+
+        // takes ownership of a buffer of width() * height() * depth() elements, nullptr gives an empty array
+        static SelfType fromBuffer(std::unique_ptr<T[]>&& buffer) noexcept
+        {
+            SelfType arr(EmptyTag{});
+            arr.m_data = std::move(buffer);
+            return arr;
+        }
+
+        // leaves the array empty
+        std::unique_ptr<T[]> releaseBuffer() noexcept
+        {
+            return std::move(m_data);
+        }
+
         const T& operator() (size_t x, size_t y, size_t z) const
         {
             return m_data[index(x, y, z)];
@@ -330,8 +350,15 @@ namespace ls
         }
 
     private:
+        struct EmptyTag {};
+
         std::unique_ptr<T[]> m_data;
 
+        Array3(EmptyTag) noexcept :
+            m_data(nullptr)
+        {
+        }
+
         size_t index(size_t x, size_t y, size_t z) const
         {
             return x * (Depth * Height) + y * Depth + z;
@@ -3,3 +3,4 @@
 #include "Collisions/CollisionsUtil.h"
 #include "Collisions/Collisions2.h"
 #include "Collisions/Collisions3.h"
+#include "Collisions/FrustumCulling3.h"
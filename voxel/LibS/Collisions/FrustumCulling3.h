@@ -0,0 +1,185 @@
+#pragma once
+
+#include "../Shapes/Frustum3.h"
+#include "../Shapes/SphereArray3.h"
+#include "../Macros.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#define LS_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// Frustum tests of whole arrays of spheres, the visible ones are written as a compact list of indices.
+// All functions expect normalized planes, like the ones of Frustum3::fromMatrix after Plane3::normalize.
+// A sphere is visible unless it's entirely behind one of the planes.
+// The vector version computes the same distances in the same order as the scalar one,
+// so both give the same indices as long as the compiler doesn't contract
+// multiplications and additions (MSVC /fp:precise, -ffp-contract=off).
+
+namespace ls
+{
+    // number of spheres tested together by cullSpheres for floats
+    constexpr int frustumCullingLaneWidth()
+    {
+#if defined(LS_SIMD_AVX2)
+        return 8;
+#elif defined(LS_SIMD_SSE2)
+        return 4;
+#else
+        return 1;
+#endif
+    }
+
+    namespace detail
+    {
+        template <class T>
+        LS_FORCEINLINE bool isSphereInFrustum(const Frustum3<T>& frustum, const T& x, const T& y, const T& z, const T& radius)
+        {
+            for (const auto& plane : frustum.planes)
+            {
+                if (plane.a*x + plane.b*y + plane.c*z + plane.d < -radius) return false;
+            }
+
+            return true;
+        }
+
+        template <class T>
+        size_t cullSpheresScalar(const Frustum3<T>& frustum, const SphereArray3<T>& spheres, size_t first, uint32_t* visibleIndices)
+        {
+            const T* x = spheres.x();
+            const T* y = spheres.y();
+            const T* z = spheres.z();
+            const T* radius = spheres.radius();
+
+            size_t numVisible = 0;
+            for (size_t i = first; i < spheres.size(); ++i)
+            {
+                // written unconditionally, the index is only kept when visible
+                visibleIndices[numVisible] = static_cast<uint32_t>(i);
+                numVisible += isSphereInFrustum(frustum, x[i], y[i], z[i], radius[i]) ? 1 : 0;
+            }
+
+            return numVisible;
+        }
+    }
+
+    // Same test for a single sphere.
+    template <class T>
+    bool isSphereInFrustum(const Frustum3<T>& frustum, const Sphere3<T>& sphere)
+    {
+        return detail::isSphereInFrustum(frustum, sphere.origin.x, sphere.origin.y, sphere.origin.z, sphere.radius);
+    }
+
+    // Reference that tests one sphere at a time.
+    // Writes indices of the visible spheres in increasing order and returns their count,
+    // visibleIndices must have room for spheres.size() indices.
+    template <class T>
+    size_t cullSpheresScalar(const Frustum3<T>& frustum, const SphereArray3<T>& spheres, uint32_t* visibleIndices)
+    {
+        return detail::cullSpheresScalar(frustum, spheres, 0, visibleIndices);
+    }
+
+    // Same as cullSpheresScalar, only floats are tested in vector lanes.
+    template <class T>
+    size_t cullSpheres(const Frustum3<T>& frustum, const SphereArray3<T>& spheres, uint32_t* visibleIndices)
+    {
+        return cullSpheresScalar(frustum, spheres, visibleIndices);
+    }
+
+    inline size_t cullSpheres(const Frustum3<float>& frustum, const SphereArray3<float>& spheres, uint32_t* visibleIndices)
+    {
+        size_t numVisible = 0;
+        size_t i = 0;
+
+#if defined(LS_SIMD_AVX2) || defined(LS_SIMD_SSE2)
+        const float* xs = spheres.x();
+        const float* ys = spheres.y();
+        const float* zs = spheres.z();
+        const float* radii = spheres.radius();
+        const size_t size = spheres.size();
+#endif
+
+#if defined(LS_SIMD_AVX2)
+        __m256 planeA[6], planeB[6], planeC[6], planeD[6];
+        for (int p = 0; p < 6; ++p)
+        {
+            planeA[p] = _mm256_set1_ps(frustum.planes[p].a);
+            planeB[p] = _mm256_set1_ps(frustum.planes[p].b);
+            planeC[p] = _mm256_set1_ps(frustum.planes[p].c);
+            planeD[p] = _mm256_set1_ps(frustum.planes[p].d);
+        }
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+        for (; i + 8 <= size; i += 8)
+        {
+            const __m256 x = _mm256_loadu_ps(xs + i);
+            const __m256 y = _mm256_loadu_ps(ys + i);
+            const __m256 z = _mm256_loadu_ps(zs + i);
+            const __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(radii + i), signBit);
+            auto distance = [&](int p) { return _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeA[p], x), _mm256_mul_ps(planeB[p], y)), _mm256_mul_ps(planeC[p], z)), planeD[p]); };
+
+            // only the nearest plane matters, the minimum is exact so it doesn't change the result
+            __m256 minDist = distance(0);
+            for (int p = 1; p < 6; ++p)
+            {
+                minDist = _mm256_min_ps(minDist, distance(p));
+            }
+
+            // most of the spheres are usually outside
+            const int mask = _mm256_movemask_ps(_mm256_cmp_ps(minDist, negRadius, _CMP_GE_OQ));
+            if (mask == 0) continue;
+
+            for (int lane = 0; lane < 8; ++lane)
+            {
+                visibleIndices[numVisible] = static_cast<uint32_t>(i + lane);
+                numVisible += (mask >> lane) & 1;
+            }
+        }
+#elif defined(LS_SIMD_SSE2)
+        __m128 planeA[6], planeB[6], planeC[6], planeD[6];
+        for (int p = 0; p < 6; ++p)
+        {
+            planeA[p] = _mm_set1_ps(frustum.planes[p].a);
+            planeB[p] = _mm_set1_ps(frustum.planes[p].b);
+            planeC[p] = _mm_set1_ps(frustum.planes[p].c);
+            planeD[p] = _mm_set1_ps(frustum.planes[p].d);
+        }
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+
+        for (; i + 4 <= size; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(xs + i);
+            const __m128 y = _mm_loadu_ps(ys + i);
+            const __m128 z = _mm_loadu_ps(zs + i);
+            const __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(radii + i), signBit);
+            auto distance = [&](int p) { return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA[p], x), _mm_mul_ps(planeB[p], y)), _mm_mul_ps(planeC[p], z)), planeD[p]); };
+
+            // only the nearest plane matters, the minimum is exact so it doesn't change the result
+            __m128 minDist = distance(0);
+            for (int p = 1; p < 6; ++p)
+            {
+                minDist = _mm_min_ps(minDist, distance(p));
+            }
+
+            // most of the spheres are usually outside
+            const int mask = _mm_movemask_ps(_mm_cmpge_ps(minDist, negRadius));
+            if (mask == 0) continue;
+
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                visibleIndices[numVisible] = static_cast<uint32_t>(i + lane);
+                numVisible += (mask >> lane) & 1;
+            }
+        }
+#endif
+
+        // whatever doesn't fill the lanes
+        return numVisible + detail::cullSpheresScalar(frustum, spheres, i, visibleIndices + numVisible);
+    }
+}
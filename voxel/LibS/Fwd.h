@@ -196,6 +196,11 @@ namespace ls
     using Sphere3F = Sphere3<float>;
     using Sphere3D = Sphere3<double>;
 
+    template <class T>
+    class SphereArray3;
+    using SphereArray3F = SphereArray3<float>;
+    using SphereArray3D = SphereArray3<double>;
+
     template <class T>
     class Plane3;
     using Plane3F = Plane3<float>;
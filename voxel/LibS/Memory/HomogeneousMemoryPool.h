@@ -1,5 +1,11 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+
 namespace ls
 {
     namespace mem
@@ -177,6 +183,12 @@ namespace ls
                 return { poolId, i - poolStart };
             }
 
+            // number of cells in all pools, grows only when a new pool is allocated
+            size_t capacity() const
+            {
+                return m_isUsed.size();
+            }
+
         private:
             std::vector<Pool> m_pools;
             std::vector<uint_least8_t> m_isUsed;
@@ -210,7 +222,7 @@ namespace ls
                         size_t j = 0;
                         for (; j < m_searchStart && m_availableCellsCache.size() < numCellsToCache; ++j)
                         {
-                            if (m_isUsed[j] == false) m_availableCellsCache.emplace_back(i);
+                            if (m_isUsed[j] == false) m_availableCellsCache.emplace_back(j);
                         }
                         newStart = j;
                     }
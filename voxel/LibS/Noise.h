@@ -4,3 +4,4 @@
 #include "Noise/NoiseSampler.h"
 #include "Noise/PerlinNoise.h"
 #include "Noise/SimplexNoise.h"
+#include "Noise/BatchedSimplexNoise.h"
@@ -0,0 +1,423 @@
+#pragma once
+
+#include "../Shapes/Vec2.h"
+#include "../Shapes/Vec3.h"
+#include "../Macros.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define LS_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// Simplex noise evaluated for whole grids of points at once, float only.
+// Uses the same simplex traversal as SimplexNoise, but with its own integer hash
+// that can be computed in vector registers, so the values differ from SimplexNoise.
+// The scalar mode runs the same sequence of operations one lane at a time
+// and gives bit-for-bit the same results, as long as the compiler doesn't contract
+// multiplications and additions (MSVC /fp:precise, -ffp-contract=off).
+// Periods are not supported.
+
+namespace ls
+{
+    namespace detail
+    {
+        namespace simd
+        {
+            struct ScalarLanes
+            {
+                using Float = float;
+                using Int = uint32_t;
+
+                static constexpr int width = 1;
+
+                static LS_FORCEINLINE Float set(float v) { return v; }
+                static LS_FORCEINLINE Int set(uint32_t v) { return v; }
+                static LS_FORCEINLINE Int ramp() { return 0u; }
+                static LS_FORCEINLINE void store(float* out, Float v) { *out = v; }
+
+                static LS_FORCEINLINE Float add(Float a, Float b) { return a + b; }
+                static LS_FORCEINLINE Float sub(Float a, Float b) { return a - b; }
+                static LS_FORCEINLINE Float mul(Float a, Float b) { return a * b; }
+                static LS_FORCEINLINE Float neg(Float a) { return -a; }
+                // same as maxps, returns b unless a is greater
+                static LS_FORCEINLINE Float max(Float a, Float b) { return a > b ? a : b; }
+                static LS_FORCEINLINE Int greater(Float a, Float b) { return a > b ? ~0u : 0u; }
+                static LS_FORCEINLINE Int greaterEqual(Float a, Float b) { return a >= b ? ~0u : 0u; }
+                static LS_FORCEINLINE Float select(Int mask, Float a, Float b) { return mask ? a : b; }
+
+                static LS_FORCEINLINE Int floorToInt(Float a) { return static_cast<uint32_t>(static_cast<int32_t>(std::floor(a))); }
+                static LS_FORCEINLINE Float toFloat(Int a) { return static_cast<float>(static_cast<int32_t>(a)); }
+
+                static LS_FORCEINLINE Int add(Int a, Int b) { return a + b; }
+                static LS_FORCEINLINE Int sub(Int a, Int b) { return a - b; }
+                static LS_FORCEINLINE Int mul(Int a, Int b) { return a * b; }
+                static LS_FORCEINLINE Int bitAnd(Int a, Int b) { return a & b; }
+                static LS_FORCEINLINE Int bitOr(Int a, Int b) { return a | b; }
+                static LS_FORCEINLINE Int bitXor(Int a, Int b) { return a ^ b; }
+                static LS_FORCEINLINE Int bitNot(Int a) { return ~a; }
+                template <int N>
+                static LS_FORCEINLINE Int shiftRight(Int a) { return a >> N; }
+                static LS_FORCEINLINE Int equal(Int a, Int b) { return a == b ? ~0u : 0u; }
+            };
+
+#if defined(LS_SIMD_SSE2)
+            struct Sse2Lanes
+            {
+                using Float = __m128;
+                using Int = __m128i;
+
+                static constexpr int width = 4;
+
+                static LS_FORCEINLINE Float set(float v) { return _mm_set1_ps(v); }
+                static LS_FORCEINLINE Int set(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+                static LS_FORCEINLINE Int ramp() { return _mm_setr_epi32(0, 1, 2, 3); }
+                static LS_FORCEINLINE void store(float* out, Float v) { _mm_storeu_ps(out, v); }
+
+                static LS_FORCEINLINE Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+                static LS_FORCEINLINE Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+                static LS_FORCEINLINE Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+                static LS_FORCEINLINE Float neg(Float a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+                static LS_FORCEINLINE Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+                static LS_FORCEINLINE Int greater(Float a, Float b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+                static LS_FORCEINLINE Int greaterEqual(Float a, Float b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+                static LS_FORCEINLINE Float select(Int mask, Float a, Float b)
+                {
+                    const Float m = _mm_castsi128_ps(mask);
+                    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+                }
+
+                static LS_FORCEINLINE Int floorToInt(Float a)
+                {
+                    // truncation rounds negative values up, those are moved down by one
+                    const Int t = _mm_cvttps_epi32(a);
+                    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), a)));
+                }
+                static LS_FORCEINLINE Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+
+                static LS_FORCEINLINE Int add(Int a, Int b) { return _mm_add_epi32(a, b); }
+                static LS_FORCEINLINE Int sub(Int a, Int b) { return _mm_sub_epi32(a, b); }
+                static LS_FORCEINLINE Int mul(Int a, Int b)
+                {
+                    // no 32 bit multiplication before SSE4.1, even and odd lanes are done separately
+                    const Int even = _mm_mul_epu32(a, b);
+                    const Int odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+                    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+                }
+                static LS_FORCEINLINE Int bitAnd(Int a, Int b) { return _mm_and_si128(a, b); }
+                static LS_FORCEINLINE Int bitOr(Int a, Int b) { return _mm_or_si128(a, b); }
+                static LS_FORCEINLINE Int bitXor(Int a, Int b) { return _mm_xor_si128(a, b); }
+                static LS_FORCEINLINE Int bitNot(Int a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+                template <int N>
+                static LS_FORCEINLINE Int shiftRight(Int a) { return _mm_srli_epi32(a, N); }
+                static LS_FORCEINLINE Int equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+            };
+
+            using VectorLanes = Sse2Lanes;
+#elif defined(LS_SIMD_AVX2)
+            struct Avx2Lanes
+            {
+                using Float = __m256;
+                using Int = __m256i;
+
+                static constexpr int width = 8;
+
+                static LS_FORCEINLINE Float set(float v) { return _mm256_set1_ps(v); }
+                static LS_FORCEINLINE Int set(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+                static LS_FORCEINLINE Int ramp() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+                static LS_FORCEINLINE void store(float* out, Float v) { _mm256_storeu_ps(out, v); }
+
+                static LS_FORCEINLINE Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+                static LS_FORCEINLINE Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+                static LS_FORCEINLINE Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+                static LS_FORCEINLINE Float neg(Float a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+                static LS_FORCEINLINE Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+                static LS_FORCEINLINE Int greater(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+                static LS_FORCEINLINE Int greaterEqual(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+                static LS_FORCEINLINE Float select(Int mask, Float a, Float b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+
+                static LS_FORCEINLINE Int floorToInt(Float a) { return _mm256_cvttps_epi32(_mm256_floor_ps(a)); }
+                static LS_FORCEINLINE Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+
+                static LS_FORCEINLINE Int add(Int a, Int b) { return _mm256_add_epi32(a, b); }
+                static LS_FORCEINLINE Int sub(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+                static LS_FORCEINLINE Int mul(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+                static LS_FORCEINLINE Int bitAnd(Int a, Int b) { return _mm256_and_si256(a, b); }
+                static LS_FORCEINLINE Int bitOr(Int a, Int b) { return _mm256_or_si256(a, b); }
+                static LS_FORCEINLINE Int bitXor(Int a, Int b) { return _mm256_xor_si256(a, b); }
+                static LS_FORCEINLINE Int bitNot(Int a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+                template <int N>
+                static LS_FORCEINLINE Int shiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+                static LS_FORCEINLINE Int equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+            };
+
+            using VectorLanes = Avx2Lanes;
+#else
+            using VectorLanes = ScalarLanes;
+#endif
+        }
+    }
+
+    class BatchedSimplexNoise
+    {
+    public:
+        enum class Mode
+        {
+            Vector, // widest lanes the target was compiled for
+            Scalar  // reference, one point at a time
+        };
+
+        explicit BatchedSimplexNoise(uint32_t seed, Mode mode = Mode::Vector) :
+            m_seed(seed),
+            m_mode(mode)
+        {
+        }
+
+        void setMode(Mode mode)
+        {
+            m_mode = mode;
+        }
+        Mode mode() const
+        {
+            return m_mode;
+        }
+
+        // number of points evaluated together in the vector mode
+        static constexpr int laneWidth()
+        {
+            return detail::simd::VectorLanes::width;
+        }
+
+        // Point (x, y) of the grid is origin + (x, y) * step and its value goes to out[x * size.y + y].
+        // Lanes go along y.
+        void rawGrid(const Vec2<float>& origin, const Vec2<float>& step, const Vec2<int>& size, float* out) const
+        {
+            if (m_mode == Mode::Vector) rawGridImpl<detail::simd::VectorLanes>(origin, step, size, out);
+            else rawGridImpl<detail::simd::ScalarLanes>(origin, step, size, out);
+        }
+        // Point (x, y, z) of the grid is origin + (x, y, z) * step and its value goes to out[(x * size.y + y) * size.z + z].
+        // Lanes go along z.
+        void rawGrid(const Vec3<float>& origin, const Vec3<float>& step, const Vec3<int>& size, float* out) const
+        {
+            if (m_mode == Mode::Vector) rawGridImpl<detail::simd::VectorLanes>(origin, step, size, out);
+            else rawGridImpl<detail::simd::ScalarLanes>(origin, step, size, out);
+        }
+
+    private:
+        uint32_t m_seed;
+        Mode m_mode;
+
+        static constexpr float m_F2 = 0.366025403f;
+        static constexpr float m_G2 = 0.211324865f;
+        static constexpr float m_F3 = 1.0f / 3.0f;
+        static constexpr float m_G3 = 1.0f / 6.0f;
+
+        template <class L>
+        void rawGridImpl(const Vec2<float>& origin, const Vec2<float>& step, const Vec2<int>& size, float* out) const
+        {
+            using S = detail::simd::ScalarLanes;
+
+            const int numVectorLanes = size.y - size.y % L::width;
+            for (int x = 0; x < size.x; ++x)
+            {
+                const float px = origin.x + static_cast<float>(x) * step.x;
+                float* row = out + static_cast<size_t>(x) * size.y;
+
+                int y = 0;
+                for (; y < numVectorLanes; y += L::width)
+                {
+                    const typename L::Float py = L::add(L::set(origin.y), L::mul(L::toFloat(L::add(L::set(static_cast<uint32_t>(y)), L::ramp())), L::set(step.y)));
+                    L::store(row + y, raw2<L>(L::set(px), py));
+                }
+                // the same operations on single lanes, so the tail matches the scalar mode
+                for (; y < size.y; ++y)
+                {
+                    const float py = S::add(S::set(origin.y), S::mul(S::toFloat(static_cast<uint32_t>(y)), S::set(step.y)));
+                    S::store(row + y, raw2<S>(px, py));
+                }
+            }
+        }
+
+        template <class L>
+        void rawGridImpl(const Vec3<float>& origin, const Vec3<float>& step, const Vec3<int>& size, float* out) const
+        {
+            using S = detail::simd::ScalarLanes;
+
+            const int numVectorLanes = size.z - size.z % L::width;
+            for (int x = 0; x < size.x; ++x)
+            {
+                const float px = origin.x + static_cast<float>(x) * step.x;
+                for (int y = 0; y < size.y; ++y)
+                {
+                    const float py = origin.y + static_cast<float>(y) * step.y;
+                    float* row = out + (static_cast<size_t>(x) * size.y + y) * size.z;
+
+                    int z = 0;
+                    for (; z < numVectorLanes; z += L::width)
+                    {
+                        const typename L::Float pz = L::add(L::set(origin.z), L::mul(L::toFloat(L::add(L::set(static_cast<uint32_t>(z)), L::ramp())), L::set(step.z)));
+                        L::store(row + z, raw3<L>(L::set(px), L::set(py), pz));
+                    }
+                    for (; z < size.z; ++z)
+                    {
+                        const float pz = S::add(S::set(origin.z), S::mul(S::toFloat(static_cast<uint32_t>(z)), S::set(step.z)));
+                        S::store(row + z, raw3<S>(px, py, pz));
+                    }
+                }
+            }
+        }
+
+        // multiplicative mix of the coordinates followed by the lowbias32 finalizer
+        template <class L>
+        LS_FORCEINLINE typename L::Int hash(typename L::Int h) const
+        {
+            h = L::bitXor(h, L::set(m_seed));
+            h = L::bitXor(h, L::template shiftRight<16>(h));
+            h = L::mul(h, L::set(0x7feb352du));
+            h = L::bitXor(h, L::template shiftRight<15>(h));
+            h = L::mul(h, L::set(0x846ca68bu));
+            h = L::bitXor(h, L::template shiftRight<16>(h));
+            return h;
+        }
+        template <class L>
+        LS_FORCEINLINE typename L::Int hash(typename L::Int i, typename L::Int j) const
+        {
+            return hash<L>(L::bitXor(L::mul(i, L::set(0x8da6b343u)), L::mul(j, L::set(0xd8163841u))));
+        }
+        template <class L>
+        LS_FORCEINLINE typename L::Int hash(typename L::Int i, typename L::Int j, typename L::Int k) const
+        {
+            return hash<L>(L::bitXor(L::bitXor(L::mul(i, L::set(0x8da6b343u)), L::mul(j, L::set(0xd8163841u))), L::mul(k, L::set(0xcb1ab31fu))));
+        }
+
+        template <class L>
+        static LS_FORCEINLINE typename L::Int hasBits(typename L::Int h, uint32_t bits)
+        {
+            return L::equal(L::bitAnd(h, L::set(bits)), L::set(bits));
+        }
+
+        // same gradients as SimplexNoise::grad2
+        template <class L>
+        static LS_FORCEINLINE typename L::Float grad2(typename L::Int h, typename L::Float x, typename L::Float y)
+        {
+            const typename L::Int isXFirst = L::bitNot(hasBits<L>(h, 0b100u));
+            const typename L::Float u = L::select(isXFirst, x, y);
+            const typename L::Float v = L::mul(L::select(isXFirst, y, x), L::set(2.0f));
+            return L::add(L::select(hasBits<L>(h, 0b001u), L::neg(u), u), L::select(hasBits<L>(h, 0b010u), L::neg(v), v));
+        }
+
+        // same gradients as SimplexNoise::grad3
+        template <class L>
+        static LS_FORCEINLINE typename L::Float grad3(typename L::Int h, typename L::Float x, typename L::Float y, typename L::Float z)
+        {
+            h = L::bitAnd(h, L::set(0b1111u));
+            const typename L::Int isXFirst = L::bitNot(hasBits<L>(h, 0b1000u));
+            const typename L::Int isYSecond = L::equal(L::bitAnd(h, L::set(0b1100u)), L::set(0u));
+            const typename L::Int isXSecond = L::bitOr(L::equal(h, L::set(12u)), L::equal(h, L::set(14u)));
+            const typename L::Float u = L::select(isXFirst, x, y);
+            const typename L::Float v = L::select(isYSecond, y, L::select(isXSecond, x, z));
+            return L::add(L::select(hasBits<L>(h, 0b01u), L::neg(u), u), L::select(hasBits<L>(h, 0b10u), L::neg(v), v));
+        }
+
+        template <class L>
+        LS_FORCEINLINE typename L::Float contribution2(typename L::Int h, typename L::Float x, typename L::Float y) const
+        {
+            typename L::Float t = L::sub(L::sub(L::set(0.5f), L::mul(x, x)), L::mul(y, y));
+            t = L::max(t, L::set(0.0f));
+            t = L::mul(t, t);
+            return L::mul(L::mul(t, t), grad2<L>(h, x, y));
+        }
+        template <class L>
+        LS_FORCEINLINE typename L::Float contribution3(typename L::Int h, typename L::Float x, typename L::Float y, typename L::Float z) const
+        {
+            typename L::Float t = L::sub(L::sub(L::sub(L::set(0.6f), L::mul(x, x)), L::mul(y, y)), L::mul(z, z));
+            t = L::max(t, L::set(0.0f));
+            t = L::mul(t, t);
+            return L::mul(L::mul(t, t), grad3<L>(h, x, y, z));
+        }
+
+        template <class L>
+        LS_FORCEINLINE typename L::Float raw2(typename L::Float x, typename L::Float y) const
+        {
+            using F = typename L::Float;
+            using I = typename L::Int;
+
+            const F s = L::mul(L::add(x, y), L::set(m_F2));
+            const I i = L::floorToInt(L::add(x, s));
+            const I j = L::floorToInt(L::add(y, s));
+
+            const F t = L::mul(L::toFloat(L::add(i, j)), L::set(m_G2));
+            const F x0 = L::sub(x, L::sub(L::toFloat(i), t));
+            const F y0 = L::sub(y, L::sub(L::toFloat(j), t));
+
+            // lower or upper triangle of the cell
+            const I isLower = L::greater(x0, y0);
+            const I i1 = L::bitAnd(isLower, L::set(1u));
+            const I j1 = L::sub(L::set(1u), i1);
+
+            const F x1 = L::add(L::sub(x0, L::toFloat(i1)), L::set(m_G2));
+            const F y1 = L::add(L::sub(y0, L::toFloat(j1)), L::set(m_G2));
+            const F x2 = L::add(L::sub(x0, L::set(1.0f)), L::set(2.0f * m_G2));
+            const F y2 = L::add(L::sub(y0, L::set(1.0f)), L::set(2.0f * m_G2));
+
+            const I one = L::set(1u);
+            const F n0 = contribution2<L>(hash<L>(i, j), x0, y0);
+            const F n1 = contribution2<L>(hash<L>(L::add(i, i1), L::add(j, j1)), x1, y1);
+            const F n2 = contribution2<L>(hash<L>(L::add(i, one), L::add(j, one)), x2, y2);
+
+            return L::mul(L::set(40.0f), L::add(L::add(n0, n1), n2));
+        }
+
+        template <class L>
+        LS_FORCEINLINE typename L::Float raw3(typename L::Float x, typename L::Float y, typename L::Float z) const
+        {
+            using F = typename L::Float;
+            using I = typename L::Int;
+
+            const F s = L::mul(L::add(L::add(x, y), z), L::set(m_F3));
+            const I i = L::floorToInt(L::add(x, s));
+            const I j = L::floorToInt(L::add(y, s));
+            const I k = L::floorToInt(L::add(z, s));
+
+            const F t = L::mul(L::toFloat(L::add(L::add(i, j), k)), L::set(m_G3));
+            const F x0 = L::sub(x, L::sub(L::toFloat(i), t));
+            const F y0 = L::sub(y, L::sub(L::toFloat(j), t));
+            const F z0 = L::sub(z, L::sub(L::toFloat(k), t));
+
+            // the branches of SimplexNoise::raw selecting the simplex written as masks
+            const I xy = L::greaterEqual(x0, y0);
+            const I yz = L::greaterEqual(y0, z0);
+            const I xz = L::greaterEqual(x0, z0);
+            const I one = L::set(1u);
+            const I i1 = L::bitAnd(L::bitAnd(xy, xz), one);
+            const I j1 = L::bitAnd(L::bitAnd(L::bitNot(xy), yz), one);
+            const I k1 = L::bitAnd(L::bitAnd(L::bitNot(xz), L::bitNot(yz)), one);
+            const I i2 = L::bitAnd(L::bitOr(xy, xz), one);
+            const I j2 = L::bitAnd(L::bitOr(L::bitNot(xy), yz), one);
+            const I k2 = L::bitAnd(L::bitNot(L::bitAnd(xz, yz)), one);
+
+            const F x1 = L::add(L::sub(x0, L::toFloat(i1)), L::set(m_G3));
+            const F y1 = L::add(L::sub(y0, L::toFloat(j1)), L::set(m_G3));
+            const F z1 = L::add(L::sub(z0, L::toFloat(k1)), L::set(m_G3));
+            const F x2 = L::add(L::sub(x0, L::toFloat(i2)), L::set(2.0f * m_G3));
+            const F y2 = L::add(L::sub(y0, L::toFloat(j2)), L::set(2.0f * m_G3));
+            const F z2 = L::add(L::sub(z0, L::toFloat(k2)), L::set(2.0f * m_G3));
+            const F x3 = L::add(L::sub(x0, L::set(1.0f)), L::set(3.0f * m_G3));
+            const F y3 = L::add(L::sub(y0, L::set(1.0f)), L::set(3.0f * m_G3));
+            const F z3 = L::add(L::sub(z0, L::set(1.0f)), L::set(3.0f * m_G3));
+
+            const F n0 = contribution3<L>(hash<L>(i, j, k), x0, y0, z0);
+            const F n1 = contribution3<L>(hash<L>(L::add(i, i1), L::add(j, j1), L::add(k, k1)), x1, y1, z1);
+            const F n2 = contribution3<L>(hash<L>(L::add(i, i2), L::add(j, j2), L::add(k, k2)), x2, y2, z2);
+            const F n3 = contribution3<L>(hash<L>(L::add(i, one), L::add(j, one), L::add(k, one)), x3, y3, z3);
+
+            return L::mul(L::set(32.0f), L::add(L::add(L::add(n0, n1), n2), n3));
+        }
+    };
+}
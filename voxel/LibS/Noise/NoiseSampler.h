@@ -4,6 +4,9 @@
 #include "../VectorUtil.h"
 #include "NoiseUtil.h"
 
+#include <vector>
+#include <algorithm>
+
 namespace ls
 {
     template <class T, int Dim>
@@ -67,6 +70,51 @@ namespace ls
             return detail::scaleResult(total / amplitudeSum, m_lowerBound, m_upperBound);
         }
 
+        // Point (x, y, ...) of the grid is at pos + (x, y, ...) * step, out has the layout of gen.rawGrid.
+        // For generators filling whole grids at once, like BatchedSimplexNoise. The period is ignored.
+        template <class NoiseGen>
+        void sampleGrid(const VectorType& pos, const VectorType& step, const VectorTypeI& size, ValueType* out, NoiseGen&& gen)
+        {
+            const size_t numPoints = gridSize(size);
+            VectorType frequency = m_scale;
+
+            if (m_octaves == 1)
+            {
+                std::forward<NoiseGen>(gen).rawGrid(pos * frequency, step * frequency, size, out);
+                for (size_t i = 0; i < numPoints; ++i)
+                {
+                    out[i] = detail::scaleResult(out[i], m_lowerBound, m_upperBound);
+                }
+                return;
+            }
+
+            // reused between calls, grids are sampled by many generation jobs at once
+            static thread_local std::vector<ValueType> octave;
+            octave.resize(numPoints);
+            std::fill(out, out + numPoints, ValueType(0));
+
+            ValueType amplitude = ValueType(1);
+            ValueType amplitudeSum = ValueType(0);
+
+            for (int i = 0; i < m_octaves; ++i)
+            {
+                std::forward<NoiseGen>(gen).rawGrid(pos * frequency, step * frequency, size, octave.data());
+                for (size_t j = 0; j < numPoints; ++j)
+                {
+                    out[j] += octave[j] * amplitude;
+                }
+
+                frequency *= ValueType(2);
+                amplitudeSum += amplitude;
+                amplitude *= m_persistence;
+            }
+
+            for (size_t i = 0; i < numPoints; ++i)
+            {
+                out[i] = detail::scaleResult(out[i] / amplitudeSum, m_lowerBound, m_upperBound);
+            }
+        }
+
         template <class NoiseGen, class RetType = decltype(m_noiseGen.rawDerivative(declval<VectorType>(), declval<VectorTypeI>()))>
         RetType sampleDerivative(const VectorType& pos, NoiseGen&& gen)
         {
@@ -263,6 +311,23 @@ namespace ls
 
     private:
 
+        static size_t gridSize(int size)
+        {
+            return static_cast<size_t>(size);
+        }
+        static size_t gridSize(const Vec2<int>& size)
+        {
+            return static_cast<size_t>(size.x) * size.y;
+        }
+        static size_t gridSize(const Vec3<int>& size)
+        {
+            return static_cast<size_t>(size.x) * size.y * size.z;
+        }
+        static size_t gridSize(const Vec4<int>& size)
+        {
+            return static_cast<size_t>(size.x) * size.y * size.z * size.w;
+        }
+
         static void doublePeriod(int& period)
         {
             if (period < std::numeric_limits<int>::max() / 2) period *= 2;
@@ -34,6 +34,8 @@ namespace ls
                 m_id = other.m_id;
 
                 other.m_id = m_nullId;
+
+                return *this;
             }
             ~BufferObject()
             {
@@ -41,8 +43,9 @@ namespace ls
             }
 
             template <class T>
-            void reserve(GLsizeiptr size, GLenum usage)
+            void reserve(GLsizeiptr size, GLenum usage) const
             {
+                bind();
                 glBufferData(Target, sizeof(T) * size, nullptr, usage);
             }
 
@@ -60,6 +63,13 @@ namespace ls
                 glBufferSubData(Target, offset, sizeof(T) * size, data);
             }
 
+            template <class T>
+            void read(T* data, GLintptr offset, GLsizeiptr size) const
+            {
+                bind();
+                glGetBufferSubData(Target, offset, sizeof(T) * size, data);
+            }
+
             void bind() const
             {
                 Binder::ensureBond(m_id);
@@ -91,5 +101,6 @@ namespace ls
 
         using VertexBufferObject = BufferObject<GL_ARRAY_BUFFER>;
         using IndexBufferObject = BufferObject<GL_ELEMENT_ARRAY_BUFFER>;
+        using DrawIndirectBufferObject = BufferObject<GL_DRAW_INDIRECT_BUFFER>;
     }
 }
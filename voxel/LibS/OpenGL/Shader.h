@@ -322,6 +322,7 @@ namespace ls
                 {
                     glDeleteShader(id);
                 }
+                m_shaders.clear();
             }
         };
     }
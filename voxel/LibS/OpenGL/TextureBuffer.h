@@ -0,0 +1,94 @@
+#pragma once
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Bindable.h"
+#include "BufferObject.h"
+
+namespace ls
+{
+    namespace gl
+    {
+        // buffer read by shaders through a samplerBuffer with texelFetch
+        class TextureBuffer : public TextureBindable<GL_TEXTURE_BUFFER>
+        {
+            using Binder = TextureBindable<GL_TEXTURE_BUFFER>;
+        public:
+            TextureBuffer(GLenum internalFormat, GLsizeiptr sizeInBytes, GLenum usage)
+            {
+                m_buffer.reserve<char>(sizeInBytes, usage);
+
+                glGenTextures(1, &m_id);
+                bind();
+                glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, m_buffer.id());
+            }
+            TextureBuffer(const TextureBuffer&) = delete;
+            TextureBuffer(TextureBuffer&& other) noexcept :
+                m_id(other.m_id),
+                m_buffer(std::move(other.m_buffer))
+            {
+                other.m_id = m_nullId;
+            }
+            TextureBuffer& operator=(const TextureBuffer&) = delete;
+            TextureBuffer& operator=(TextureBuffer&& other) noexcept
+            {
+                cleanup();
+                m_id = other.m_id;
+                other.m_id = m_nullId;
+
+                m_buffer = std::move(other.m_buffer);
+
+                return *this;
+            }
+            ~TextureBuffer()
+            {
+                cleanup();
+            }
+
+            // offset is in bytes
+            template <class T>
+            void update(const T* data, GLintptr offset, GLsizeiptr size) const
+            {
+                m_buffer.update(data, offset, size);
+            }
+
+            // offset is in bytes
+            template <class T>
+            void read(T* data, GLintptr offset, GLsizeiptr size) const
+            {
+                m_buffer.read(data, offset, size);
+            }
+
+            GLuint id() const
+            {
+                return m_id;
+            }
+
+            void bind(GLenum unit) const
+            {
+                setActiveTexture(unit);
+                Binder::ensureBond(m_id);
+            }
+            void bind() const
+            {
+                Binder::ensureBond(m_id);
+            }
+
+        private:
+            GLuint m_id;
+            BufferObject<GL_TEXTURE_BUFFER> m_buffer;
+
+            static constexpr GLuint m_nullId = 0;
+
+            void cleanup()
+            {
+                if (m_id != m_nullId)
+                {
+                    Binder::deleteTexture(m_id);
+                }
+                m_id = m_nullId;
+            }
+        };
+    }
+}
@@ -101,6 +101,26 @@ namespace ls
                 m_ibo->bind();
                 glDrawElements(mode, count, type, nullptr);
             }
+            // first is the offset of the first index in bytes, baseVertex is added to every index
+            void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, GLintptr first, GLint baseVertex)
+            {
+                bind();
+                m_ibo->bind();
+                glDrawElementsBaseVertex(mode, count, type, reinterpret_cast<const void*>(first), baseVertex);
+            }
+            // parameters of the draws are read from the bound GL_DRAW_INDIRECT_BUFFER at the given offset
+            void multiDrawElementsIndirect(GLenum mode, GLenum type, GLintptr indirect, GLsizei drawCount, GLsizei stride)
+            {
+                bind();
+                m_ibo->bind();
+                glMultiDrawElementsIndirect(mode, type, reinterpret_cast<const void*>(indirect), drawCount, stride);
+            }
+            void multiDrawElementsBaseVertex(GLenum mode, const GLsizei* counts, GLenum type, const void* const* firsts, GLsizei drawCount, const GLint* baseVertices)
+            {
+                bind();
+                m_ibo->bind();
+                glMultiDrawElementsBaseVertex(mode, counts, type, firsts, drawCount, baseVertices);
+            }
 
             template <class VertexType, class AttrType>
             void setVertexAttribute(const VertexBufferObject& vbo, GLuint index, AttrType VertexType::*attrPtr, GLint size, GLenum type, GLboolean isNormalized) const
@@ -111,6 +131,16 @@ namespace ls
                 glEnableVertexAttribArray(index);
             }
 
+            // type has to be one of the integer types, the shader input has to be an (u)int or (u)ivec
+            template <class VertexType, class AttrType>
+            void setIntegerVertexAttribute(const VertexBufferObject& vbo, GLuint index, AttrType VertexType::*attrPtr, GLint size, GLenum type) const
+            {
+                bind();
+                vbo.bind();
+                makeIntegerVertexAttribute(index, attrPtr, size, type).apply();
+                glEnableVertexAttribArray(index);
+            }
+
             void setVertexAttribDivisor(GLuint index, GLuint divisor)
             {
                 bind();
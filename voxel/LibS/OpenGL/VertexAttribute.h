@@ -69,10 +69,64 @@ namespace ls
             const GLvoid* m_offset;
         };
 
+        // attribute that is read as an integer in the shader, without conversion to float
+        template <class T>
+        class IntegerVertexAttribute
+        {
+        public:
+            IntegerVertexAttribute(GLuint index, GLint size, GLenum type, const GLvoid* offset) :
+                m_index(index),
+                m_size(size),
+                m_type(type),
+                m_offset(offset)
+            {
+            }
+
+            void apply() const
+            {
+                glVertexAttribIPointer(
+                    m_index,
+                    m_size,
+                    m_type,
+                    sizeof(T),
+                    m_offset
+                );
+            }
+
+            GLuint index() const
+            {
+                return m_index;
+            }
+            GLint size() const
+            {
+                return m_size;
+            }
+            GLenum type() const
+            {
+                return m_type;
+            }
+            const GLvoid* offset() const
+            {
+                return m_offset;
+            }
+
+        private:
+            GLuint m_index;
+            GLint m_size;
+            GLenum m_type;
+            const GLvoid* m_offset;
+        };
+
         template <class VertexType, class AttrType>
         VertexAttribute<VertexType> makeVertexAttribute(GLuint index, AttrType VertexType::*attrPtr, GLint size, GLenum type, GLboolean isNormalized)
         {
             return VertexAttribute<VertexType>(index, size, type, isNormalized, static_cast<const char*>(0) + detail::offsetOf(attrPtr));
         }
+
+        template <class VertexType, class AttrType>
+        IntegerVertexAttribute<VertexType> makeIntegerVertexAttribute(GLuint index, AttrType VertexType::*attrPtr, GLint size, GLenum type)
+        {
+            return IntegerVertexAttribute<VertexType>(index, size, type, static_cast<const char*>(0) + detail::offsetOf(attrPtr));
+        }
     }
 }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Vec3.h"
+#include "Sphere3.h"
+
+#include <vector>
+#include <type_traits>
+
+namespace ls
+{
+    // Spheres stored as separate arrays of coordinates and radii,
+    // so that many of them can be loaded into vector registers at once.
+    template <class T>
+    class SphereArray3
+    {
+        static_assert(std::is_floating_point<T>::value, "T must be a floating-point type");
+    public:
+        using ValueType = T;
+
+        SphereArray3() = default;
+
+        void reserve(size_t capacity)
+        {
+            m_x.reserve(capacity);
+            m_y.reserve(capacity);
+            m_z.reserve(capacity);
+            m_radius.reserve(capacity);
+        }
+
+        void push_back(const Sphere3<T>& sphere)
+        {
+            m_x.push_back(sphere.origin.x);
+            m_y.push_back(sphere.origin.y);
+            m_z.push_back(sphere.origin.z);
+            m_radius.push_back(sphere.radius);
+        }
+        void pop_back()
+        {
+            m_x.pop_back();
+            m_y.pop_back();
+            m_z.pop_back();
+            m_radius.pop_back();
+        }
+        void clear()
+        {
+            m_x.clear();
+            m_y.clear();
+            m_z.clear();
+            m_radius.clear();
+        }
+
+        void set(size_t i, const Sphere3<T>& sphere)
+        {
+            m_x[i] = sphere.origin.x;
+            m_y[i] = sphere.origin.y;
+            m_z[i] = sphere.origin.z;
+            m_radius[i] = sphere.radius;
+        }
+        Sphere3<T> operator[](size_t i) const
+        {
+            return Sphere3<T>(Vec3<T>(m_x[i], m_y[i], m_z[i]), m_radius[i]);
+        }
+
+        size_t size() const
+        {
+            return m_x.size();
+        }
+        bool isEmpty() const
+        {
+            return m_x.empty();
+        }
+
+        const T* x() const
+        {
+            return m_x.data();
+        }
+        const T* y() const
+        {
+            return m_y.data();
+        }
+        const T* z() const
+        {
+            return m_z.data();
+        }
+        const T* radius() const
+        {
+            return m_radius.data();
+        }
+
+    private:
+        std::vector<T> m_x;
+        std::vector<T> m_y;
+        std::vector<T> m_z;
+        std::vector<T> m_radius;
+    };
+
+    using SphereArray3F = SphereArray3<float>;
+    using SphereArray3D = SphereArray3<double>;
+}
@@ -4,6 +4,7 @@
 #include "Shapes/Box3.h"
 #include "Shapes/Cylinder3.h"
 #include "Shapes/Sphere3.h"
+#include "Shapes/SphereArray3.h"
 #include "Shapes/Capsule3.h"
 #include "Shapes/Ray3.h"
 #include "Shapes/Triangle3.h"
@@ -1,13 +1,18 @@
 #version 330 core
 
 in vec2 texCoords;
+flat in vec2 tileOrigin;
 
 out vec4 color;
 
 uniform sampler2D tex0;
+uniform vec2 uTileSize;
 
 void main(){
-  vec4 color0 = texture(tex0, texCoords);
+  // texCoords are in tiles and repeat over merged faces,
+  // gradients are taken before wrapping so there are no seams between tiles
+  vec2 atlasCoords = tileOrigin + fract(texCoords) * uTileSize;
+  vec4 color0 = textureGrad(tex0, atlasCoords, dFdx(texCoords) * uTileSize, dFdy(texCoords) * uTileSize);
   color = color0;
   if(color.a < 0.01) discard;
-}
\ No newline at end of file
+}
@@ -1,17 +1,38 @@
 #version 330 core
 
 // Input vertex data, different for all executions of this shader.
-layout(location = 0) in vec3 vertexPosition;
-layout(location = 1) in vec2 vertexTexCoords;
+// x, y, z, u, v packed by 6 bits each, see BlockVertex
+layout(location = 0) in uint vertexPositionAndTexCoords;
+// tile grid coordinates, x in the low 16 bits
+layout(location = 1) in uint vertexTile;
   
 // Values that stay constant for the whole mesh.
 uniform mat4 uModelViewProjection;
+uniform vec2 uTileStride;
+// Chunks are drawn together, the origin of the chunk owning
+// each block of uVerticesPerChunkOrigin vertices is looked up, see MapChunkMeshArena
+uniform isamplerBuffer uChunkOrigins;
+uniform int uVerticesPerChunkOrigin;
 
 out vec2 texCoords;
+flat out vec2 tileOrigin;
   
 void main(){
+  vec3 vertexPosition = vec3(
+    float(vertexPositionAndTexCoords & 63u),
+    float((vertexPositionAndTexCoords >> 6) & 63u),
+    float((vertexPositionAndTexCoords >> 12) & 63u)
+  );
+
+  // gl_VertexID includes the base vertex of the chunk
+  vec3 chunkOrigin = vec3(texelFetch(uChunkOrigins, gl_VertexID / uVerticesPerChunkOrigin).xyz);
+
   // Output position of the vertex, in clip space : MVP * position
-  gl_Position = uModelViewProjection * vec4(vertexPosition, 1);
+  gl_Position = uModelViewProjection * vec4(chunkOrigin + vertexPosition, 1);
 
-  texCoords = vertexTexCoords;
+  texCoords = vec2(
+    float((vertexPositionAndTexCoords >> 18) & 63u),
+    float((vertexPositionAndTexCoords >> 24) & 63u)
+  );
+  tileOrigin = vec2(float(vertexTile & 65535u), float(vertexTile >> 16)) * uTileStride;
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../LibS/Fwd.h"
+#include "../LibS/Shapes/Vec3.h"
+
+#include <vector>
+#include <string>
+
+// Poses of the camera recorded in the game, replayed headless by voxel_bench.
+// Stored as text, one pose per line: x y z yaw pitch, angles in degrees.
+class CameraPath
+{
+public:
+    struct Pose
+    {
+        ls::Vec3F position;
+        float yawDegrees;
+        float pitchDegrees;
+
+        static Pose fromCamera(const ls::gl::Camera& camera);
+        void applyTo(ls::gl::Camera& camera) const;
+    };
+
+    // throws when the file can't be read or a line is malformed
+    static CameraPath load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    void add(const Pose& pose);
+    void clear();
+
+    const std::vector<Pose>& poses() const;
+    bool isEmpty() const;
+
+private:
+    std::vector<Pose> m_poses;
+};
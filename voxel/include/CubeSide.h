@@ -105,44 +105,44 @@ public:
 
         return dict[static_cast<unsigned>(m_value)];
     }
-    constexpr const std::array<BlockVertex, 4>& faceVertices() const
-    {
-        static const std::array<std::array<BlockVertex, 4>, 6> vertices{
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 1.0f, 0.0f, 1.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 0.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 1.0f },{ 0.0f, 1.0f } }
+    constexpr const std::array<BlockFaceVertex, 4>& faceVertices() const
+    {
+        static const std::array<std::array<BlockFaceVertex, 4>, 6> vertices{
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 1, 0, 1 },{ 0, 0 } },
+                BlockFaceVertex{ { 1, 0, 0 },{ 1, 0 } },
+                BlockFaceVertex{ { 1, 1, 0 },{ 1, 1 } },
+                BlockFaceVertex{ { 1, 1, 1 },{ 0, 1 } }
             },
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 0.0f, 0.0f, 1.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 0.0f, 1.0f, 1.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 0.0f, 1.0f, 0.0f },{ 0.0f, 1.0f } }
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 0, 0, 0 },{ 0, 0 } },
+                BlockFaceVertex{ { 0, 0, 1 },{ 1, 0 } },
+                BlockFaceVertex{ { 0, 1, 1 },{ 1, 1 } },
+                BlockFaceVertex{ { 0, 1, 0 },{ 0, 1 } }
             },
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 0.0f, 1.0f, 1.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 1.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 0.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 0.0f, 1.0f, 0.0f },{ 0.0f, 1.0f } }
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 0, 1, 1 },{ 0, 0 } },
+                BlockFaceVertex{ { 1, 1, 1 },{ 1, 0 } },
+                BlockFaceVertex{ { 1, 1, 0 },{ 1, 1 } },
+                BlockFaceVertex{ { 0, 1, 0 },{ 0, 1 } }
             },
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 0.0f, 1.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 0.0f, 0.0f, 1.0f },{ 0.0f, 1.0f } }
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 0, 0, 0 },{ 0, 0 } },
+                BlockFaceVertex{ { 1, 0, 0 },{ 1, 0 } },
+                BlockFaceVertex{ { 1, 0, 1 },{ 1, 1 } },
+                BlockFaceVertex{ { 0, 0, 1 },{ 0, 1 } }
             },
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 0.0f, 0.0f, 1.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 0.0f, 1.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 1.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 0.0f, 1.0f, 1.0f },{ 0.0f, 1.0f } }
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 0, 0, 1 },{ 0, 0 } },
+                BlockFaceVertex{ { 1, 0, 1 },{ 1, 0 } },
+                BlockFaceVertex{ { 1, 1, 1 },{ 1, 1 } },
+                BlockFaceVertex{ { 0, 1, 1 },{ 0, 1 } }
             },
-            std::array<BlockVertex, 4>{
-                BlockVertex{ { 1.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
-                BlockVertex{ { 0.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } },
-                BlockVertex{ { 0.0f, 1.0f, 0.0f },{ 1.0f, 1.0f } },
-                BlockVertex{ { 1.0f, 1.0f, 0.0f },{ 0.0f, 1.0f } }
+            std::array<BlockFaceVertex, 4>{
+                BlockFaceVertex{ { 1, 0, 0 },{ 0, 0 } },
+                BlockFaceVertex{ { 0, 0, 0 },{ 1, 0 } },
+                BlockFaceVertex{ { 0, 1, 0 },{ 1, 1 } },
+                BlockFaceVertex{ { 1, 1, 0 },{ 0, 1 } }
             },
         };
 
@@ -4,8 +4,10 @@
 #include <string>
 
 #include "GameRenderer.h"
+#include "CameraPath.h"
 
 #include "map/Map.h"
+#include "map/MapRenderer.h"
 
 class Game
 {
@@ -17,13 +19,24 @@ public:
     Map& map();
     const Map& map() const;
 
+    MapRenderer& mapRenderer();
+    const MapRenderer& mapRenderer() const;
+
     const ls::gl::Camera& camera() const;
 
 private:
     GameRenderer m_renderer;
     std::unique_ptr<Map> m_map;
+    // needs the assets, so it's created with the map
+    std::unique_ptr<MapRenderer> m_mapRenderer;
+    CameraPath m_cameraPath;
+    bool m_isRecordingCameraPath;
 
     static constexpr float m_tickTime = 1.0f / 20.0f;
 
     void handleInput(float dt);
+    // F12, for opening in chrome://tracing
+    void writeProfilerTrace();
+    // F11, the camera is recorded every tick until the next press, for replaying in voxel_bench
+    void toggleCameraPathRecording();
 };
\ No newline at end of file
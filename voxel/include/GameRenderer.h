@@ -10,6 +10,7 @@ class GameRenderer
 {
 public:
     GameRenderer();
+    ~GameRenderer();
 
     void draw(Game& game, float dt);
 
@@ -31,5 +32,5 @@ private:
     static constexpr float m_defaultFov = 45.0f;
 
     void onWindowResized(const sf::Event& e);
-    void updateFpsMeasures(float dt);
+    void updateFpsMeasures(const Game& game, float dt);
 };
\ No newline at end of file
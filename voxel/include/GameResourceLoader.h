@@ -8,13 +8,12 @@ class GameResourceLoader
 public:
     static void loadAssets();
     static void loadTextures();
+    // doesn't need a GL context
     static void loadBlocks();
     static void loadShaders();
 
 private:
     static bool m_areAssetsLoaded;
 
-    static std::wstring stringToWString(const std::string &s);
-    static std::string wstringToString(const std::wstring &s);
-    static std::vector<std::string> scanForFiles(const std::string& path, const std::string& query);
+    static std::vector<std::string> scanForFiles(const std::string& path, const std::string& extension);
 };
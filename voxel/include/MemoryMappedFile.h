@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read only view of a whole file mapped into memory.
+// The file may still be written to through other handles.
+class MemoryMappedFile
+{
+public:
+    // throws when the file can't be opened or mapped
+    explicit MemoryMappedFile(const std::string& path);
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    const uint8_t* data() const;
+    size_t size() const;
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+#if defined(_WIN32)
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+};
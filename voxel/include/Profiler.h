@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// Records scoped zones of all threads to be viewed in chrome://tracing.
+// Each thread writes to its own ring buffer, the oldest zones are dropped when it is full.
+// Zones are recorded only when VOXEL_PROFILING is defined, otherwise the macros expand to nothing.
+class Profiler
+{
+public:
+    class Zone
+    {
+    public:
+        // the name is not copied, string literals are expected
+        explicit Zone(const char* name);
+        ~Zone();
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* m_name;
+        int64_t m_begin;
+    };
+
+    static Profiler& instance();
+
+    static constexpr bool isEnabled()
+    {
+#if defined(VOXEL_PROFILING)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void setThreadName(const std::string& name);
+
+    // returns false if the file could not be written
+    bool writeChromeTrace(const std::string& path);
+
+private:
+    struct ZoneRecord
+    {
+        const char* name;
+        int64_t begin; // nanoseconds since the profiler was created
+        int64_t end;
+    };
+
+    struct ThreadBuffer
+    {
+        std::mutex mutex; // only contended while a trace is written
+        std::string threadName;
+        int threadId;
+        std::vector<ZoneRecord> records;
+        size_t next;
+    };
+
+    static constexpr size_t m_bufferCapacity = 1 << 16;
+
+    std::mutex m_mutex;
+    // buffers outlive their threads so zones of finished threads can still be written
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    std::chrono::steady_clock::time_point m_start;
+
+    static thread_local ThreadBuffer* m_currentThreadBuffer;
+
+    Profiler();
+
+    ThreadBuffer& currentThreadBuffer();
+    int64_t now() const;
+    void record(const char* name, int64_t begin, int64_t end);
+};
+
+#if defined(VOXEL_PROFILING)
+#define PROFILER_CONCAT_IMPL(A, B) A ## B
+#define PROFILER_CONCAT(A, B) PROFILER_CONCAT_IMPL(A, B)
+#define PROFILE_ZONE(NAME) const Profiler::Zone PROFILER_CONCAT(profilerZone, __LINE__)(NAME)
+#define PROFILE_THREAD_NAME(NAME) Profiler::instance().setThreadName(NAME)
+#else
+#define PROFILE_ZONE(NAME) ((void)0)
+#define PROFILE_THREAD_NAME(NAME) ((void)0)
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Persistent pool of worker threads with a job queue per worker.
+// Jobs are ordered by priority, lower value runs first, equal priorities run in submission order.
+// Jobs submitted from outside of the pool go to a shared queue, jobs spawned by a worker stay on its queue.
+// A worker takes the more important of the top jobs of the shared queue and its own queue,
+// when both are empty it steals the most important of the top jobs of the other workers.
+// The order is only strict within one queue, a job of another worker's queue
+// can run before a more important job that's waiting behind it.
+class ThreadPool
+{
+private:
+    struct JobState
+    {
+        std::atomic<bool> isCancelled{ false };
+        bool isDone = false;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+public:
+    class JobHandle
+    {
+    public:
+        JobHandle() = default;
+
+        // the job is skipped if it has not started yet
+        void cancel();
+        bool isCancelled() const;
+        bool isDone() const;
+        void wait() const;
+
+        bool isValid() const;
+
+    private:
+        friend class ThreadPool;
+
+        std::shared_ptr<JobState> m_state;
+
+        JobHandle(std::shared_ptr<JobState> state);
+    };
+
+    static ThreadPool& instance();
+
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    JobHandle submit(int priority, std::function<void()> job);
+
+    size_t numThreads() const;
+
+private:
+    struct Job
+    {
+        int priority;
+        uint64_t sequenceNumber;
+        std::function<void()> function;
+        std::shared_ptr<JobState> state;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::vector<Job> jobs; // binary heap, top is the most important job
+    };
+
+    WorkerQueue m_sharedQueue;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    std::atomic<size_t> m_numQueuedJobs;
+    std::atomic<uint64_t> m_nextSequenceNumber;
+    bool m_isStopping;
+
+    static thread_local int m_currentWorkerIndex;
+
+    static bool isLessImportant(const Job& lhs, const Job& rhs);
+
+    void workerLoop(int workerIndex);
+    // only the priority and the sequence number of the top job are copied
+    static bool tryPeek(WorkerQueue& queue, Job& top);
+    bool tryPop(WorkerQueue& queue, Job& job);
+    bool tryTakeJob(int workerIndex, Job& job);
+    void run(Job& job);
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Hash of integer positions for unordered containers keyed by chunk or column positions.
+// Each coordinate is multiplied by a large prime, so neighbouring positions spread over the buckets.
+struct Vec3IHasher
+{
+    size_t operator()(const ls::Vec3I& pos) const
+    {
+        return
+            (static_cast<size_t>(static_cast<uint32_t>(pos.x)) * 73856093u)
+            ^ (static_cast<size_t>(static_cast<uint32_t>(pos.y)) * 19349663u)
+            ^ (static_cast<size_t>(static_cast<uint32_t>(pos.z)) * 83492791u);
+    }
+};
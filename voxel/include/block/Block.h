@@ -2,13 +2,20 @@
 
 #include <memory>
 #include <iostream>
+#include <cassert>
 
 #include "../LibS/Json.h"
+#include "../LibS/Shapes/Vec2.h"
 #include "../LibS/Shapes/Vec3.h"
 
 #include "BlockSideOpacity.h"
+#include "BlockMemoryPool.h"
+#include "BlockTypeRegistry.h"
+
+#include "CubeSide.h"
 
 class Map;
+class BlockFactory;
 struct BlockVertex;
 
 template <class BlockType>
@@ -30,6 +37,8 @@ class Block
 public:
     virtual bool isStateful() = 0;
 
+    virtual const BlockFactory& factory() const = 0;
+
     virtual void onBlockPlaced(Map& map, const ls::Vec3I& pos)
     {
     }
@@ -39,6 +48,13 @@ public:
     virtual void onAdjacentBlockChanged(Map& map, const ls::Vec3I& thisPos, Block& changedBlock, const ls::Vec3I& changedBlockPos)
     {
     }
+    // has to return true when any of the above hooks is overridden,
+    // otherwise calling them may be skipped
+    virtual bool hasHooks() const
+    {
+        return false;
+    }
+    // position is local to the chunk, blocks covered from all sides are not drawn
     virtual void draw(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, const ls::Vec3I& position, BlockSideOpacity outsideOpacity) const
     {
     }
@@ -46,6 +62,17 @@ public:
     {
         return BlockSideOpacity::none();
     }
+    // Cube if the block draws nothing but full cube faces with a single tile each,
+    // then equal faces of adjacent blocks can be merged into one quad
+    virtual BlockMesherKind mesherKind() const
+    {
+        return BlockMesherKind::Custom;
+    }
+    // grid coords of the tile in the spritesheet
+    virtual ls::Vec2I faceTile(CubeSide side) const
+    {
+        return ls::Vec2I(0, 0);
+    }
 
     virtual ~Block()
     {
@@ -67,6 +94,9 @@ public:
     }
 };
 
+// BlockType is the most derived type, its instances are allocated from
+// a pool of the type, also the ones made by clone()
+template <class BlockType>
 class StatefulBlock : public Block
 {
 public:
@@ -78,4 +108,18 @@ public:
     {
         return true;
     }
+
+    static void* operator new(size_t size)
+    {
+        // a type deriving from BlockType would need a bigger slot than the pool has
+        assert(size == sizeof(BlockType));
+
+        return BlockMemoryPool<BlockType>::instance().allocate();
+    }
+    static void operator delete(void* ptr)
+    {
+        if (ptr == nullptr) return;
+
+        BlockMemoryPool<BlockType>::instance().deallocate(ptr);
+    }
 };
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "BlockTypeRegistry.h"
+
 class Block;
 
 class BlockContainer
 {
 public:
-    BlockContainer(Block* block);
+    BlockContainer(Block* block, BlockTypeId typeId);
 
     BlockContainer();
     BlockContainer(const BlockContainer& other);
@@ -18,10 +20,15 @@ public:
     const Block& block() const;
     Block& block();
 
+    // known without touching the block
+    BlockTypeId typeId() const;
+    bool isStateful() const;
+
     bool isEmpty() const;
 
     ~BlockContainer();
 
 private:
     Block* m_block;
+    BlockTypeId m_typeId;
 };
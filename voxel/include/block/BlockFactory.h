@@ -1,25 +1,23 @@
 #pragma once
 
 #include "BlockContainer.h"
+#include "BlockTypeRegistry.h"
 
 #include "../LibS/Json.h"
 
+#include <string>
+
 class BlockFactory
 {
 public:
     virtual BlockContainer instantiate() const = 0;
 
-    virtual int typeId() const = 0;
+    // indexes the tables of BlockTypeRegistry
+    virtual BlockTypeId typeId() const = 0;
+    // name from the config, stable between runs unlike the type id
+    virtual const std::string& name() const = 0;
 
     virtual ~BlockFactory() {};
-
-protected:
-    int getNextTypeId() const
-    {
-        static int prevId = -1;
-
-        return ++prevId;
-    }
 };
 
 template <class BlockType>
@@ -29,7 +27,8 @@ public:
     using BlockSharedDataType = typename BlockType::SharedData;
 
     SpecificBlockFactory(const ls::json::Value& config) : // or some other way of passing the config
-        m_typeId(getNextTypeId()),
+        m_typeId(BlockTypeRegistry::instance().reserveTypeId()),
+        m_name(config["name"].getString()),
         m_sharedData(std::make_unique<const BlockSharedDataType>(*this, config)),
         m_singleton(nullptr)
     {
@@ -37,29 +36,36 @@ public:
         {
             m_singleton = std::make_unique<BlockType>(*m_sharedData);
         }
+
+        BlockTypeRegistry::instance().registerType(m_typeId, m_singleton.get());
     }
 
     BlockContainer instantiate() const override
     {
         if (BlockType::isStatefulStatic())
         {
-            return BlockContainer(new BlockType(*m_sharedData));
+            return BlockContainer(new BlockType(*m_sharedData), m_typeId);
         }
         else
         {
-            return BlockContainer(m_singleton.get());
+            return BlockContainer(m_singleton.get(), m_typeId);
         }
     }
 
-    int typeId() const override
+    BlockTypeId typeId() const override
     {
         return m_typeId;
     }
+    const std::string& name() const override
+    {
+        return m_name;
+    }
 
     ~SpecificBlockFactory() override = default;
 
 private:
-    int m_typeId;
+    BlockTypeId m_typeId;
+    std::string m_name;
     std::unique_ptr<const BlockSharedDataType> m_sharedData;
     std::unique_ptr<BlockType> m_singleton;
 };
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../LibS/Memory/HomogeneousMemoryPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// Allocation counters of all stateful block pools.
+// Exploring in a steady state should not make the pools grow.
+class BlockAllocationCounters
+{
+public:
+    struct Stats
+    {
+        uint64_t numAllocations;
+        uint64_t numDeallocations;
+        // pools growing, the only time the heap is touched
+        uint64_t numHeapAllocations;
+        // cells in all pools
+        uint64_t capacity;
+    };
+
+    static BlockAllocationCounters& instance();
+
+    BlockAllocationCounters(const BlockAllocationCounters&) = delete;
+    BlockAllocationCounters& operator=(const BlockAllocationCounters&) = delete;
+
+    void onPoolCreated(size_t numCells);
+    // numNewCells is nonzero when the pool had to grow
+    void onAllocated(size_t numNewCells);
+    void onDeallocated();
+
+    Stats stats() const;
+
+private:
+    std::atomic<uint64_t> m_numAllocations;
+    std::atomic<uint64_t> m_numDeallocations;
+    std::atomic<uint64_t> m_numHeapAllocations;
+    std::atomic<uint64_t> m_capacity;
+
+    BlockAllocationCounters();
+};
+
+// Storage for all instances of one stateful block type.
+// Blocks are created by generation jobs and destroyed on the main thread, so it is locked.
+template <class BlockType>
+class BlockMemoryPool
+{
+public:
+    static BlockMemoryPool& instance()
+    {
+        static BlockMemoryPool pool;
+        return pool;
+    }
+
+    BlockMemoryPool(const BlockMemoryPool&) = delete;
+    BlockMemoryPool& operator=(const BlockMemoryPool&) = delete;
+
+    // uninitialized storage for one block
+    void* allocate()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        const size_t capacityBefore = m_pool.capacity();
+        void* ptr = m_pool.requestMemory();
+        BlockAllocationCounters::instance().onAllocated(m_pool.capacity() - capacityBefore);
+
+        return ptr;
+    }
+    // the block has to be destroyed already
+    void deallocate(void* ptr)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_pool.abandonMemory(ptr);
+        BlockAllocationCounters::instance().onDeallocated();
+    }
+
+private:
+    std::mutex m_mutex;
+    ls::mem::HomogeneousMemoryPool<BlockType> m_pool;
+
+    BlockMemoryPool()
+    {
+        BlockAllocationCounters::instance().onPoolCreated(m_pool.capacity());
+    }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec2.h"
+
+#include "BlockSideOpacity.h"
+
+#include "CubeSide.h"
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+class Block;
+
+using BlockTypeId = uint16_t;
+
+// how the faces of a block end up in a chunk mesh
+enum class BlockMesherKind : uint8_t
+{
+    None, // draws nothing
+    Cube, // full cube faces with a single tile each, equal faces of adjacent blocks can be merged
+    Custom // drawn by the block itself
+};
+
+// Properties of every block type in flat tables indexed by the type id,
+// so the hot loops over chunks don't have to dereference stateless blocks.
+// Stateful blocks may differ between instances, so their entries only mark them as such
+// and the properties have to be queried from the block.
+// Types are registered while the resources are loaded, later the tables are read only
+// and can be used from any thread.
+class BlockTypeRegistry
+{
+public:
+    // used by empty block containers
+    static constexpr BlockTypeId emptyTypeId = 0;
+
+    static BlockTypeRegistry& instance();
+
+    BlockTypeRegistry(const BlockTypeRegistry&) = delete;
+    BlockTypeRegistry& operator=(const BlockTypeRegistry&) = delete;
+
+    BlockTypeId reserveTypeId();
+    // statelessBlock is the instance shared by all blocks of the type, nullptr for stateful types
+    void registerType(BlockTypeId typeId, const Block* statelessBlock);
+
+    size_t numTypes() const;
+
+    bool isStateful(BlockTypeId typeId) const
+    {
+        return m_isStateful[typeId];
+    }
+    BlockSideOpacity sideOpacity(BlockTypeId typeId) const
+    {
+        return m_sideOpacity[typeId];
+    }
+    // grid coords of the tile in the spritesheet
+    const ls::Vec2I& faceTile(BlockTypeId typeId, CubeSide side) const
+    {
+        return m_faceTiles[typeId][side.ordinal()];
+    }
+    BlockMesherKind mesherKind(BlockTypeId typeId) const
+    {
+        return m_mesherKind[typeId];
+    }
+    bool hasHooks(BlockTypeId typeId) const
+    {
+        return m_hasHooks[typeId];
+    }
+
+private:
+    std::vector<uint8_t> m_isStateful;
+    std::vector<BlockSideOpacity> m_sideOpacity;
+    std::vector<std::array<ls::Vec2I, 6>> m_faceTiles;
+    std::vector<BlockMesherKind> m_mesherKind;
+    std::vector<uint8_t> m_hasHooks;
+
+    static constexpr size_t m_maxNumTypes = 0x10000;
+
+    BlockTypeRegistry();
+
+    void resize(size_t numTypes);
+};
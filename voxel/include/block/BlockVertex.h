@@ -3,18 +3,50 @@
 #include "../LibS/Shapes/Vec2.h"
 #include "../LibS/Shapes/Vec3.h"
 
+#include <cstdint>
+
+// corner of a face of a unit cube
+struct BlockFaceVertex
+{
+    constexpr BlockFaceVertex(const ls::Vec3I& pos, const ls::Vec2I& uv) :
+        pos(pos),
+        uv(uv)
+    {
+
+    }
+
+    ls::Vec3I pos;
+    ls::Vec2I uv;
+};
+
+// Terrain vertex packed into 8 bytes.
+// Position is local to the chunk, the shader adds the chunk origin.
+// Uv is in tiles and repeats past 1 so merged faces can share a quad,
+// tile is the grid position of the texture in the spritesheet.
 struct BlockVertex
 {
+    static constexpr uint32_t maxLocalCoord = 63; // enough for 32 + 1 corner
+    static constexpr uint32_t maxTileCoord = 0xFFFF;
+
     constexpr BlockVertex() :
-        pos(0, 0, 0),
-        uv(0, 0)
+        packedPosUv(0),
+        packedTile(0)
     {
 
     }
 
-    constexpr BlockVertex(const ls::Vec3F& pos, const ls::Vec2F& uv) :
-        pos(pos),
-        uv(uv)
+    constexpr BlockVertex(const ls::Vec3I& localPos, const ls::Vec2I& uv, const ls::Vec2I& tile) :
+        packedPosUv(
+            static_cast<uint32_t>(localPos.x)
+            | (static_cast<uint32_t>(localPos.y) << 6)
+            | (static_cast<uint32_t>(localPos.z) << 12)
+            | (static_cast<uint32_t>(uv.x) << 18)
+            | (static_cast<uint32_t>(uv.y) << 24)
+        ),
+        packedTile(
+            static_cast<uint32_t>(tile.x)
+            | (static_cast<uint32_t>(tile.y) << 16)
+        )
     {
 
     }
@@ -24,6 +56,8 @@ struct BlockVertex
     constexpr BlockVertex& operator=(const BlockVertex&) = default;
     constexpr BlockVertex& operator=(BlockVertex&&) noexcept = default;
 
-    ls::Vec3F pos;
-    ls::Vec2F uv;
+    uint32_t packedPosUv; // 6 bits for each of x, y, z, u, v
+    uint32_t packedTile; // 16 bits for each of x, y
 };
+
+static_assert(sizeof(BlockVertex) == 8, "terrain vertices are expected to be tightly packed");
@@ -16,6 +16,9 @@ public:
     EmptyBlock(const SharedData& sharedData);
 
     BlockSideOpacity sideOpacity() const override;
+    BlockMesherKind mesherKind() const override;
+
+    const BlockFactory& factory() const override;
 
     ~EmptyBlock() override = default;
 
@@ -16,8 +16,7 @@ public:
     public:
         SharedData(SpecificBlockFactory<PlainBlock>& blockFactory, const ls::json::Value& config);
 
-        std::array<ls::Vec2F, 6> texCoords;
-        ls::Vec2F texSize;
+        std::array<ls::Vec2I, 6> tiles;
 
         BlockSideOpacity opacity;
     };
@@ -26,6 +25,10 @@ public:
 
     void draw(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, const ls::Vec3I& position, BlockSideOpacity outsideOpacity) const override;
     BlockSideOpacity sideOpacity() const override;
+    BlockMesherKind mesherKind() const override;
+    ls::Vec2I faceTile(CubeSide side) const override;
+
+    const BlockFactory& factory() const override;
 
     ~PlainBlock() override = default;
 
@@ -1,35 +1,50 @@
 #pragma once
 
-#include <map>
-#include <future>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <string>
 
 #include "MapChunk.h"
-#include "MapRenderer.h"
+#include "MapChunkIndex.h"
+#include "MapChunkLoadQueue.h"
 #include "MapGenerator.h"
+#include "MapRegionStorage.h"
+#include "MapResidency.h"
 
 #include "../LibS/Shapes/Vec3.h"
-#include "../LibS/OpenGL/Camera.h"
 
 #include "ResourceManager.h"
-
-class Game;
+#include "ThreadPool.h"
+#include "Vec3IHasher.h"
 
 class Map
 {
 public:
     Map(uint32_t seed);
+    Map(uint32_t seed, const std::string& saveDirectory);
+    ~Map();
+
+    Map(const Map&) = delete;
+    Map& operator=(const Map&) = delete;
+
+    MapChunkIndex& chunks();
+    const MapChunkIndex& chunks() const;
 
-    std::map<ls::Vec3I, MapChunk>& chunks();
-    const std::map<ls::Vec3I, MapChunk>& chunks() const;
+    // chunks are loaded and unloaded around the camera
+    void update(const ls::Vec3F& cameraPos, float dt);
 
-    void draw(const ls::gl::Camera& camera, float dt);
+    const MapGenerator& generator() const;
 
-    void update(Game& game, float dt);
+    const MapResidency& residency() const;
+    // least recently visible chunks are unloaded while the loaded chunks use more memory
+    void setMemoryBudget(size_t bytes);
+    void markChunkVisible(const ls::Vec3I& pos);
+    void onChunkMemoryUsageChanged(const ls::Vec3I& pos, const MapChunkMemoryUsage& previousUsage, const MapChunkMemoryUsage& usage);
 
     ls::Vec3I worldToChunk(const ls::Vec3F& worldPos) const;
 
-    bool isValidChunkPos(const ls::Vec3I& pos) const;
+    static bool isValidChunkPos(const ls::Vec3I& pos);
 
     MapChunk* chunkAt(const ls::Vec3I& pos);
 
@@ -42,18 +57,29 @@ public:
     static int distanceBetweenChunks(const ls::Vec3I& lhs, const ls::Vec3I& rhs);
 
 private:
-    MapRenderer m_renderer;
     MapGenerator m_generator;
     uint32_t m_seed;
     ResourceHandle<BlockFactory> m_airFactory;
-    std::map<ls::Vec3I, MapChunk> m_chunks;
-    std::future<std::vector<std::pair<ls::Vec3I, MapChunkBlockData>>> m_generatedChunks;
-
-    float m_timeSinceLastMissingChunkPosCacheUpdate;
-    std::vector<ls::Vec3I> m_missingChunkPosCache;
-    std::vector<ls::Vec3I> m_missingChunksInGeneration;
-    size_t m_missingChunkPosCacheCurrentPosition;
-    ls::Vec3I m_missingChunkPosCacheLastOrigin;
+    // modified chunks are saved when unloaded
+    MapRegionStorage m_regions;
+    MapChunkIndex m_chunks;
+    MapResidency m_residency;
+    // chunks that may have gone out of the unloading distance
+    std::vector<ls::Vec3I> m_farChunkCandidates;
+    ls::Vec3I m_farChunkCandidatesLastOrigin;
+    std::unordered_map<ls::Vec3I, ThreadPool::JobHandle, Vec3IHasher> m_chunksInGeneration;
+    // filled by the generation jobs as they finish
+    std::vector<MapChunkBlockData> m_generatedChunks;
+    std::mutex m_generatedChunksMutex;
+
+    MapChunkLoadQueue m_missingChunks;
+    // queued again as missing with the next rekey
+    std::vector<ls::Vec3I> m_evictedChunks;
+    float m_timeSinceLastMissingChunksRekey;
+    ls::Vec3I m_missingChunksLastRekeyOrigin;
+    // cached generation results only become far when the current chunk changes
+    ls::Vec3I m_generatorCachesLastEvictionOrigin;
+    float m_timeSinceLastStorageReserveTrim;
 
     static constexpr int m_maxWorldHeight = 256;
     static_assert(m_maxWorldHeight % MapChunk::height() == 0);
@@ -61,23 +87,36 @@ private:
     static constexpr int m_minChunkDistanceToUnload = 16;
     //static constexpr int m_minChunkDistanceToUnload = 22;
 
-    static constexpr float m_timeBetweenMissingChunkPosCacheUpdates = 1.0f;
+    // priorities of the missing chunks that got nearer are fixed this often when the camera moves
+    static constexpr float m_timeBetweenMissingChunksRekeys = 1.0f;
+    // reserved buffers unused for this long are freed
+    static constexpr float m_timeBetweenStorageReserveTrims = 5.0f;
 
     static constexpr int m_chunkLoadingRange = 14;
     //static constexpr int m_chunkLoadingRange = 20;
 
     //static constexpr int m_maxChunksSpawnedPerUpdate = 8;
     static constexpr int m_maxChunksSpawnedPerUpdate = 16;
+    // kept low enough for the priorities to follow the camera
+    static constexpr int m_maxChunksInGenerationPerThread = 4;
     static constexpr int m_maxChunksRemovedPerUpdate = 16;
+    static constexpr size_t m_defaultMemoryBudget = size_t(1) << 30;
 
     void trySpawnNewChunks(const ls::Vec3I& currentChunk);
+    void spawnGeneratedChunks();
+    void cancelFarChunkGeneration(const ls::Vec3I& currentChunk);
+    void requestChunkGeneration(const ls::Vec3I& currentChunk);
+    bool isChunkInGeneration(const ls::Vec3I& pos) const;
     void spawnChunk(const ls::Vec3I& pos);
     void spawnChunk(const ls::Vec3I& pos, MapChunkBlockData&& chunk);
     void unloadFarChunks(const ls::Vec3I& currentChunk);
-    std::map<ls::Vec3I, MapChunk>::iterator unloadChunk(const std::map<ls::Vec3I, MapChunk>::iterator& iter);
-
-    std::vector<std::pair<ls::Vec3I, MapChunkBlockData>> generateChunksIsolated(const std::vector<ls::Vec3I>& positions);
-    std::pair<ls::Vec3I, MapChunkBlockData> generateChunkIsolated(const ls::Vec3I& pos);
-
-    void updateMissingChunkPosCache(const ls::Vec3I& pos);
+    // only the chunks that were in range of the previous origin are visited
+    void collectFarChunkCandidates(const ls::Vec3I& previousOrigin, const ls::Vec3I& origin);
+    void evictChunksOverBudget();
+    bool unloadChunk(const ls::Vec3I& pos);
+    MapChunkIndex::iterator unloadChunk(const MapChunkIndex::iterator& iter);
+
+    void generateChunkIsolated(const ls::Vec3I& pos);
+    // saved chunks are preferred over generating them again
+    void loadOrGenerateChunk(MapChunkBlockData& chunk);
 };
@@ -2,148 +2,66 @@
 
 #include "../LibS/Shapes/Vec3.h"
 #include "../LibS/Shapes/Sphere3.h"
+#include "../LibS/Shapes/Box3.h"
 #include "../LibS/Array3.h"
 
 #include "block/BlockContainer.h"
 #include "block/BlockFactory.h"
 #include "block/BlockSideOpacity.h"
+#include "block/BlockTypeRegistry.h"
 
 #include "MapChunkRenderer.h"
+#include "MapChunkBlockStorage.h"
+#include "MapChunkStorageReserve.h"
+#include "MapChunkFaceConnectivity.h"
+#include "MapResidency.h"
 
-#include <queue>
 #include <vector>
-#include <mutex>
+#include <array>
 
 class MapChunk;
 class Map;
 class MapGenerator;
 
-namespace detail
-{
-    constexpr size_t m_chunkWidth = 32;
-    constexpr size_t m_chunkHeight = 32;
-    constexpr size_t m_chunkDepth = 32;
-
-    using BlockArray = ls::Array3<BlockContainer, m_chunkWidth, m_chunkHeight, m_chunkDepth>;
-    using BlockSideOpacityArray = ls::Array3<BlockSideOpacity, m_chunkWidth, m_chunkHeight, m_chunkDepth>;
-
-    template<class Data>
-    class concurrent_queue
-    {
-    private:
-        std::queue<Data> the_queue;
-        mutable std::mutex the_mutex;
-    public:
-        template <class... Args>
-        void emplace(Args&&... args)
-        {
-            std::unique_lock<std::mutex> lock(the_mutex);
-            the_queue.emplace(std::forward<Args>(args)...);
-            lock.unlock();
-        }
-        void push(Data&& data)
-        {
-            std::unique_lock<std::mutex> lock(the_mutex);
-            the_queue.emplace(std::move(data));
-            lock.unlock();
-        }
-
-        bool empty() const
-        {
-            return the_queue.empty();
-        }
-
-        Data pop()
-        {
-            std::unique_lock<std::mutex> lock(the_mutex);
-            Data d = std::move(the_queue.front());
-            the_queue.pop();
-            lock.unlock();
-            return d;
-        }
-    };
-}
-
 using MapChunkNeighbours = PerCubeSideData<MapChunk*>;
 
-class MapChunkStorageReserve
-{
-public:
-    static MapChunkStorageReserve& instance()
-    {
-        static MapChunkStorageReserve singleton;
-
-        return singleton;
-    }
-
-    void storeBlockArray(detail::BlockArray&& arr)
-    {
-        arr.fill(nullptr);
-        m_blockArrays.emplace(std::move(arr));
-    }
-    detail::BlockArray loadBlockArray()
-    {
-        if (m_blockArrays.empty()) createBlockArray();
-        return m_blockArrays.pop();
-    }
-    void storeOpacityArray(detail::BlockSideOpacityArray&& arr)
-    {
-        arr.fill(BlockSideOpacity::none());
-        m_opacityArrays.emplace(std::move(arr));
-    }
-    detail::BlockSideOpacityArray loadOpacityArray()
-    {
-        if (m_opacityArrays.empty()) createOpacityArray();
-        return m_opacityArrays.pop();
-    }
-
-    void createBlockArray()
-    {
-        m_blockArrays.emplace(nullptr);
-    }
-    void createOpacityArray()
-    {
-        m_opacityArrays.emplace(BlockSideOpacity::none());
-    }
-
-private:
-    detail::concurrent_queue<detail::BlockArray> m_blockArrays;
-    detail::concurrent_queue<detail::BlockSideOpacityArray> m_opacityArrays;
-};
-
 class MapChunkBlockData
 {
-    using BlockArray = detail::BlockArray;
 public:
     Map* map;
     ls::Vec3I pos;
     uint32_t seed;
-    BlockArray blocks;
+    MapChunkBlockStorage blocks;
 
     MapChunkBlockData(Map& map, MapGenerator& mapGenerator, const ls::Vec3I& pos);
+    // blocks are left empty to be filled by the caller
+    MapChunkBlockData(Map& map, const ls::Vec3I& pos);
 
     MapChunkBlockData(const MapChunkBlockData&) = delete;
     MapChunkBlockData& operator=(const MapChunkBlockData&) = delete;
     MapChunkBlockData(MapChunkBlockData&&) noexcept = default;
     MapChunkBlockData& operator=(MapChunkBlockData&&) noexcept = default;
 
-    ~MapChunkBlockData();
-
     ls::Vec3I firstBlockPosition() const;
 };
 
 class MapChunk
 {
     friend class MapChunkBlockData;
+    friend class MapChunkSnapshot;
 
     static constexpr size_t m_width = detail::m_chunkWidth;
     static constexpr size_t m_height = detail::m_chunkHeight;
     static constexpr size_t m_depth = detail::m_chunkDepth;
 
-    using BlockArray = detail::BlockArray;
-    using BlockSideOpacityArray = detail::BlockSideOpacityArray;
+    using BlockOpacityMaskArray = detail::BlockOpacityMaskArray;
+    // one bit per block on a chunk face, see borderOpacityRowAndBit
+    using BorderOpacityPlane = std::array<uint32_t, 32>;
 
 public:
+    // outside opacity of a column of blocks along z, one bit per block
+    using OutsideOpacityRow = PerCubeSideData<uint32_t>;
+
     MapChunk(Map& map, const ls::Vec3I& pos, const MapChunkNeighbours& neighbours);
     MapChunk(MapChunkBlockData&& chunkBlockData, const MapChunkNeighbours& neighbours);
 
@@ -170,17 +88,41 @@ public:
 
     void updateAllAsIfPlaced();
 
-    BlockContainer& at(const ls::Vec3I& localPos);
+    // rebuilds the opacity masks from all blocks, placing and removing a block only patches its own bits
+    void updateBlockOpacityMasks();
+
     const BlockContainer& at(const ls::Vec3I& localPos) const;
 
     const ls::Sphere3F& boundingSphere() const;
+    // the same sphere for any chunk position, also one that's not loaded
+    static ls::Sphere3F computeBoundingSphere(const ls::Vec3I& pos);
+    // the largest box of solid blocks that starts at a face of the chunk, in local coordinates with exclusive max,
+    // min == max when no face has a solid layer
+    const ls::Box3I& occluderBox() const;
+    // faces that can see each other through blocks that are not solid
+    const MapChunkFaceConnectivity& faceConnectivity() const;
 
-    const BlockArray& blocks() const;
-    const BlockSideOpacityArray& outsideOpacityCache() const;
+    const MapChunkBlockStorage& blocks() const;
+    BlockSideOpacity outsideOpacity(const ls::Vec3I& localPos) const;
+    OutsideOpacityRow outsideOpacityRow(int x, int y) const;
 
-    void draw(float dt, int& numUpdatedChunksOnDraw);
+    // all blocks are the same, the chunk has no opacity masks then
+    bool isUniform() const;
+
+    // blocks were placed or removed since the chunk was generated or loaded
+    bool isDirty() const;
+
+    static BlockSideOpacity outsideOpacityAt(const OutsideOpacityRow& row, int z);
+
+    // the mesh is added to the draw list, it's drawn together with the other chunks
+    void draw(float dt, MapChunkMeshUpdateBudget& budget, MapChunkMeshArena::DrawList& drawList);
     void tooFarToDraw(float dt);
-    void culled(float dt, int& numUpdatedChunksOnCull);
+    void culled(float dt, MapChunkMeshUpdateBudget& budget);
+    void unreached(float dt);
+    size_t numMeshVertices() const;
+
+    // as last reported to the map
+    const MapChunkMemoryUsage& memoryUsage() const;
 
     uint32_t seed() const;
 
@@ -202,18 +144,43 @@ private:
     uint32_t m_seed;
     ls::Vec3I m_pos;
     ls::Sphere3F m_boundingSphere;
+    ls::Box3I m_occluderBox;
+    MapChunkFaceConnectivity m_faceConnectivity;
     MapChunkRenderer m_renderer;
-    BlockArray m_blocks;
-    BlockSideOpacityArray m_outsideOpacityCache;
+    MapChunkBlockStorage m_blocks;
+    bool m_isDirty;
+    // opacity of the blocks themselves, outside opacity is derived from it
+    BlockOpacityMaskArray m_blockOpacityMasks;
+    // opacity of the faces of blocks in adjacent chunks, kept also for uniform chunks
+    std::array<BorderOpacityPlane, 6> m_borderOpacity;
+    MapChunkMemoryUsage m_memoryUsage;
 
     ls::Vec3I mapToLocalPos(const ls::Vec3I& mapPos) const;
-    ls::Sphere3F computeBoundingSphere();
+    // one bit per block along z for each (x, y) column, at x * height + y,
+    // set when all sides of the block are opaque
+    std::array<uint32_t, m_width * m_height> computeSolidColumns() const;
+    ls::Box3I computeOccluderBox(const std::array<uint32_t, m_width * m_height>& solidColumns) const;
+    // flood fill over runs of blocks along z
+    MapChunkFaceConnectivity computeFaceConnectivity(const std::array<uint32_t, m_width * m_height>& solidColumns) const;
+    // occluder box and face connectivity, after the opacity masks change
+    void updateVisibility();
+    MapChunkMemoryUsage computeMemoryUsage() const;
+    // reports changes to the map
+    void updateMemoryUsage();
+    // allocates the opacity masks once the chunk stops being uniform
+    void ensureBlockOpacityMasks();
     void updateOutsideOpacity(const MapChunkNeighbours& neighbours);
+    void updateBlockOpacityMask(const ls::Vec3I& localPos);
     void updateOutsideOpacityOnChunkBorders(const MapChunkNeighbours& neighbours);
     void updateOutsideOpacityOnChunkBorder(const MapChunk& other, const ls::Vec3I& otherPos);
     void updateOutsideOpacityOnAdjacentBlockChanged(const ls::Vec3I& blockToUpdateMapPos, Block& changedBlock, const ls::Vec3I& changedBlockMapPos);
 
-    BlockSideOpacity computeOutsideOpacity(ls::Vec3I blockPos, const ls::Array3<BlockSideOpacity>& cache);
-    // created cache has padding on each side, so the coords are shifted by 1
-    ls::Array3<BlockSideOpacity> createBlockOpacityCache();
+    // x is the row, y the bit
+    static ls::Vec2I borderOpacityRowAndBit(CubeSide side, const ls::Vec3I& localPos);
+    static std::array<BorderOpacityPlane, 6> createOpaqueBorderOpacity();
+    // looked up in the type registry unless the block is stateful
+    static BlockSideOpacity blockSideOpacity(const MapChunkBlockStorage& blocks, int x, int y, int z);
+    // works also for uniform chunks, which have no masks
+    static uint32_t blockOpacityMask(const MapChunkBlockStorage& blocks, const BlockOpacityMaskArray& masks, CubeSide side, int x, int y);
+    static OutsideOpacityRow computeOutsideOpacityRow(const MapChunkBlockStorage& blocks, const BlockOpacityMaskArray& masks, const std::array<BorderOpacityPlane, 6>& borderOpacity, int x, int y);
 };
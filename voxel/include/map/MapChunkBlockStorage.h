@@ -0,0 +1,84 @@
+#pragma once
+
+#include "block/BlockContainer.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class Block;
+
+// Block storage of a single chunk.
+// Each block is stored as an index to a per chunk palette.
+// Indices are bit packed and widen (1, 2, 4, 8, 16 bits) when the palette outgrows them.
+// A storage where all blocks are the same is uniform, it holds only the palette
+// and allocates the indices on the first write of a different block.
+// Stateful blocks can't share a palette entry, so all of them map
+// to a single marker entry and the instances are kept in a side table.
+class MapChunkBlockStorage
+{
+public:
+    static constexpr size_t width = 32;
+    static constexpr size_t height = 32;
+    static constexpr size_t depth = 32;
+    static constexpr size_t size = width * height * depth;
+
+    // creates an uniform storage of empty containers
+    MapChunkBlockStorage();
+
+    MapChunkBlockStorage& operator=(const MapChunkBlockStorage&) = delete;
+    MapChunkBlockStorage(MapChunkBlockStorage&&) noexcept = default;
+    MapChunkBlockStorage& operator=(MapChunkBlockStorage&&) noexcept = default;
+
+    // copies are explicit, all stateful blocks are cloned
+    MapChunkBlockStorage clone() const;
+
+    const BlockContainer& operator()(size_t x, size_t y, size_t z) const;
+    const BlockContainer& at(size_t x, size_t y, size_t z) const;
+
+    // doesn't touch the block, stateless blocks are fully described by the type
+    BlockTypeId typeIdAt(size_t x, size_t y, size_t z) const;
+
+    // for invoking block hooks, the block must not be replaced through it
+    Block& block(size_t x, size_t y, size_t z);
+
+    void set(size_t x, size_t y, size_t z, BlockContainer&& block);
+
+    // returns the block that was replaced
+    BlockContainer exchange(size_t x, size_t y, size_t z, BlockContainer&& block);
+
+    // makes the storage uniform, requires a stateless block
+    void fill(BlockContainer&& block);
+
+    bool isUniform() const;
+
+    int bitsPerBlock() const;
+    size_t paletteSize() const;
+
+    // approximate number of bytes allocated by the storage
+    size_t memoryUsage() const;
+
+private:
+    MapChunkBlockStorage(const MapChunkBlockStorage&) = default;
+
+    static constexpr uint32_t m_noPaletteIndex = 0xFFFFFFFFu;
+
+    std::vector<uint64_t> m_indices;
+    std::vector<BlockContainer> m_palette;
+    std::unordered_map<uint16_t, BlockContainer> m_statefulBlocks;
+    uint32_t m_statefulPaletteIndex;
+    int m_bitsPerBlockLog2; // negative when uniform
+
+    static size_t index(size_t x, size_t y, size_t z);
+
+    uint32_t paletteIndexAt(size_t i) const;
+    void setPaletteIndexAt(size_t i, uint32_t paletteIndex);
+
+    uint32_t findOrAddPaletteEntry(const BlockContainer& block);
+    uint32_t statefulPaletteIndex();
+    uint32_t addPaletteEntry(BlockContainer&& block);
+    void compactPalette();
+    void repack(int newBitsPerBlockLog2);
+
+    static bool isSameStatelessBlock(const BlockContainer& lhs, const BlockContainer& rhs);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CubeSide.h"
+
+#include <cstdint>
+
+// Which pairs of faces of a chunk can see each other through the blocks that are not solid,
+// one bit for each of the 15 pairs.
+class MapChunkFaceConnectivity
+{
+public:
+    static constexpr MapChunkFaceConnectivity none()
+    {
+        return MapChunkFaceConnectivity(0);
+    }
+    static constexpr MapChunkFaceConnectivity all()
+    {
+        return MapChunkFaceConnectivity(m_allPairs);
+    }
+
+    // connects every pair of the faces, one bit per CubeSide ordinal
+    void connectAll(uint8_t faces)
+    {
+        for (int a = 0; a < 6; ++a)
+        {
+            if (((faces >> a) & 1u) == 0) continue;
+
+            for (int b = a + 1; b < 6; ++b)
+            {
+                if (((faces >> b) & 1u) == 0) continue;
+
+                m_pairs |= uint16_t(1) << pairIndex(a, b);
+            }
+        }
+    }
+
+    // a face always sees itself
+    bool areConnected(CubeSide a, CubeSide b) const
+    {
+        const int ia = a.ordinal();
+        const int ib = b.ordinal();
+        if (ia == ib) return true;
+
+        const int index = ia < ib ? pairIndex(ia, ib) : pairIndex(ib, ia);
+        return ((m_pairs >> index) & 1u) != 0;
+    }
+
+    uint16_t pairs() const
+    {
+        return m_pairs;
+    }
+
+    friend bool operator==(const MapChunkFaceConnectivity& lhs, const MapChunkFaceConnectivity& rhs)
+    {
+        return lhs.m_pairs == rhs.m_pairs;
+    }
+    friend bool operator!=(const MapChunkFaceConnectivity& lhs, const MapChunkFaceConnectivity& rhs)
+    {
+        return lhs.m_pairs != rhs.m_pairs;
+    }
+
+private:
+    static constexpr uint16_t m_allPairs = (1u << 15) - 1u;
+
+    uint16_t m_pairs;
+
+    constexpr explicit MapChunkFaceConnectivity(uint16_t pairs) :
+        m_pairs(pairs)
+    {
+    }
+
+    // pairs with a < b are numbered row by row
+    static constexpr int pairIndex(int a, int b)
+    {
+        return a * 5 - a * (a - 1) / 2 + (b - a - 1);
+    }
+};
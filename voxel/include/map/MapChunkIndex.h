@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+#include "../LibS/Shapes/SphereArray3.h"
+
+#include "MapChunk.h"
+
+#include <vector>
+#include <cstdint>
+
+// Stores loaded chunks contiguously and indexes them by position.
+// Positions inside a window around the center are resolved through a toroidal grid,
+// positions outside of it through an open addressing hash table.
+// Any emplace, erase or recenter may move chunks, so pointers and iterators
+// to them must not be kept across these calls.
+// Bounding spheres of the chunks are mirrored in a separate array for batched frustum tests.
+class MapChunkIndex
+{
+public:
+    using iterator = std::vector<MapChunk>::iterator;
+    using const_iterator = std::vector<MapChunk>::const_iterator;
+
+    MapChunkIndex();
+
+    // moves chunks between the grid and the hash table so that
+    // the window becomes centered around the given chunk position
+    void recenter(const ls::Vec3I& center);
+
+    MapChunk* find(const ls::Vec3I& pos);
+    const MapChunk* find(const ls::Vec3I& pos) const;
+    bool contains(const ls::Vec3I& pos) const;
+
+    // requires: contains(chunk.pos()) == false
+    MapChunk& emplace(MapChunk&& chunk);
+
+    // returns iterator to the chunk that took place of the erased one
+    iterator erase(iterator iter);
+
+    size_t size() const;
+    bool isEmpty() const;
+
+    // at the same indices as the chunks in iteration order
+    const ls::SphereArray3F& boundingSpheres() const;
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    struct HashEntry
+    {
+        ls::Vec3I pos;
+        int32_t index;
+    };
+
+    // horizontal window is wider than the unloading distance so all chunks
+    // in the loading range are always resolved through the grid
+    static constexpr int m_windowWidthLog2 = 6;
+    static constexpr int m_windowHeightLog2 = 4;
+    static constexpr int m_windowWidth = 1 << m_windowWidthLog2;
+    static constexpr int m_windowHeight = 1 << m_windowHeightLog2;
+    static constexpr size_t m_initialHashCapacity = 64;
+    static constexpr int32_t m_emptyIndex = -1;
+
+    std::vector<MapChunk> m_chunks;
+    ls::SphereArray3F m_boundingSpheres;
+    std::vector<int32_t> m_grid;
+    std::vector<HashEntry> m_hash;
+    size_t m_hashSize;
+    ls::Vec3I m_center;
+
+    bool isInWindow(const ls::Vec3I& pos) const;
+    static bool isInWindow(const ls::Vec3I& pos, const ls::Vec3I& center);
+    static size_t gridSlot(const ls::Vec3I& pos);
+
+    int32_t findIndex(const ls::Vec3I& pos) const;
+    void setIndex(const ls::Vec3I& pos, int32_t index);
+    void removeIndex(const ls::Vec3I& pos);
+
+    size_t hashSlot(const ls::Vec3I& pos) const;
+    int32_t hashFind(const ls::Vec3I& pos) const;
+    void hashSet(const ls::Vec3I& pos, int32_t index);
+    void hashRemove(const ls::Vec3I& pos);
+    void hashGrow();
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include <vector>
+#include <cstddef>
+
+// Positions around the origin where chunks may be missing, nearest first
+// by the distance that values horizontal directions more (see priority).
+// When the origin moves only the positions that entered the loading range are added,
+// so the cost follows the movement instead of the volume of the range.
+// Priorities are kept from the time a position was added. The ones that became
+// farther are fixed when taken, the ones that became nearer when rekeyed.
+// Whether a position is still missing is up to the caller.
+// Only used from the main thread.
+class MapChunkLoadQueue
+{
+public:
+    // chunks are only loaded between minChunkY and maxChunkY, inclusive
+    MapChunkLoadQueue(int range, int minChunkY, int maxChunkY);
+
+    // the first origin adds the whole range
+    void setOrigin(const ls::Vec3I& origin);
+    // for a chunk that went missing inside the range, positions outside of it are ignored
+    void push(const ls::Vec3I& pos);
+    // returns false when there are no positions in range left
+    bool pop(ls::Vec3I& pos);
+    // recomputes the priorities for the current origin and drops the positions out of range
+    void rekey();
+
+    size_t size() const;
+
+    static int priority(const ls::Vec3I& offset);
+
+private:
+    struct Entry
+    {
+        int priority;
+        ls::Vec3I pos;
+    };
+
+    int m_range;
+    int m_minChunkY;
+    int m_maxChunkY;
+    ls::Vec3I m_origin;
+    bool m_hasOrigin;
+    // binary heap with the lowest priority at the front
+    std::vector<Entry> m_heap;
+
+    bool isInRange(const ls::Vec3I& pos) const;
+    void rangeBounds(const ls::Vec3I& origin, ls::Vec3I& min, ls::Vec3I& max) const;
+    void pushBox(const ls::Vec3I& min, const ls::Vec3I& max);
+    void pushEntry(const ls::Vec3I& pos);
+
+    static bool isFartherThan(const Entry& lhs, const Entry& rhs);
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "../LibS/OpenGL/VertexArrayObject.h"
+#include "../LibS/OpenGL/TextureBuffer.h"
+#include "../LibS/Shapes/Vec3.h"
+
+#include "block/BlockVertex.h"
+
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+// Shared vertex and index buffers for the meshes of all chunks.
+// Buffers are allocated in large pages and every mesh is a range of vertices
+// and a range of indices in one page, drawn with a base vertex,
+// so uploads only write the range and no GL objects are created per chunk.
+// Indices of a mesh stay local to its vertices.
+// All meshes in a page are drawn with a single multi draw call. The shader can't tell
+// the draws apart, so it finds the chunk origin through the vertex id instead:
+// each block of vertexGranularity vertices belongs to a single mesh and the origin
+// of its chunk is stored for it in a texture buffer of the page.
+// Pages are created with the first upload, so the arena can exist without a GL context,
+// and they have to be deleted with shutdown while the context still exists.
+// Only used from the render thread.
+class MapChunkMeshArena
+{
+public:
+    // Best fit allocator of ranges of elements with coalescing of the freed ones.
+    // Sizes are rounded up to a multiple of the granularity.
+    // Doesn't touch GL.
+    class RangeAllocator
+    {
+    public:
+        struct Range
+        {
+            size_t offset;
+            size_t size;
+        };
+
+        struct Stats
+        {
+            size_t capacity;
+            size_t numUsed;
+            size_t numAllocations;
+            size_t numFreeRanges;
+            size_t largestFreeRange;
+
+            // 0 when all free elements are in a single range, approaches 1 as they are scattered
+            double fragmentation() const;
+        };
+
+        RangeAllocator(size_t capacity, size_t granularity);
+
+        // returns false when no free range is big enough
+        bool allocate(size_t size, Range& range);
+        void free(const Range& range);
+
+        bool isEmpty() const;
+        Stats stats() const;
+
+    private:
+        size_t m_capacity;
+        size_t m_granularity;
+        size_t m_numUsed;
+        size_t m_numAllocations;
+        std::map<size_t, size_t> m_freeRangesByOffset; // offset -> size
+        std::set<std::pair<size_t, size_t>> m_freeRangesBySize; // (size, offset)
+
+        void insertFreeRange(size_t offset, size_t size);
+        void eraseFreeRange(std::map<size_t, size_t>::iterator iter);
+    };
+
+    struct Allocation
+    {
+        static constexpr size_t invalidPage = static_cast<size_t>(-1);
+
+        size_t page;
+        RangeAllocator::Range vertices;
+        RangeAllocator::Range indices;
+        size_t numVertices;
+        size_t numIndices;
+
+        static Allocation makeInvalid();
+
+        bool isValid() const;
+        // bytes reserved in the pages
+        size_t sizeInBytes() const;
+    };
+
+    // Places meshes in pages, a page is added when none of them has room for a mesh
+    // and pages other than the first are dropped once they are empty.
+    // Only the layout, the arena keeps the buffers of each page next to it.
+    // Doesn't touch GL.
+    class PageAllocator
+    {
+    public:
+        PageAllocator() = default;
+
+        Allocation allocate(size_t numVertices, size_t numIndices);
+        // returns true when the page of the allocation was dropped,
+        // allocations of pages that don't exist are ignored
+        bool free(const Allocation& allocation);
+        void clear();
+
+        // dropped pages leave a hole, so the page indices of allocations stay valid
+        size_t numPageSlots() const;
+        bool hasPage(size_t page) const;
+        size_t vertexCapacity(size_t page) const;
+        size_t indexCapacity(size_t page) const;
+
+        size_t numPages() const;
+        // summed over the pages
+        RangeAllocator::Stats vertexStats() const;
+        RangeAllocator::Stats indexStats() const;
+
+    private:
+        struct Page
+        {
+            RangeAllocator vertices;
+            RangeAllocator indices;
+        };
+
+        std::vector<std::unique_ptr<Page>> m_pages;
+
+        // pages bigger than the default are created for meshes that don't fit in one
+        size_t createPage(size_t numVertices, size_t numIndices);
+
+        static void addPageStats(RangeAllocator::Stats& total, const RangeAllocator::Stats& page);
+    };
+
+    // meshes drawn in one frame, in the order they should be drawn within a page
+    using DrawList = std::vector<Allocation>;
+
+    struct DrawStats
+    {
+        size_t numDrawCalls;
+        size_t numMeshes;
+    };
+
+    struct Stats
+    {
+        size_t numPages;
+        RangeAllocator::Stats vertices;
+        RangeAllocator::Stats indices;
+        uint64_t numUploads;
+        // uploads that reused the range of the previous mesh
+        uint64_t numInPlaceUploads;
+    };
+
+    static constexpr size_t verticesPerPage = 2 * 1024 * 1024;
+    static constexpr size_t indicesPerPage = 3 * 1024 * 1024;
+    // a quad is 4 vertices and 6 indices
+    static constexpr size_t vertexGranularity = 4 * 64;
+    static constexpr size_t indexGranularity = 6 * 64;
+
+    static MapChunkMeshArena& instance();
+
+    MapChunkMeshArena(const MapChunkMeshArena&) = delete;
+    MapChunkMeshArena& operator=(const MapChunkMeshArena&) = delete;
+
+    // the previous allocation of the mesh is reused when the new one fits in it, otherwise it's freed
+    Allocation upload(const std::vector<BlockVertex>& vertices, const std::vector<uint32_t>& indices, const ls::Vec3I& chunkOrigin, const Allocation& previous);
+    void free(Allocation& allocation);
+
+    // expects the terrain shader to be bound, chunk origins are bound to the given texture unit
+    DrawStats draw(const DrawList& meshes, GLenum chunkOriginsTextureUnit);
+
+    // deletes all pages with their GL objects, has to be called before the GL context is destroyed,
+    // allocations that are freed afterwards are ignored
+    void shutdown();
+
+    // reads an uploaded mesh back from the buffers of its page, with the chunk origin of every vertexGranularity vertices
+    void readBack(const Allocation& allocation, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, std::vector<ls::Vec3I>& chunkOrigins) const;
+
+    // glMultiDrawElementsIndirect needs GL 4.3, older contexts use glMultiDrawElementsBaseVertex
+    bool usesMultiDrawIndirect() const;
+
+    Stats stats() const;
+
+private:
+    struct PageBuffers
+    {
+        ls::gl::VertexArrayObject vao;
+        ls::gl::VertexBufferObject* vbo;
+        ls::gl::IndexBufferObject* ibo;
+        // xyz of the chunk origin for every vertexGranularity vertices
+        ls::gl::TextureBuffer chunkOrigins;
+
+        PageBuffers(size_t vertexCapacity, size_t indexCapacity);
+    };
+
+    // layout required by glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // commands of a page are contiguous
+    struct PageDraw
+    {
+        size_t page;
+        size_t firstCommand;
+        size_t numCommands;
+    };
+
+    PageAllocator m_pageAllocator;
+    // at the same indices as the pages of the allocator
+    std::vector<std::unique_ptr<PageBuffers>> m_pageBuffers;
+    uint64_t m_numUploads;
+    uint64_t m_numInPlaceUploads;
+    // created with the first page when multi draw indirect is supported, a GL context is needed to tell
+    std::unique_ptr<ls::gl::DrawIndirectBufferObject> m_drawCommandBuffer;
+
+    // reused between frames
+    std::vector<DrawElementsIndirectCommand> m_drawCommands;
+    std::vector<PageDraw> m_pageDraws;
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const void*> m_drawFirstIndices;
+    std::vector<GLint> m_drawBaseVertices;
+    std::vector<int32_t> m_chunkOriginsScratch;
+
+    MapChunkMeshArena();
+
+    bool fitsInPlace(const Allocation& allocation, size_t numVertices, size_t numIndices) const;
+    // buffers of a page are created along with it
+    void ensurePageBuffers(size_t page);
+    void writeChunkOrigins(const Allocation& allocation, const ls::Vec3I& chunkOrigin);
+    void drawPage(const PageDraw& pageDraw);
+};
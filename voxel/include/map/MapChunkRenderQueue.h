@@ -1,22 +1,60 @@
 #pragma once
 
+#include "MapChunkMeshArena.h"
+
+#include "../LibS/Shapes/Vec3.h"
+
 #include <vector>
+#include <cstddef>
+#include <cstdint>
 
 class MapChunk;
 
+// Chunks to draw and to cull in one frame. Kept between frames,
+// so in a steady state nothing is allocated.
+// Visible chunks are drawn nearest first by the distance of their centers to the camera,
+// so the depth test rejects most of the hidden fragments. Chunks at the same distance
+// keep the order they were enqueued in. A translucent pass would walk the same order backwards.
+// All chunks share the terrain shader and texture, the only state that changes
+// between the draws is the page of the mesh arena, which groups them by it.
 class MapChunkRenderQueue
 {
 public:
-    MapChunkRenderQueue(int maxDistance);
+    struct DrawStats
+    {
+        size_t numDrawnVertices;
+        size_t numDrawnChunks;
+        size_t numDrawCalls;
+        // building and issuing the draw calls, without the mesh updates
+        uint64_t submitTimeUs;
+    };
+
+    MapChunkRenderQueue();
 
-    void enqueueDraw(MapChunk& chunk, int distance);
+    // forgets the chunks of the previous frame
+    void beginFrame(const ls::Vec3F& cameraPosition);
+
+    void enqueueDraw(MapChunk& chunk);
 
     void enqueueCull(MapChunk& chunk);
 
-    void draw(float dt);
+    // chunk origins are bound to the given texture unit
+    DrawStats draw(float dt, GLenum chunkOriginsTextureUnit);
 
 private:
-    int m_maxDistance;
-    std::vector<std::vector<MapChunk*>> m_drawQueue;
+    struct DrawEntry
+    {
+        float distanceSquared;
+        // breaks ties, so the sort gives the same order as a stable one
+        uint32_t order;
+        MapChunk* chunk;
+    };
+
+    ls::Vec3F m_cameraPosition;
+    std::vector<DrawEntry> m_drawQueue;
     std::vector<MapChunk*> m_cullQueue;
+    MapChunkMeshArena::DrawList m_drawList;
+
+    static constexpr int m_maxMeshJobsScheduledPerFrame = 16;
+    static constexpr size_t m_maxMeshBytesUploadedPerFrame = 4 * 1024 * 1024;
 };
@@ -1,33 +1,105 @@
 #pragma once
 
-#include "../LibS/OpenGL/VertexArrayObject.h"
-
 #include "block/BlockVertex.h"
+#include "block/BlockSideOpacity.h"
+#include "block/BlockTypeRegistry.h"
+
+#include "CubeSide.h"
+
+#include "MapChunkMeshArena.h"
+
+#include "ThreadPool.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
 
 class MapChunk;
+class MapChunkSnapshot;
+class BlockContainer;
+
+// limits the work done for chunk meshes on the render thread in one frame
+struct MapChunkMeshUpdateBudget
+{
+    int numMeshJobsLeft;
+    size_t numBytesToUploadLeft;
+};
 
+// Meshes are built by jobs on the thread pool from a snapshot of the chunk.
+// The render thread only uploads finished meshes, the previous one is drawn until then.
 class MapChunkRenderer
 {
 public:
+    enum class MeshingMode
+    {
+        PerFace,
+        Greedy // merges equal faces of blocks that allow it
+    };
+
+    struct Mesh
+    {
+        std::vector<BlockVertex> vertices;
+        std::vector<uint32_t> indices;
+
+        size_t sizeInBytes() const;
+    };
+
     MapChunkRenderer();
+    MapChunkRenderer(const MapChunkRenderer&) = delete;
+    MapChunkRenderer(MapChunkRenderer&& other) noexcept;
+    MapChunkRenderer& operator=(const MapChunkRenderer&) = delete;
+    MapChunkRenderer& operator=(MapChunkRenderer&& other) noexcept;
+    ~MapChunkRenderer();
+
+    // all chunks are remeshed after a change
+    static void setMeshingMode(MeshingMode mode);
+    static MeshingMode meshingMode();
 
-    void draw(MapChunk& chunk, float dt, int& numUpdatedChunksOnDraw);
+    // vertices are local to the chunk, the arena provides the origin
+    void draw(MapChunk& chunk, float dt, MapChunkMeshUpdateBudget& budget, MapChunkMeshArena::DrawList& drawList);
     void tooFarToDraw(MapChunk& chunk, float dt);
-    void culled(MapChunk& chunk, float dt, int& numUpdatedChunksOnCull);
+    void culled(MapChunk& chunk, float dt, MapChunkMeshUpdateBudget& budget);
+    // can't be seen from the camera chunk, so it's neither meshed nor drawn
+    void unreached(MapChunk& chunk, float dt);
 
+    // invalidates the mesh that is being built
     void scheduleUpdate();
 
+    size_t numVertices() const;
+    // finished mesh that was not uploaded yet
+    size_t cpuMeshMemoryUsage() const;
+    size_t gpuMeshMemoryUsage() const;
+
+    // doesn't touch GL, can be called from any thread
+    static void buildMesh(const MapChunkSnapshot& chunk, MeshingMode mode, Mesh& mesh);
+
 private:
-    ls::gl::VertexArrayObject m_vao;
-    ls::gl::VertexBufferObject* m_vbo;
-    ls::gl::IndexBufferObject* m_ibo;
+    // invalid until the first non empty mesh is uploaded, so chunks can exist without a GL context
+    MapChunkMeshArena::Allocation m_meshAllocation;
     float m_timeOutsideDrawingRange;
-    size_t m_iboSize;
     bool m_needsUpdate; 
+    int m_meshingModeVersion;
+    ThreadPool::JobHandle m_meshJob;
+    std::shared_ptr<Mesh> m_pendingMesh; // written by the mesh job
     
     static constexpr float m_maxTimeOutsideDrawingRange = 30.0f;
-    static constexpr int m_maxChunksUpdatedOnDrawPerFrame = 2;
-    static constexpr int m_maxChunksUpdatedOnCullPerFrame = 1;
+    static constexpr int m_meshJobPriority = -1; // before any chunk generation
+
+    // only accessed from the render thread, jobs get the mode when scheduled
+    static MeshingMode m_meshingMode;
+    static int m_currentMeshingModeVersion;
+
+    void update(MapChunk& chunk, MapChunkMeshUpdateBudget& budget);
+    void scheduleMeshJob(MapChunk& chunk);
+    bool tryUploadPendingMesh(const MapChunk& chunk, MapChunkMeshUpdateBudget& budget);
+    void cancelMeshJob();
 
-    void update(MapChunk& chunk);
+    static void appendChunk(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices);
+    // walks only the border of the chunk when its interior is invisible
+    static void appendUniformChunk(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices);
+    static void appendChunkGreedy(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices);
+    // only blocks drawn by themselves are dereferenced
+    static void appendBlock(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, const BlockContainer& block, const ls::Vec3I& position, BlockSideOpacity outsideOpacity);
+    // a quad covering extent blocks of a cube type, extent along the side's normal has to be 1
+    static void appendQuad(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, BlockTypeId typeId, CubeSide side, const ls::Vec3I& position, const ls::Vec3I& extent);
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include "block/BlockSideOpacity.h"
+
+#include "MapChunk.h"
+#include "MapChunkBlockStorage.h"
+
+#include <array>
+
+// Immutable copy of everything that is needed to build a mesh of a chunk.
+// Borders of the neighbours are included through the outside opacity.
+// Can be used from any thread while the chunk itself keeps changing.
+class MapChunkSnapshot
+{
+    using BlockOpacityMaskArray = detail::BlockOpacityMaskArray;
+
+public:
+    explicit MapChunkSnapshot(const MapChunk& chunk);
+
+    MapChunkSnapshot(const MapChunkSnapshot&) = delete;
+    MapChunkSnapshot& operator=(const MapChunkSnapshot&) = delete;
+
+    ~MapChunkSnapshot();
+
+    const ls::Vec3I& firstBlockPosition() const;
+    const MapChunkBlockStorage& blocks() const;
+    bool isUniform() const;
+
+    BlockSideOpacity outsideOpacity(const ls::Vec3I& localPos) const;
+    MapChunk::OutsideOpacityRow outsideOpacityRow(int x, int y) const;
+
+private:
+    ls::Vec3I m_firstBlockPosition;
+    MapChunkBlockStorage m_blocks;
+    BlockOpacityMaskArray m_blockOpacityMasks;
+    std::array<MapChunk::BorderOpacityPlane, 6> m_borderOpacity;
+};
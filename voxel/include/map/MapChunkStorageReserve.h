@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../LibS/Array3.h"
+
+#include "MapChunkBlockStorage.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace detail
+{
+    constexpr size_t m_chunkWidth = 32;
+    constexpr size_t m_chunkHeight = 32;
+    constexpr size_t m_chunkDepth = 32;
+
+    static_assert(MapChunkBlockStorage::width == m_chunkWidth && MapChunkBlockStorage::height == m_chunkHeight && MapChunkBlockStorage::depth == m_chunkDepth);
+
+    // one bit per block along z for each side and (x, y) column,
+    // set when that side of the block is opaque
+    using BlockOpacityMaskArray = ls::Array3<uint32_t, 6, m_chunkWidth, m_chunkHeight>;
+    static_assert(m_chunkWidth == 32 && m_chunkHeight == 32 && m_chunkDepth == 32, "a line of blocks has to fit in a mask");
+}
+
+// Buffers released by chunks and snapshots, kept for reuse by the next ones.
+// Holds at most maxRetained() buffers, more are freed right away.
+// Buffers that stay unused between two trims are given back to the system.
+// Loading and storing are lock-free and can be done from any thread.
+class MapChunkStorageReserve
+{
+public:
+    struct Stats
+    {
+        uint64_t numHits;
+        uint64_t numMisses;
+        uint64_t numStored;
+        // stored when the reserve was full
+        uint64_t numDropped;
+        uint64_t numTrimmed;
+        size_t numRetained;
+        size_t maxRetained;
+        size_t bytesRetained;
+    };
+
+    static MapChunkStorageReserve& instance();
+
+    MapChunkStorageReserve(const MapChunkStorageReserve&) = delete;
+    MapChunkStorageReserve& operator=(const MapChunkStorageReserve&) = delete;
+
+    ~MapChunkStorageReserve();
+
+    // contents of reused masks are left over from the previous owner, all users overwrite them
+    detail::BlockOpacityMaskArray loadOpacityMasks();
+    void storeOpacityMasks(detail::BlockOpacityMaskArray&& arr);
+
+    void setMaxRetained(size_t maxRetained);
+    size_t maxRetained() const;
+
+    // frees the buffers that were not needed since the last trim
+    void trim();
+
+    Stats stats() const;
+
+private:
+    using OpacityMaskBuffer = detail::BlockOpacityMaskArray::ValueType;
+
+    static constexpr size_t m_numSlots = 1024;
+    static constexpr size_t m_defaultMaxRetained = 256;
+    static constexpr size_t m_opacityMaskBytes = sizeof(OpacityMaskBuffer) * detail::BlockOpacityMaskArray::width() * detail::BlockOpacityMaskArray::height() * detail::BlockOpacityMaskArray::depth();
+
+    // a slot is either empty or owns a buffer
+    std::array<std::atomic<OpacityMaskBuffer*>, m_numSlots> m_slots;
+    // counts buffers from the moment a slot is reserved for them, so it never exceeds m_maxRetained
+    std::atomic<size_t> m_numRetained;
+    std::atomic<size_t> m_maxRetained;
+    std::atomic<size_t> m_minRetainedSinceTrim;
+    // where the last buffer was placed, the search for the next one starts there
+    std::atomic<size_t> m_slotHint;
+
+    std::atomic<uint64_t> m_numHits;
+    std::atomic<uint64_t> m_numMisses;
+    std::atomic<uint64_t> m_numStored;
+    std::atomic<uint64_t> m_numDropped;
+    std::atomic<uint64_t> m_numTrimmed;
+
+    MapChunkStorageReserve();
+
+    // returns nullptr when no buffer was found
+    OpacityMaskBuffer* takeBuffer();
+    void placeBuffer(OpacityMaskBuffer* buffer);
+};
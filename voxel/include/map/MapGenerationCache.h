@@ -0,0 +1,136 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include "Vec3IHasher.h"
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// Intermediate generation results shared by the generation jobs of neighbouring chunks.
+// Values are keyed by seed and position, a value is computed once,
+// jobs asking for it meanwhile wait for the result.
+// Holds at most capacity values, the least recently used ones are evicted first.
+template <class T>
+class MapGenerationCache
+{
+public:
+    struct Stats
+    {
+        uint64_t numHits;
+        uint64_t numMisses;
+        size_t numEntries;
+    };
+
+    explicit MapGenerationCache(size_t capacity) :
+        m_capacity(capacity > 0 ? capacity : 1),
+        m_numHits(0),
+        m_numMisses(0)
+    {
+    }
+
+    MapGenerationCache(const MapGenerationCache&) = delete;
+    MapGenerationCache& operator=(const MapGenerationCache&) = delete;
+
+    // can be called from any thread, evicted values stay alive while referenced
+    template <class Func>
+    std::shared_ptr<const T> getOrCompute(uint32_t seed, const ls::Vec3I& pos, Func&& compute)
+    {
+        const Key key{ seed, pos };
+
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            auto iter = m_entries.find(key);
+            if (iter != m_entries.end())
+            {
+                entry = iter->second;
+                m_recency.splice(m_recency.begin(), m_recency, entry->recencyPosition);
+                ++m_numHits;
+            }
+            else
+            {
+                entry = std::make_shared<Entry>();
+                m_recency.push_front(key);
+                entry->recencyPosition = m_recency.begin();
+                m_entries.emplace(key, entry);
+                ++m_numMisses;
+
+                while (m_entries.size() > m_capacity)
+                {
+                    m_entries.erase(m_recency.back());
+                    m_recency.pop_back();
+                }
+            }
+        }
+
+        // outside of the lock, so different values are computed in parallel
+        std::call_once(entry->computed, [&compute, &entry]() { compute(entry->value); });
+
+        return std::shared_ptr<const T>(entry, &entry->value);
+    }
+
+    template <class Pred>
+    void evictIf(Pred&& shouldEvict)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (auto iter = m_recency.begin(); iter != m_recency.end();)
+        {
+            if (shouldEvict(iter->pos))
+            {
+                m_entries.erase(*iter);
+                iter = m_recency.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    Stats stats() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        return Stats{ m_numHits, m_numMisses, m_entries.size() };
+    }
+
+private:
+    struct Key
+    {
+        uint32_t seed;
+        ls::Vec3I pos;
+
+        bool operator==(const Key& other) const
+        {
+            return seed == other.seed && pos == other.pos;
+        }
+    };
+
+    struct KeyHasher
+    {
+        size_t operator()(const Key& key) const
+        {
+            return Vec3IHasher()(key.pos) ^ key.seed;
+        }
+    };
+
+    struct Entry
+    {
+        std::once_flag computed;
+        T value;
+        typename std::list<Key>::iterator recencyPosition;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, std::shared_ptr<Entry>, KeyHasher> m_entries;
+    std::list<Key> m_recency; // most recently used first
+    size_t m_capacity;
+    uint64_t m_numHits;
+    uint64_t m_numMisses;
+};
@@ -9,19 +9,65 @@
 #include "../LibS/Array3.h"
 
 #include "MapChunk.h"
+#include "MapGenerationCache.h"
+
+#include <array>
+#include <vector>
+#include <atomic>
 
 class Map;
 class MapChunkBlockData;
 
+// Surface of a column of chunks, the same for every chunk stacked in it.
+struct MapColumnHeightmap
+{
+    std::array<float, MapChunk::width() * MapChunk::depth()> surface; // indexed by x * depth + z
+    float minSurface;
+    float maxSurface;
+};
+
+// Paths of the worms starting in a chunk, carved into it and its neighbours.
+struct MapCaveSegments
+{
+    struct Segment
+    {
+        // center relative to the first block of the source chunk
+        int16_t x;
+        int16_t y;
+        int16_t z;
+        uint8_t carvingTemplateId;
+    };
+
+    std::vector<Segment> segments;
+    // bounds of the carved blocks, relative to the first block of the source chunk
+    ls::Vec3I min;
+    ls::Vec3I max;
+};
+
 class MapGenerator
 {
 public:
+    struct Stats
+    {
+        uint64_t numGeneratedChunks;
+        uint64_t generationTimeUs; // summed over all jobs
+        MapGenerationCache<MapColumnHeightmap>::Stats heightmaps;
+        MapGenerationCache<MapCaveSegments>::Stats caveSegments;
+    };
+
     MapGenerator(Map& map);
 
+    // can be called from multiple threads at once
     void generateChunk(MapChunkBlockData& chunk) const;
 
+    // cached data of chunks that left the loading range won't be needed again soon
+    void evictFarCaches(const ls::Vec3I& currentChunk, int minDistance);
+
+    Stats stats() const;
+
 private:
     using CaveMapType = ls::Array3<bool, MapChunk::width(), MapChunk::height(), MapChunk::depth()>;
+    using CarvingTemplate = ls::Array3<bool>;
 
     struct Hasher
     {
@@ -78,6 +124,28 @@ private:
     };
 
     Map* m_map;
-
+    // shared by all generation jobs, the vertically stacked chunks reuse the surface
+    mutable MapGenerationCache<MapColumnHeightmap> m_heightmaps;
+    // each worm is simulated once and then only carved into the chunks it passes
+    mutable MapGenerationCache<MapCaveSegments> m_caveSegments;
+    mutable std::atomic<uint64_t> m_numGeneratedChunks;
+    mutable std::atomic<uint64_t> m_generationTimeUs;
+
+    static constexpr size_t m_maxCachedColumns = 1024;
+    static constexpr size_t m_maxCachedCaveSegments = 8192;
+
+    static constexpr int m_caveSimulationRadiusInChunks = 1; // worms are carved at most this many chunks away from the source
+    static constexpr float m_wormStepSize = 2.0f;
+    static constexpr float m_wormSize = (MapChunk::width() + MapChunk::height() + MapChunk::width()) * (0.5f * 1.5f); // average times 1.5
+    static constexpr int m_numWormSteps = static_cast<int>((m_wormSize + m_wormStepSize - 1.0f) / m_wormStepSize);
+    static constexpr int m_maxWormsPerChunk = 3;
+    static constexpr int m_minWormsPerChunk = 0;
+    static constexpr std::array<float, 3> m_wormRadii{ 1.8f, 2.5f, 3.5f };
+    static constexpr int m_maxWormStartHeight = 100;
+
+    void generateChunkBlocks(MapChunkBlockData& chunk) const;
+    static void computeHeightmap(uint32_t seed, int chunkX, int chunkZ, MapColumnHeightmap& heightmap);
+    static void computeCaveSegments(uint32_t seed, const ls::Vec3I& chunkPos, MapCaveSegments& caveSegments);
+    static const std::vector<CarvingTemplate>& carvingTemplates();
     CaveMapType generateCaveMap(const ls::Vec3I& chunkPos, uint32_t seed) const;
 };
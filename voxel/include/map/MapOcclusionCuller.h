@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+#include "../LibS/Shapes/Box3.h"
+#include "../LibS/Matrix.h"
+
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+class MapChunk;
+
+// Culls chunks hidden behind nearby terrain with a small depth buffer rasterized on the cpu.
+// Occluders are the solid boxes of chunks (see MapChunk::occluderBox), only the faces
+// that look towards the camera are drawn. A chunk is occluded when its bounding box
+// is farther than the depth of every texel it covers. The test reads a pyramid
+// of the farthest depths, so any chunk only needs a few texels.
+// Depth is stored as 1/w, which is affine in screen space, 0 means nothing was drawn.
+// Doesn't touch GL, only the view projection matrix of the camera is needed.
+class MapOcclusionCuller
+{
+public:
+    struct Stats
+    {
+        size_t numOccluders;
+        size_t numOccluderFaces;
+        size_t numTested;
+        size_t numOccluded;
+        uint64_t rasterizationTimeUs;
+        uint64_t testTimeUs;
+    };
+
+    static constexpr int width = 128;
+    static constexpr int height = 64;
+    // farther chunks cover little of the screen, they are only tested
+    static constexpr int maxOccluderDistance = 4;
+
+    MapOcclusionCuller();
+
+    // clears the depth, the matrix transforms world positions to clip space
+    void beginFrame(const ls::Vec3F& cameraPosition, const ls::Matrix4x4F& viewProjection);
+    void addOccluder(const MapChunk& chunk);
+    // builds the depth pyramid, has to be called after the last occluder
+    void finishOccluders();
+    bool isOccluded(const MapChunk& chunk);
+
+    // since the last beginFrame
+    Stats stats() const;
+
+    // of the texel at (x, y) in the full resolution level, for debugging and tests
+    float depthAt(int x, int y) const;
+
+private:
+    struct ClipVertex
+    {
+        float x;
+        float y;
+        float w;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    struct ScreenVertex
+    {
+        float x;
+        float y;
+        float invW;
+    };
+
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    // a quad clipped by the near plane has at most 5 vertices
+    static constexpr size_t m_maxPolygonVertices = 8;
+    // nearer vertices are clipped, also keeps 1/w finite
+    static constexpr float m_minW = 1.0f / 16.0f;
+    // the test goes up the pyramid until the box spans at most that many texels on each axis
+    static constexpr int m_maxTestedTexels = 4;
+
+    ls::Vec3F m_cameraPosition;
+    ls::Matrix4x4F m_viewProjection;
+    // level 0 is the full resolution, each next one has the minimum of 2x2 texels
+    std::vector<Level> m_levels;
+    // times are kept separately, single calls are too short for whole microseconds
+    Stats m_stats;
+    Clock::duration m_rasterizationTime;
+    Clock::duration m_testTime;
+
+    ClipVertex toClip(const ls::Vec3F& worldPos) const;
+    void rasterizeQuad(const std::array<ls::Vec3F, 4>& corners);
+    void rasterizePolygon(const ScreenVertex* vertices, size_t numVertices);
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include "MapChunkBlockStorage.h"
+
+#include "MemoryMappedFile.h"
+#include "ThreadPool.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+class BlockFactory;
+
+// Keeps chunks on disk grouped in region files of 16x8x16 chunks.
+// A region file starts with a table of offsets and sizes of its chunks.
+// A chunk is stored as a palette of block names followed by runs of palette indices.
+// Reads go through a memory mapping of the region, only the most recently used regions stay mapped.
+// Writes are done on the thread pool, a chunk that grew is moved to the first gap that fits it.
+// State of stateful blocks is not saved, they are instantiated anew on load.
+class MapRegionStorage
+{
+public:
+    explicit MapRegionStorage(const std::string& directory);
+    // waits for all pending writes
+    ~MapRegionStorage();
+
+    MapRegionStorage(const MapRegionStorage&) = delete;
+    MapRegionStorage& operator=(const MapRegionStorage&) = delete;
+
+    // the chunk is written later, loads return the saved blocks until then
+    void saveChunkAsync(const ls::Vec3I& pos, const MapChunkBlockStorage& blocks);
+    // can be called from any thread, returns false if the chunk was never saved
+    bool tryLoadChunk(const ls::Vec3I& pos, MapChunkBlockStorage& blocks);
+
+    // blocks until the writes issued so far are done
+    void flush();
+
+private:
+    struct ChunkTableEntry
+    {
+        uint32_t offset;
+        uint32_t size; // 0 if the chunk is not stored
+    };
+
+    struct RegionHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct MappedRegion
+    {
+        std::shared_ptr<const MemoryMappedFile> file;
+        uint64_t lastUse;
+    };
+
+    static constexpr int m_regionWidth = 16;
+    static constexpr int m_regionHeight = 8;
+    static constexpr int m_regionDepth = 16;
+    static constexpr size_t m_numChunksInRegion = m_regionWidth * m_regionHeight * m_regionDepth;
+    static constexpr size_t m_chunkTableOffset = sizeof(RegionHeader);
+    static constexpr size_t m_chunkPayloadsOffset = m_chunkTableOffset + m_numChunksInRegion * sizeof(ChunkTableEntry);
+    static constexpr uint32_t m_magic = 0x47525856; // "VXRG"
+    static constexpr uint32_t m_version = 1;
+    static constexpr int m_writeJobPriority = 0;
+    // a few times the regions around the player
+    static constexpr size_t m_maxMappedRegions = 16;
+
+    std::string m_directory;
+    // guards the pending writes and the mappings, never held during file io
+    std::mutex m_mutex;
+    // held by writes for the whole file io, taken before m_mutex
+    std::mutex m_fileMutex;
+    // saved chunks that are not written yet
+    std::map<ls::Vec3I, std::shared_ptr<const MapChunkBlockStorage>> m_pendingWrites;
+    std::vector<ThreadPool::JobHandle> m_writeJobs;
+    // invalidated by writes to the region, readers keep their own reference
+    std::map<ls::Vec3I, MappedRegion> m_mappedRegions;
+    uint64_t m_mappedRegionUseCounter;
+    // block factories are not safe to look up concurrently
+    std::mutex m_blockFactoryMutex;
+    std::map<std::string, const BlockFactory*> m_blockFactories;
+
+    void writePendingChunk(const ls::Vec3I& pos, const std::shared_ptr<const MapChunkBlockStorage>& blocks);
+    void writeChunk(const ls::Vec3I& pos, const std::vector<uint8_t>& payload);
+    // the least recently used mapping is dropped when there are too many
+    std::shared_ptr<const MemoryMappedFile> mappedRegion(const ls::Vec3I& regionPos);
+    std::string regionPath(const ls::Vec3I& regionPos) const;
+
+    // throws when the payload is malformed
+    void decode(const uint8_t* data, size_t size, MapChunkBlockStorage& blocks);
+    const BlockFactory* findBlockFactory(const std::string& name);
+
+    static ls::Vec3I regionPosOf(const ls::Vec3I& chunkPos);
+    static size_t chunkIndexInRegion(const ls::Vec3I& chunkPos);
+    // first offset after the chunk table where size bytes don't overlap other chunks than the one at skippedIndex
+    static uint32_t findFreeSpace(const std::vector<ChunkTableEntry>& table, size_t skippedIndex, size_t size);
+    static std::vector<uint8_t> encode(const MapChunkBlockStorage& blocks);
+
+    template <class T>
+    static void appendBytes(std::vector<uint8_t>& bytes, const T& value);
+    // advances the offset, throws when reading past the end
+    template <class T>
+    static T readBytes(const uint8_t* data, size_t size, size_t& offset);
+};
@@ -6,7 +6,12 @@
 #include "../LibS/Fwd.h"
 #include "../LibS/OpenGL/Shader.h"
 
+#include "MapChunkRenderQueue.h"
+#include "MapOcclusionCuller.h"
+#include "MapVisibilityFloodFill.h"
+
 #include <vector>
+#include <cstdint>
 
 class Map;
 class MapChunk;
@@ -17,20 +22,34 @@ public:
     MapRenderer();
 
     void draw(Map& map, const ls::gl::Camera& camera, float dt);
+
+    // in the last frame
+    size_t numDrawnVertices() const;
+    const MapChunkRenderQueue::DrawStats& lastDrawStats() const;
+    MapOcclusionCuller::Stats lastOcclusionStats() const;
+    const MapVisibilityFloodFill::Stats& lastVisibilityStats() const;
+
+    // expects normalized planes in frustum
+    static bool intersect(const ls::Frustum3F& frustum, const ls::Sphere3F& sphere);
 private:
     const ls::gl::Texture2* m_texture;
     const ls::gl::ShaderProgram* m_shader;
     ls::gl::ProgramUniformView m_uModelViewProjection;
+    MapChunkRenderQueue m_renderQueue;
+    MapChunkRenderQueue::DrawStats m_lastDrawStats;
+    MapVisibilityFloodFill m_visibilityFloodFill;
+    MapOcclusionCuller m_occlusionCuller;
+    // chunks that passed the frustum test, reused between frames
+    std::vector<MapChunk*> m_chunksInFrustum;
+    // output of the batched frustum test, reused between frames
+    std::vector<uint32_t> m_chunkIndicesInFrustum;
+
+    static constexpr GLenum m_chunkOriginsTextureUnit = GL_TEXTURE1;
 
     //static constexpr int m_maxDistanceToRenderedChunk = 20;
     static constexpr int m_maxDistanceToRenderedChunk = 12;
 
-    // expects normalized planes in frustum
-    static bool shouldDrawChunk(const ls::gl::Camera& camera, const ls::Frustum3F& frustum, const MapChunk& chunk);
     static bool shouldForgetChunk(const MapChunk& chunk, int dist);
     // expects normalized plane
     static float distance(const ls::Plane3F& plane, const ls::Vec3F& point);
-
-    // expects normalized planes in frustum
-    static bool intersect(const ls::Frustum3F& frustum, const ls::Sphere3F& sphere);
 };
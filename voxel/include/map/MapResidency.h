@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+
+#include "Vec3IHasher.h"
+
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+
+// bytes used by a chunk or a set of chunks
+struct MapChunkMemoryUsage
+{
+    size_t blocks;
+    size_t opacity;
+    // finished meshes waiting for the upload
+    size_t cpuMesh;
+    size_t gpuMesh;
+
+    size_t total() const;
+
+    bool operator==(const MapChunkMemoryUsage& other) const;
+    bool operator!=(const MapChunkMemoryUsage& other) const;
+    MapChunkMemoryUsage& operator+=(const MapChunkMemoryUsage& other);
+    MapChunkMemoryUsage& operator-=(const MapChunkMemoryUsage& other);
+};
+
+// Memory used by the loaded chunks and the order in which they were last visible.
+// Chunks that were not visible for the longest time are the first to be evicted
+// when the memory budget is exceeded.
+// Only used from the main thread.
+class MapResidency
+{
+public:
+    struct Stats
+    {
+        MapChunkMemoryUsage resident;
+        size_t numChunks;
+        size_t budget;
+        uint64_t numEvictedChunks;
+    };
+
+    explicit MapResidency(size_t budget);
+
+    void setBudget(size_t budget);
+    size_t budget() const;
+    bool isOverBudget() const;
+
+    // new chunks count as the most recently visible
+    void add(const ls::Vec3I& pos, const MapChunkMemoryUsage& usage);
+    void remove(const ls::Vec3I& pos, const MapChunkMemoryUsage& usage);
+    // changes of chunks that were not added yet are ignored, they are counted when added
+    void update(const ls::Vec3I& pos, const MapChunkMemoryUsage& previousUsage, const MapChunkMemoryUsage& usage);
+    void markVisible(const ls::Vec3I& pos);
+
+    // returns false when there are no chunks
+    bool leastRecentlyVisible(ls::Vec3I& pos) const;
+    void onEvicted();
+
+    Stats stats() const;
+
+private:
+    std::list<ls::Vec3I> m_recency; // most recently visible first
+    std::unordered_map<ls::Vec3I, std::list<ls::Vec3I>::iterator, Vec3IHasher> m_entries;
+    MapChunkMemoryUsage m_resident;
+    size_t m_budget;
+    uint64_t m_numEvictedChunks;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../LibS/Shapes/Vec3.h"
+#include "../LibS/Shapes/Frustum3.h"
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+class MapChunk;
+
+// Finds the chunks that can be seen from the camera chunk by walking outwards through
+// the faces each chunk connects (see MapChunk::faceConnectivity).
+// A walk never steps opposite to a direction it already took, as no line of sight can,
+// so a chunk is only reached when there is an open path that moves away from the camera.
+// Only the chunks added for the frame are walked, the caller decides which ones can be seen at all.
+// Positions in the frustum without a chunk, because it's not loaded or still being generated,
+// are walked as if all of their faces were connected, so that chunks behind them don't pop in
+// once they load. They are never reached themselves. Positions outside of the frustum stop the walk.
+// maxDistance must not exceed the loading range of the map.
+// Doesn't touch GL.
+class MapVisibilityFloodFill
+{
+public:
+    struct Stats
+    {
+        size_t numCandidates;
+        size_t numReached;
+        size_t numVisits;
+        uint64_t timeUs;
+    };
+
+    explicit MapVisibilityFloodFill(int maxDistance);
+
+    void beginFrame(const ls::Vec3I& cameraChunk);
+    // chunks farther than maxDistance from the camera chunk are ignored
+    void addChunk(const MapChunk& chunk);
+    // every candidate is reached when the camera chunk was not added, for example when it's above the world
+    // the frustum has to have normalized planes
+    void run(const ls::Frustum3F& frustum);
+    bool isReached(const MapChunk& chunk) const;
+
+    // since the last beginFrame
+    const Stats& stats() const;
+
+private:
+    static constexpr uint8_t m_notEntered = 0xFF;
+    static constexpr int m_noSide = 6;
+
+    struct Cell
+    {
+        const MapChunk* chunk;
+        // for each face the chunk was entered through, the directions walked to get there
+        std::array<uint8_t, 6> walkedDirections;
+        bool isReached;
+    };
+
+    struct Visit
+    {
+        ls::Vec3I cell;
+        int entrySide;
+        uint8_t walkedDirections;
+    };
+
+    int m_maxDistance;
+    int m_gridSize;
+    ls::Vec3I m_cameraChunk;
+    bool m_reachesAll;
+    // cube of chunks around the camera chunk
+    std::vector<Cell> m_cells;
+    // reused between frames
+    std::vector<Visit> m_visits;
+    Stats m_stats;
+
+    // returns -1 when outside of the grid
+    int cellIndex(const ls::Vec3I& cell) const;
+    // for cells without a chunk
+    bool isWalkableWithoutChunk(const ls::Vec3I& cell, const ls::Frustum3F& frustum) const;
+};
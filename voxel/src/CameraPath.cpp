@@ -0,0 +1,74 @@
+#include "CameraPath.h"
+
+#include "../LibS/OpenGL/Camera.h"
+#include "../LibS/Shapes/Angle2.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+CameraPath::Pose CameraPath::Pose::fromCamera(const ls::gl::Camera& camera)
+{
+    return Pose{ camera.position(), camera.horizontalAngle().degrees(), camera.verticalAngle().degrees() };
+}
+void CameraPath::Pose::applyTo(ls::gl::Camera& camera) const
+{
+    camera.setPosition(position);
+    camera.setAngles(ls::Angle2F::degrees(yawDegrees), ls::Angle2F::degrees(pitchDegrees));
+}
+
+CameraPath CameraPath::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Could not open camera path " + path);
+
+    CameraPath cameraPath;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        if (line.empty()) continue;
+
+        std::istringstream lineStream(line);
+        Pose pose;
+        if (!(lineStream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yawDegrees >> pose.pitchDegrees))
+        {
+            throw std::runtime_error("Malformed camera pose in " + path + " at line " + std::to_string(lineNumber));
+        }
+
+        cameraPath.add(pose);
+    }
+
+    return cameraPath;
+}
+bool CameraPath::save(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+
+    // enough to restore the floats exactly
+    file.precision(9);
+    for (const auto& pose : m_poses)
+    {
+        file << pose.position.x << ' ' << pose.position.y << ' ' << pose.position.z << ' ' << pose.yawDegrees << ' ' << pose.pitchDegrees << '\n';
+    }
+
+    return static_cast<bool>(file);
+}
+
+void CameraPath::add(const Pose& pose)
+{
+    m_poses.emplace_back(pose);
+}
+void CameraPath::clear()
+{
+    m_poses.clear();
+}
+
+const std::vector<CameraPath::Pose>& CameraPath::poses() const
+{
+    return m_poses;
+}
+bool CameraPath::isEmpty() const
+{
+    return m_poses.empty();
+}
@@ -5,13 +5,17 @@
 #include <SFML/Window.hpp>
 
 #include "GameResourceLoader.h"
+#include "Logger.h"
+#include "Profiler.h"
 
 Game::Game() :
-    m_renderer{}
+    m_renderer{},
+    m_isRecordingCameraPath(false)
 {
     GameResourceLoader::loadAssets();
 
     m_map = std::make_unique<Map>(321412u);
+    m_mapRenderer = std::make_unique<MapRenderer>();
 }
 
 
@@ -22,8 +26,11 @@ void Game::run()
     float lastTick = 0.0f;
     float lastDraw = 0.0f;
     bool running = true;
+    PROFILE_THREAD_NAME("Main");
     while (running)
     {
+        PROFILE_ZONE("Game::frame");
+
         sf::Event event;
 
         const sf::Time elapsedTime = clock.getElapsedTime();
@@ -37,6 +44,20 @@ void Game::run()
             {
                 running = false;
             }
+            else if (event.type == sf::Event::EventType::KeyPressed && event.key.code == sf::Keyboard::G)
+            {
+                // for comparing the meshers
+                const bool isGreedy = MapChunkRenderer::meshingMode() == MapChunkRenderer::MeshingMode::Greedy;
+                MapChunkRenderer::setMeshingMode(isGreedy ? MapChunkRenderer::MeshingMode::PerFace : MapChunkRenderer::MeshingMode::Greedy);
+            }
+            else if (event.type == sf::Event::EventType::KeyPressed && event.key.code == sf::Keyboard::F12)
+            {
+                writeProfilerTrace();
+            }
+            else if (event.type == sf::Event::EventType::KeyPressed && event.key.code == sf::Keyboard::F11)
+            {
+                toggleCameraPathRecording();
+            }
         }
 
         if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
@@ -50,7 +71,11 @@ void Game::run()
 
         if (dtTick >= m_tickTime)
         {
-            m_map->update(*this, m_tickTime);
+            m_map->update(camera().position(), m_tickTime);
+            if (m_isRecordingCameraPath)
+            {
+                m_cameraPath.add(CameraPath::Pose::fromCamera(camera()));
+            }
             lastTick = currentTime;
         }
 
@@ -70,10 +95,59 @@ const Map& Game::map() const
     return *m_map;
 }
 
+MapRenderer& Game::mapRenderer()
+{
+    return *m_mapRenderer;
+}
+const MapRenderer& Game::mapRenderer() const
+{
+    return *m_mapRenderer;
+}
+
 const ls::gl::Camera& Game::camera() const
 {
     return m_renderer.camera();
 }
+void Game::writeProfilerTrace()
+{
+    if (!Profiler::isEnabled())
+    {
+        Logger::instance().log(Logger::Priority::Warn, "Profiling is disabled, define VOXEL_PROFILING to enable it");
+        return;
+    }
+
+    static constexpr const char* path = "trace.json";
+    if (Profiler::instance().writeChromeTrace(path))
+    {
+        Logger::instance().log(Logger::Priority::Info, std::string("Profiler trace written to ") + path);
+    }
+    else
+    {
+        Logger::instance().log(Logger::Priority::Error, std::string("Could not write profiler trace to ") + path);
+    }
+}
+void Game::toggleCameraPathRecording()
+{
+    if (!m_isRecordingCameraPath)
+    {
+        m_cameraPath.clear();
+        m_isRecordingCameraPath = true;
+        Logger::instance().log(Logger::Priority::Info, "Recording camera path");
+        return;
+    }
+
+    m_isRecordingCameraPath = false;
+
+    static constexpr const char* path = "camera_path.txt";
+    if (m_cameraPath.save(path))
+    {
+        Logger::instance().log(Logger::Priority::Info, std::string("Camera path with ") + std::to_string(m_cameraPath.poses().size()) + " poses written to " + path);
+    }
+    else
+    {
+        Logger::instance().log(Logger::Priority::Error, std::string("Could not write camera path to ") + path);
+    }
+}
 void Game::handleInput(float dt)
 {
     m_renderer.handleInput(dt);
@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 
 #include "Logger.h"
+#include "Profiler.h"
 
 #include "Game.h"
 
@@ -24,14 +25,21 @@ GameRenderer::GameRenderer() :
 
     sf::Mouse::setPosition(sf::Vector2i(m_window.getSize().x / 2, m_window.getSize().y / 2), m_window);
 }
+GameRenderer::~GameRenderer()
+{
+    // the map and its renderer are destroyed first, the window still has the context here
+    MapChunkMeshArena::instance().shutdown();
+}
 
 void GameRenderer::draw(Game& game, float dt)
 {
-    updateFpsMeasures(dt);
+    PROFILE_ZONE("GameRenderer::draw");
+
+    updateFpsMeasures(game, dt);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    game.map().draw(m_camera, dt);
+    game.mapRenderer().draw(game.map(), m_camera, dt);
 
     m_window.display();
 }
@@ -54,7 +62,7 @@ void GameRenderer::onWindowResized(const sf::Event& e)
     m_camera.setAspect(static_cast<float>(e.size.width) / static_cast<float>(e.size.height));
 }
 
-void GameRenderer::updateFpsMeasures(float dt)
+void GameRenderer::updateFpsMeasures(const Game& game, float dt)
 {
     m_timeSinceLastFpsMeasure += dt;
     ++m_currentFpsCounter;
@@ -66,6 +74,57 @@ void GameRenderer::updateFpsMeasures(float dt)
         m_timeSinceLastFpsMeasure = 0.0f;
 
         Logger::instance().log(Logger::Priority::Info, std::string("Avg frame time (ms): ") + std::to_string(1000.0 / m_lastMeasuredFps) + " (" + std::to_string(m_lastMeasuredFps) + " fps)");
+
+        const bool isGreedy = MapChunkRenderer::meshingMode() == MapChunkRenderer::MeshingMode::Greedy;
+        const MapGenerator::Stats generatorStats = game.map().generator().stats();
+        const uint64_t numHeightmapRequests = generatorStats.heightmaps.numHits + generatorStats.heightmaps.numMisses;
+        const uint64_t numCaveSegmentRequests = generatorStats.caveSegments.numHits + generatorStats.caveSegments.numMisses;
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Generated chunks: ") + std::to_string(generatorStats.numGeneratedChunks)
+            + " (avg " + std::to_string(generatorStats.numGeneratedChunks > 0 ? generatorStats.generationTimeUs / 1000.0 / generatorStats.numGeneratedChunks : 0.0) + " ms)"
+            + ", heightmap cache hit rate: " + std::to_string(numHeightmapRequests > 0 ? 100.0 * generatorStats.heightmaps.numHits / numHeightmapRequests : 0.0) + "%"
+            + ", cave cache hit rate: " + std::to_string(numCaveSegmentRequests > 0 ? 100.0 * generatorStats.caveSegments.numHits / numCaveSegmentRequests : 0.0) + "%");
+        const MapResidency::Stats residencyStats = game.map().residency().stats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Resident chunks: ") + std::to_string(residencyStats.numChunks)
+            + " (" + std::to_string(residencyStats.resident.total() >> 20) + "/" + std::to_string(residencyStats.budget >> 20) + " MiB"
+            + ", blocks " + std::to_string(residencyStats.resident.blocks >> 20)
+            + ", opacity " + std::to_string(residencyStats.resident.opacity >> 20)
+            + ", cpu mesh " + std::to_string(residencyStats.resident.cpuMesh >> 20)
+            + ", gpu mesh " + std::to_string(residencyStats.resident.gpuMesh >> 20)
+            + " MiB), evicted: " + std::to_string(residencyStats.numEvictedChunks));
+        const MapChunkStorageReserve::Stats reserveStats = MapChunkStorageReserve::instance().stats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Reserved chunk buffers: ") + std::to_string(reserveStats.numRetained) + "/" + std::to_string(reserveStats.maxRetained)
+            + " (" + std::to_string(reserveStats.bytesRetained >> 10) + " KiB)"
+            + ", hits: " + std::to_string(reserveStats.numHits)
+            + ", misses: " + std::to_string(reserveStats.numMisses)
+            + ", dropped: " + std::to_string(reserveStats.numDropped)
+            + ", trimmed: " + std::to_string(reserveStats.numTrimmed));
+        const MapChunkMeshArena::Stats arenaStats = MapChunkMeshArena::instance().stats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Mesh arena pages: ") + std::to_string(arenaStats.numPages)
+            + ", vertices " + std::to_string((arenaStats.vertices.numUsed * sizeof(BlockVertex)) >> 20) + "/" + std::to_string((arenaStats.vertices.capacity * sizeof(BlockVertex)) >> 20) + " MiB"
+            + " (fragmentation " + std::to_string(100.0 * arenaStats.vertices.fragmentation()) + "%)"
+            + ", indices " + std::to_string((arenaStats.indices.numUsed * sizeof(uint32_t)) >> 20) + "/" + std::to_string((arenaStats.indices.capacity * sizeof(uint32_t)) >> 20) + " MiB"
+            + " (fragmentation " + std::to_string(100.0 * arenaStats.indices.fragmentation()) + "%)"
+            + ", in place uploads: " + std::to_string(arenaStats.numInPlaceUploads) + "/" + std::to_string(arenaStats.numUploads));
+        const MapChunkRenderQueue::DrawStats& drawStats = game.mapRenderer().lastDrawStats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Terrain draw calls: ") + std::to_string(drawStats.numDrawCalls) + " for " + std::to_string(drawStats.numDrawnChunks) + " chunks"
+            + (MapChunkMeshArena::instance().usesMultiDrawIndirect() ? " (multi draw indirect)" : " (multi draw base vertex)")
+            + ", submit time: " + std::to_string(drawStats.submitTimeUs) + " us");
+        const MapVisibilityFloodFill::Stats& visibilityStats = game.mapRenderer().lastVisibilityStats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Chunks reached from the camera: ") + std::to_string(visibilityStats.numReached) + "/" + std::to_string(visibilityStats.numCandidates)
+            + " (" + std::to_string(visibilityStats.numVisits) + " visits, " + std::to_string(visibilityStats.timeUs) + " us)");
+        const MapOcclusionCuller::Stats occlusionStats = game.mapRenderer().lastOcclusionStats();
+        Logger::instance().log(Logger::Priority::Info,
+            std::string("Occlusion culled chunks: ") + std::to_string(occlusionStats.numOccluded) + "/" + std::to_string(occlusionStats.numTested)
+            + ", occluders: " + std::to_string(occlusionStats.numOccluders) + " (" + std::to_string(occlusionStats.numOccluderFaces) + " faces)"
+            + ", rasterization: " + std::to_string(occlusionStats.rasterizationTimeUs) + " us"
+            + ", tests: " + std::to_string(occlusionStats.testTimeUs) + " us");
+        Logger::instance().log(Logger::Priority::Info, std::string("Drawn vertices: ") + std::to_string(game.mapRenderer().numDrawnVertices()) + (isGreedy ? " (greedy meshing)" : " (per face meshing)"));
     }
 }
 
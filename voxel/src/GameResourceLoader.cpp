@@ -10,8 +10,8 @@
 
 #include "../LibS/Json.h"
 
-#define NOMINMAX
-#include <windows.h>
+#include <filesystem>
+#include <algorithm>
 
 bool GameResourceLoader::m_areAssetsLoaded = false;
 
@@ -49,7 +49,7 @@ void GameResourceLoader::loadTextures()
 }
 void GameResourceLoader::loadBlocks()
 {
-    for (const auto& tilePath : scanForFiles("assets/blocks/", "*.json"))
+    for (const auto& tilePath : scanForFiles("assets/blocks/", ".json"))
     {
         ResourceManager<BlockFactory>::instance().load(tilePath);
     }
@@ -68,29 +68,17 @@ void GameResourceLoader::loadShaders()
         ResourceManager<ls::gl::ShaderProgram>::instance().loadWithName(name, std::string("assets/shaders/") + vertexPath, std::string("assets/shaders/") + fragmentPath);
     }
 }
-std::wstring GameResourceLoader::stringToWString(const std::string &s)
-{
-    return std::wstring(s.begin(), s.end());
-}
-std::string GameResourceLoader::wstringToString(const std::wstring &s)
-{
-    return std::string(s.begin(), s.end());
-}
-std::vector<std::string> GameResourceLoader::scanForFiles(const std::string& path, const std::string& query)
+std::vector<std::string> GameResourceLoader::scanForFiles(const std::string& path, const std::string& extension)
 {
     std::vector<std::string> files;
-    WIN32_FIND_DATA findFileData;
-    HANDLE hFind;
-    std::wstring fullPath = stringToWString(path + query);
-    hFind = FindFirstFile(fullPath.c_str(), &findFileData);
-    if (hFind != INVALID_HANDLE_VALUE)
-    {
-        files.push_back(path + wstringToString(findFileData.cFileName));
-    }
-    while (FindNextFile(hFind, &findFileData))
+    for (const auto& entry : std::filesystem::directory_iterator(path))
     {
-        files.push_back(path + wstringToString(findFileData.cFileName));
+        if (entry.is_regular_file() && entry.path().extension() == extension)
+        {
+            files.push_back(path + entry.path().filename().string());
+        }
     }
-    FindClose(hFind);
+    // directory order is unspecified, the block order shouldn't depend on the platform
+    std::sort(files.begin(), files.end());
     return files;
 }
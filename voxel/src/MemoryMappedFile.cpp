@@ -0,0 +1,105 @@
+#include "MemoryMappedFile.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MemoryMappedFile::MemoryMappedFile(const std::string& path) :
+    m_data(nullptr),
+    m_size(0),
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr)
+{
+    // others have to be able to keep writing to the file
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open file " + path);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not get size of file " + path);
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    // empty files can't be mapped
+    if (m_size == 0) return;
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr)
+    {
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not map file " + path);
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not map file " + path);
+    }
+}
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::string& path) :
+    m_data(nullptr),
+    m_size(0),
+    m_file(-1)
+{
+    m_file = open(path.c_str(), O_RDONLY);
+    if (m_file < 0) throw std::runtime_error("Could not open file " + path);
+
+    struct stat info;
+    if (fstat(m_file, &info) != 0)
+    {
+        close(m_file);
+        throw std::runtime_error("Could not get size of file " + path);
+    }
+    m_size = static_cast<size_t>(info.st_size);
+
+    // empty files can't be mapped
+    if (m_size == 0) return;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_file);
+        throw std::runtime_error("Could not map file " + path);
+    }
+    m_data = static_cast<const uint8_t*>(data);
+}
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+    close(m_file);
+}
+
+#endif
+
+const uint8_t* MemoryMappedFile::data() const
+{
+    return m_data;
+}
+size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
@@ -0,0 +1,126 @@
+#include "Profiler.h"
+
+#include <fstream>
+
+thread_local Profiler::ThreadBuffer* Profiler::m_currentThreadBuffer = nullptr;
+
+Profiler::Zone::Zone(const char* name) :
+    m_name(name),
+    m_begin(Profiler::instance().now())
+{
+}
+Profiler::Zone::~Zone()
+{
+    Profiler& profiler = Profiler::instance();
+    profiler.record(m_name, m_begin, profiler.now());
+}
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() :
+    m_start(std::chrono::steady_clock::now())
+{
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = currentThreadBuffer();
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+    buffer.threadName = name;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        buffers = m_buffers;
+    }
+
+    file << "{\"traceEvents\":[\n";
+    bool isFirst = true;
+    auto separate = [&file, &isFirst]() {
+        if (!isFirst) file << ",\n";
+        isFirst = false;
+    };
+
+    for (const auto& buffer : buffers)
+    {
+        std::vector<ZoneRecord> records;
+        std::string threadName;
+        {
+            std::unique_lock<std::mutex> lock(buffer->mutex);
+
+            // oldest first, the buffer may have wrapped around
+            records.reserve(buffer->records.size());
+            records.insert(records.end(), buffer->records.begin() + buffer->next, buffer->records.end());
+            records.insert(records.end(), buffer->records.begin(), buffer->records.begin() + buffer->next);
+            threadName = buffer->threadName;
+        }
+
+        if (!threadName.empty())
+        {
+            separate();
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+        }
+
+        for (const auto& record : records)
+        {
+            // timestamps are in microseconds
+            separate();
+            file
+                << "{\"name\":\"" << record.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << static_cast<double>(record.begin) / 1000.0
+                << ",\"dur\":" << static_cast<double>(record.end - record.begin) / 1000.0 << "}";
+        }
+    }
+
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+}
+
+Profiler::ThreadBuffer& Profiler::currentThreadBuffer()
+{
+    if (m_currentThreadBuffer == nullptr)
+    {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->records.reserve(m_bufferCapacity);
+        buffer->next = 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        buffer->threadId = static_cast<int>(m_buffers.size());
+        m_buffers.push_back(buffer);
+        m_currentThreadBuffer = buffer.get();
+    }
+
+    return *m_currentThreadBuffer;
+}
+int64_t Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+void Profiler::record(const char* name, int64_t begin, int64_t end)
+{
+    ThreadBuffer& buffer = currentThreadBuffer();
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+
+    const ZoneRecord record{ name, begin, end };
+    if (buffer.records.size() < m_bufferCapacity)
+    {
+        buffer.records.push_back(record);
+        buffer.next = buffer.records.size() % m_bufferCapacity;
+    }
+    else
+    {
+        buffer.records[buffer.next] = record;
+        buffer.next = (buffer.next + 1) % m_bufferCapacity;
+    }
+}
@@ -0,0 +1,196 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <utility>
+#include <string>
+
+thread_local int ThreadPool::m_currentWorkerIndex = -1;
+
+void ThreadPool::JobHandle::cancel()
+{
+    m_state->isCancelled.store(true, std::memory_order_relaxed);
+}
+bool ThreadPool::JobHandle::isCancelled() const
+{
+    return m_state->isCancelled.load(std::memory_order_relaxed);
+}
+bool ThreadPool::JobHandle::isDone() const
+{
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    return m_state->isDone;
+}
+void ThreadPool::JobHandle::wait() const
+{
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->done.wait(lock, [this]() { return m_state->isDone; });
+}
+bool ThreadPool::JobHandle::isValid() const
+{
+    return m_state != nullptr;
+}
+ThreadPool::JobHandle::JobHandle(std::shared_ptr<JobState> state) :
+    m_state(std::move(state))
+{
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    // one core is left for the main thread
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1u);
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t numThreads) :
+    m_numQueuedJobs(0),
+    m_nextSequenceNumber(0),
+    m_isStopping(false)
+{
+    numThreads = std::max<size_t>(numThreads, 1);
+
+    m_queues.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        m_queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+
+    m_threads.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this, static_cast<int>(i));
+    }
+}
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+ThreadPool::JobHandle ThreadPool::submit(int priority, std::function<void()> job)
+{
+    auto state = std::make_shared<JobState>();
+
+    // jobs spawned by a worker stay on its queue, others are shared by all workers
+    WorkerQueue& queue = m_currentWorkerIndex >= 0
+        ? *m_queues[m_currentWorkerIndex]
+        : m_sharedQueue;
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{ priority, m_nextSequenceNumber.fetch_add(1, std::memory_order_relaxed), std::move(job), state });
+        std::push_heap(queue.jobs.begin(), queue.jobs.end(), &ThreadPool::isLessImportant);
+    }
+    {
+        // has to be done under the lock, otherwise a worker could miss the notification
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        ++m_numQueuedJobs;
+    }
+    m_wakeUp.notify_one();
+
+    return JobHandle(std::move(state));
+}
+
+size_t ThreadPool::numThreads() const
+{
+    return m_threads.size();
+}
+
+bool ThreadPool::isLessImportant(const Job& lhs, const Job& rhs)
+{
+    // equal priorities run in submission order
+    if (lhs.priority != rhs.priority) return lhs.priority > rhs.priority;
+    return lhs.sequenceNumber > rhs.sequenceNumber;
+}
+
+void ThreadPool::workerLoop(int workerIndex)
+{
+    m_currentWorkerIndex = workerIndex;
+    PROFILE_THREAD_NAME("Worker " + std::to_string(workerIndex));
+
+    for (;;)
+    {
+        Job job;
+        if (tryTakeJob(workerIndex, job))
+        {
+            run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.wait(lock, [this]() { return m_isStopping || m_numQueuedJobs.load() > 0; });
+        if (m_isStopping && m_numQueuedJobs.load() == 0) return;
+    }
+}
+bool ThreadPool::tryPeek(WorkerQueue& queue, Job& top)
+{
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+
+    top.priority = queue.jobs.front().priority;
+    top.sequenceNumber = queue.jobs.front().sequenceNumber;
+
+    return true;
+}
+bool ThreadPool::tryPop(WorkerQueue& queue, Job& job)
+{
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+
+    std::pop_heap(queue.jobs.begin(), queue.jobs.end(), &ThreadPool::isLessImportant);
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    --m_numQueuedJobs;
+
+    return true;
+}
+bool ThreadPool::tryTakeJob(int workerIndex, Job& job)
+{
+    WorkerQueue* bestQueue = nullptr;
+    Job best;
+    Job top;
+    auto consider = [&](WorkerQueue& queue) {
+        if (!tryPeek(queue, top)) return;
+        if (bestQueue != nullptr && !isLessImportant(best, top)) return;
+
+        bestQueue = &queue;
+        best.priority = top.priority;
+        best.sequenceNumber = top.sequenceNumber;
+    };
+
+    // the shared queue and the own one first, then try to steal
+    consider(m_sharedQueue);
+    consider(*m_queues[workerIndex]);
+    if (bestQueue == nullptr)
+    {
+        const size_t numQueues = m_queues.size();
+        for (size_t i = 1; i < numQueues; ++i)
+        {
+            consider(*m_queues[(workerIndex + i) % numQueues]);
+        }
+    }
+
+    // the top may have been taken in the meantime, then the next one is just as good
+    return bestQueue != nullptr && tryPop(*bestQueue, job);
+}
+void ThreadPool::run(Job& job)
+{
+    if (!job.state->isCancelled.load(std::memory_order_relaxed))
+    {
+        PROFILE_ZONE("ThreadPool::job");
+        job.function();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(job.state->mutex);
+        job.state->isDone = true;
+    }
+    job.state->done.notify_all();
+}
@@ -2,20 +2,23 @@
 
 #include "block/Block.h"
 
-BlockContainer::BlockContainer(Block* block) :
-    m_block(block)
+BlockContainer::BlockContainer(Block* block, BlockTypeId typeId) :
+    m_block(block),
+    m_typeId(typeId)
 {
 
 }
 
 BlockContainer::BlockContainer() :
-    m_block(nullptr)
+    m_block(nullptr),
+    m_typeId(BlockTypeRegistry::emptyTypeId)
 {
 
 }
-BlockContainer::BlockContainer(const BlockContainer& other)
+BlockContainer::BlockContainer(const BlockContainer& other) :
+    m_typeId(other.m_typeId)
 {
-    if (other.m_block && other.m_block->isStateful())
+    if (other.isStateful())
     {
         m_block = other.m_block->clone().release();
     }
@@ -26,19 +29,23 @@ BlockContainer::BlockContainer(const BlockContainer& other)
 }
 
 BlockContainer::BlockContainer(BlockContainer&& other) :
-    m_block(other.m_block)
+    m_block(other.m_block),
+    m_typeId(other.m_typeId)
 {
     other.m_block = nullptr;
+    other.m_typeId = BlockTypeRegistry::emptyTypeId;
 }
 
 BlockContainer& BlockContainer::operator=(const BlockContainer& other)
 {
-    if (m_block && m_block->isStateful())
+    if (this == &other) return *this;
+
+    if (isStateful())
     {
         delete m_block;
     }
 
-    if (other.m_block && other.m_block->isStateful())
+    if (other.isStateful())
     {
         m_block = other.m_block->clone().release();
     }
@@ -46,13 +53,24 @@ BlockContainer& BlockContainer::operator=(const BlockContainer& other)
     {
         m_block = other.m_block;
     }
+    m_typeId = other.m_typeId;
 
     return *this;
 }
 BlockContainer& BlockContainer::operator=(BlockContainer&& other)
 {
+    if (this == &other) return *this;
+
+    // the pool cell of the previous block has to be given back
+    if (isStateful())
+    {
+        delete m_block;
+    }
+
     m_block = other.m_block;
+    m_typeId = other.m_typeId;
     other.m_block = nullptr;
+    other.m_typeId = BlockTypeRegistry::emptyTypeId;
 
     return *this;
 }
@@ -66,6 +84,15 @@ Block& BlockContainer::block()
     return *m_block;
 }
 
+BlockTypeId BlockContainer::typeId() const
+{
+    return m_typeId;
+}
+bool BlockContainer::isStateful() const
+{
+    return m_block && BlockTypeRegistry::instance().isStateful(m_typeId);
+}
+
 bool BlockContainer::isEmpty() const
 {
     return m_block == nullptr;
@@ -73,7 +100,7 @@ bool BlockContainer::isEmpty() const
 
 BlockContainer::~BlockContainer()
 {
-    if (m_block && m_block->isStateful())
+    if (isStateful())
     {
         delete m_block;
     }
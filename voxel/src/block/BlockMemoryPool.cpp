@@ -0,0 +1,44 @@
+#include "block/BlockMemoryPool.h"
+
+BlockAllocationCounters& BlockAllocationCounters::instance()
+{
+    static BlockAllocationCounters counters;
+    return counters;
+}
+
+BlockAllocationCounters::BlockAllocationCounters() :
+    m_numAllocations(0),
+    m_numDeallocations(0),
+    m_numHeapAllocations(0),
+    m_capacity(0)
+{
+}
+
+void BlockAllocationCounters::onPoolCreated(size_t numCells)
+{
+    m_numHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    m_capacity.fetch_add(numCells, std::memory_order_relaxed);
+}
+void BlockAllocationCounters::onAllocated(size_t numNewCells)
+{
+    m_numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (numNewCells > 0)
+    {
+        m_numHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+        m_capacity.fetch_add(numNewCells, std::memory_order_relaxed);
+    }
+}
+void BlockAllocationCounters::onDeallocated()
+{
+    m_numDeallocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+BlockAllocationCounters::Stats BlockAllocationCounters::stats() const
+{
+    return Stats{
+        m_numAllocations.load(std::memory_order_relaxed),
+        m_numDeallocations.load(std::memory_order_relaxed),
+        m_numHeapAllocations.load(std::memory_order_relaxed),
+        m_capacity.load(std::memory_order_relaxed)
+    };
+}
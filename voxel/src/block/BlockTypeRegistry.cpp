@@ -0,0 +1,63 @@
+#include "block/BlockTypeRegistry.h"
+
+#include "block/Block.h"
+
+#include <stdexcept>
+#include <string>
+
+BlockTypeRegistry& BlockTypeRegistry::instance()
+{
+    static BlockTypeRegistry registry;
+    return registry;
+}
+
+BlockTypeRegistry::BlockTypeRegistry()
+{
+    // the empty type draws nothing and covers nothing
+    resize(1);
+}
+
+BlockTypeId BlockTypeRegistry::reserveTypeId()
+{
+    const size_t typeId = numTypes();
+    if (typeId >= m_maxNumTypes) throw std::runtime_error("Too many block types");
+
+    resize(typeId + 1);
+    return static_cast<BlockTypeId>(typeId);
+}
+void BlockTypeRegistry::registerType(BlockTypeId typeId, const Block* statelessBlock)
+{
+    if (typeId == emptyTypeId || typeId >= numTypes()) throw std::runtime_error("Block type id " + std::to_string(typeId) + " was not reserved");
+
+    if (statelessBlock == nullptr)
+    {
+        // everything has to be asked from the instance
+        m_isStateful[typeId] = true;
+        m_mesherKind[typeId] = BlockMesherKind::Custom;
+        m_hasHooks[typeId] = true;
+        return;
+    }
+
+    m_isStateful[typeId] = false;
+    m_sideOpacity[typeId] = statelessBlock->sideOpacity();
+    for (const auto& side : CubeSide::values())
+    {
+        m_faceTiles[typeId][side.ordinal()] = statelessBlock->faceTile(side);
+    }
+    m_mesherKind[typeId] = statelessBlock->mesherKind();
+    m_hasHooks[typeId] = statelessBlock->hasHooks();
+}
+
+size_t BlockTypeRegistry::numTypes() const
+{
+    return m_isStateful.size();
+}
+
+void BlockTypeRegistry::resize(size_t numTypes)
+{
+    m_isStateful.resize(numTypes, false);
+    m_sideOpacity.resize(numTypes, BlockSideOpacity::none());
+    m_faceTiles.resize(numTypes, std::array<ls::Vec2I, 6>{});
+    m_mesherKind.resize(numTypes, BlockMesherKind::None);
+    m_hasHooks.resize(numTypes, false);
+}
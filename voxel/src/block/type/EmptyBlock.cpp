@@ -10,11 +10,21 @@ EmptyBlock::EmptyBlock(const SharedData& sharedData) :
 
 }
 
+const BlockFactory& EmptyBlock::factory() const
+{
+    return *m_sharedData->blockFactory;
+}
+
 BlockSideOpacity EmptyBlock::sideOpacity() const
 {
     return BlockSideOpacity::none();
 }
 
+BlockMesherKind EmptyBlock::mesherKind() const
+{
+    return BlockMesherKind::None;
+}
+
 std::unique_ptr<Block> EmptyBlock::clone() const
 {
     return std::make_unique<EmptyBlock>(*this);
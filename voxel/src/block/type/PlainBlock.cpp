@@ -3,8 +3,6 @@
 #include "block/BlockResourceLoader.h"
 #include "block/BlockVertex.h"
 
-#include "sprite/Spritesheet.h"
-
 #include "CubeSide.h"
 
 #include "../LibS/Json.h"
@@ -16,16 +14,12 @@ REGISTER_BLOCK_TYPE(PlainBlock);
 PlainBlock::SharedData::SharedData(SpecificBlockFactory<PlainBlock>& blockFactory, const ls::json::Value& config) :
     BlockSharedData<PlainBlock>(blockFactory, config)
 {
-    const Spritesheet& texture = ResourceManager<Spritesheet>::instance().get("Spritesheet").get();
-
-    texCoords[CubeSide::East] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["eastTexCoords"]));
-    texCoords[CubeSide::West] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["westTexCoords"]));
-    texCoords[CubeSide::Top] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["topTexCoords"]));
-    texCoords[CubeSide::Bottom] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["bottomTexCoords"]));
-    texCoords[CubeSide::South] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["southTexCoords"]));
-    texCoords[CubeSide::North] = texture.gridCoordsToTexCoordsF(ls::json::fromJson<ls::Vec2I>(config["northTexCoords"]));
-
-    texSize = texture.gridSizeToTexSizeF({ 1, 1 });
+    tiles[CubeSide::East] = ls::json::fromJson<ls::Vec2I>(config["eastTexCoords"]);
+    tiles[CubeSide::West] = ls::json::fromJson<ls::Vec2I>(config["westTexCoords"]);
+    tiles[CubeSide::Top] = ls::json::fromJson<ls::Vec2I>(config["topTexCoords"]);
+    tiles[CubeSide::Bottom] = ls::json::fromJson<ls::Vec2I>(config["bottomTexCoords"]);
+    tiles[CubeSide::South] = ls::json::fromJson<ls::Vec2I>(config["southTexCoords"]);
+    tiles[CubeSide::North] = ls::json::fromJson<ls::Vec2I>(config["northTexCoords"]);
 
     opacity = BlockSideOpacity::fromJson(config["opacity"]);
 }
@@ -49,8 +43,6 @@ void PlainBlock::drawFace(std::vector<BlockVertex>& vertices, std::vector<uint32
 {
     static const std::array<unsigned, 6> faceIndices = CubeSide::faceIndices();
 
-    const ls::Vec3F positionF(position);
-
     const uint32_t lastIndex = static_cast<uint32_t>(vertices.size());
     const auto& face = side.faceVertices();
 
@@ -58,8 +50,9 @@ void PlainBlock::drawFace(std::vector<BlockVertex>& vertices, std::vector<uint32
     {
         vertices.push_back(
             BlockVertex{
-                v.pos + positionF,
-                m_sharedData->texCoords[static_cast<unsigned>(side)] + m_sharedData->texSize * v.uv
+                v.pos + position,
+                v.uv,
+                m_sharedData->tiles[static_cast<unsigned>(side)]
             }
         );
     }
@@ -69,10 +62,22 @@ void PlainBlock::drawFace(std::vector<BlockVertex>& vertices, std::vector<uint32
         indices.emplace_back(lastIndex + i);
     }
 }
+const BlockFactory& PlainBlock::factory() const
+{
+    return *m_sharedData->blockFactory;
+}
 BlockSideOpacity PlainBlock::sideOpacity() const
 {
     return m_sharedData->opacity;
 }
+BlockMesherKind PlainBlock::mesherKind() const
+{
+    return BlockMesherKind::Cube;
+}
+ls::Vec2I PlainBlock::faceTile(CubeSide side) const
+{
+    return m_sharedData->tiles[static_cast<unsigned>(side)];
+}
 
 std::unique_ptr<Block> PlainBlock::clone() const
 {
@@ -1,33 +1,79 @@
 #include "map/Map.h"
 
-#include "Game.h"
-
 #include "CubeSide.h"
+#include "Profiler.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <string>
 
 Map::Map(uint32_t seed) :
-    m_renderer{},
+    Map(seed, "saves/" + std::to_string(seed))
+{
+}
+Map::Map(uint32_t seed, const std::string& saveDirectory) :
     m_generator(*this),
     m_seed(seed),
     m_airFactory(ResourceManager<BlockFactory>::instance().get("Air")),
-    m_timeSinceLastMissingChunkPosCacheUpdate(0.0f),
-    m_missingChunkPosCacheCurrentPosition(0),
-    m_missingChunkPosCacheLastOrigin(1, 1, 1) // must not be the starting chunk
+    m_regions(saveDirectory),
+    m_residency(m_defaultMemoryBudget),
+    m_farChunkCandidatesLastOrigin(0, 0, 0),
+    m_missingChunks(m_chunkLoadingRange, 0, m_maxWorldHeight / static_cast<int>(MapChunk::height()) - 1),
+    m_timeSinceLastMissingChunksRekey(0.0f),
+    m_missingChunksLastRekeyOrigin(0, 0, 0),
+    m_generatorCachesLastEvictionOrigin(0, 0, 0),
+    m_timeSinceLastStorageReserveTrim(0.0f)
 {
 }
-std::map<ls::Vec3I, MapChunk>& Map::chunks()
+Map::~Map()
+{
+    // jobs reference the map, so they have to finish before it is destroyed
+    for (auto& [pos, job] : m_chunksInGeneration)
+    {
+        job.cancel();
+    }
+    for (auto& [pos, job] : m_chunksInGeneration)
+    {
+        job.wait();
+    }
+
+    for (const auto& chunk : m_chunks)
+    {
+        if (chunk.isDirty()) m_regions.saveChunkAsync(chunk.pos(), chunk.blocks());
+    }
+    m_regions.flush();
+}
+MapChunkIndex& Map::chunks()
 {
     return m_chunks;
 }
-const std::map<ls::Vec3I, MapChunk>& Map::chunks() const
+const MapChunkIndex& Map::chunks() const
 {
     return m_chunks;
 }
 
-void Map::draw(const ls::gl::Camera& camera, float dt)
+const MapGenerator& Map::generator() const
 {
-    m_renderer.draw(*this, camera, dt);
+    return m_generator;
+}
+
+const MapResidency& Map::residency() const
+{
+    return m_residency;
+}
+void Map::setMemoryBudget(size_t bytes)
+{
+    m_residency.setBudget(bytes);
+}
+void Map::markChunkVisible(const ls::Vec3I& pos)
+{
+    m_residency.markVisible(pos);
+}
+void Map::onChunkMemoryUsageChanged(const ls::Vec3I& pos, const MapChunkMemoryUsage& previousUsage, const MapChunkMemoryUsage& usage)
+{
+    m_residency.update(pos, previousUsage, usage);
 }
 
 BlockContainer Map::instantiateAirBlock() const
@@ -35,21 +81,42 @@ BlockContainer Map::instantiateAirBlock() const
     return m_airFactory.get().instantiate();
 }
 
-void Map::update(Game& game, float dt)
+void Map::update(const ls::Vec3F& cameraPos, float dt)
 {
-    const auto& cameraPos = game.camera().position();
+    PROFILE_ZONE("Map::update");
 
     const auto currentChunk = worldToChunk(cameraPos);
 
+    m_chunks.recenter(currentChunk);
+
     trySpawnNewChunks(currentChunk);
     unloadFarChunks(currentChunk);
+    evictChunksOverBudget();
+    if (m_generatorCachesLastEvictionOrigin != currentChunk)
+    {
+        m_generator.evictFarCaches(currentChunk, m_minChunkDistanceToUnload);
+        m_generatorCachesLastEvictionOrigin = currentChunk;
+    }
+
+    m_timeSinceLastMissingChunksRekey += dt;
+    if (m_timeSinceLastMissingChunksRekey >= m_timeBetweenMissingChunksRekeys && m_missingChunksLastRekeyOrigin != currentChunk)
+    {
+        // evicted chunks are not loaded again right away, that would only evict others
+        for (const auto& pos : m_evictedChunks)
+        {
+            m_missingChunks.push(pos);
+        }
+        m_evictedChunks.clear();
+        m_missingChunks.rekey();
+        m_timeSinceLastMissingChunksRekey = 0.0f;
+        m_missingChunksLastRekeyOrigin = currentChunk;
+    }
 
-    m_timeSinceLastMissingChunkPosCacheUpdate += dt;
-    if (m_timeSinceLastMissingChunkPosCacheUpdate >= m_timeBetweenMissingChunkPosCacheUpdates && m_missingChunkPosCacheLastOrigin != currentChunk)
+    m_timeSinceLastStorageReserveTrim += dt;
+    if (m_timeSinceLastStorageReserveTrim >= m_timeBetweenStorageReserveTrims)
     {
-        updateMissingChunkPosCache(currentChunk);
-        m_timeSinceLastMissingChunkPosCacheUpdate = 0.0f;
-        m_missingChunkPosCacheLastOrigin = currentChunk;
+        MapChunkStorageReserve::instance().trim();
+        m_timeSinceLastStorageReserveTrim = 0.0f;
     }
 }
 
@@ -60,7 +127,7 @@ ls::Vec3I Map::worldToChunk(const ls::Vec3F& worldPos) const
     return ls::floorToInt(worldPos / chunkSizeF);
 }
 
-bool Map::isValidChunkPos(const ls::Vec3I& pos) const
+bool Map::isValidChunkPos(const ls::Vec3I& pos)
 {
     if (pos.y < 0) return false;
     if (pos.y >= m_maxWorldHeight / static_cast<int>(MapChunk::height())) return false;
@@ -69,50 +136,106 @@ bool Map::isValidChunkPos(const ls::Vec3I& pos) const
 }
 
 
-std::vector<std::pair<ls::Vec3I, MapChunkBlockData>> Map::generateChunksIsolated(const std::vector<ls::Vec3I>& positions)
+void Map::generateChunkIsolated(const ls::Vec3I& pos)
 {
-    std::vector<std::pair<ls::Vec3I, MapChunkBlockData>> chunks;
+    MapChunkBlockData chunk(*this, pos);
+    loadOrGenerateChunk(chunk);
 
-    for (const auto& pos : positions)
+    std::unique_lock<std::mutex> lock(m_generatedChunksMutex);
+    m_generatedChunks.emplace_back(std::move(chunk));
+}
+void Map::loadOrGenerateChunk(MapChunkBlockData& chunk)
+{
+    if (!m_regions.tryLoadChunk(chunk.pos, chunk.blocks))
     {
-        chunks.emplace_back(generateChunkIsolated(pos));
+        m_generator.generateChunk(chunk);
     }
-
-    return chunks;
 }
-std::pair<ls::Vec3I, MapChunkBlockData> Map::generateChunkIsolated(const ls::Vec3I& pos)
+void Map::trySpawnNewChunks(const ls::Vec3I& currentChunk)
 {
-    return std::make_pair(pos, MapChunkBlockData(*this, m_generator, pos));
+    PROFILE_ZONE("Map::trySpawnNewChunks");
+
+    spawnGeneratedChunks();
+    cancelFarChunkGeneration(currentChunk);
+    requestChunkGeneration(currentChunk);
 }
-void Map::trySpawnNewChunks(const ls::Vec3I& currentChunk)
+void Map::spawnGeneratedChunks()
 {
-    bool ready = false;
-    bool valid = m_generatedChunks.valid();
-    if (valid && m_generatedChunks.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    std::vector<MapChunkBlockData> chunks;
+    {
+        std::unique_lock<std::mutex> lock(m_generatedChunksMutex);
+        const size_t numChunks = std::min(m_generatedChunks.size(), static_cast<size_t>(m_maxChunksSpawnedPerUpdate));
+        chunks.reserve(numChunks);
+        std::move(m_generatedChunks.begin(), m_generatedChunks.begin() + numChunks, std::back_inserter(chunks));
+        m_generatedChunks.erase(m_generatedChunks.begin(), m_generatedChunks.begin() + numChunks);
+    }
+
+    for (auto& chunk : chunks)
     {
-        ready = true;
+        const ls::Vec3I pos = chunk.pos;
+        auto request = m_chunksInGeneration.find(pos);
 
-        auto chunks = m_generatedChunks.get();
-        for (auto& chunk : chunks)
+        // the request is gone or cancelled if the chunk went out of range while generating
+        if (request == m_chunksInGeneration.end()) continue;
+
+        const bool isCancelled = request->second.isCancelled();
+        m_chunksInGeneration.erase(request);
+        if (isCancelled)
         {
-            spawnChunk(chunk.first, std::move(chunk.second));
+            // the camera may have come back since
+            m_missingChunks.push(pos);
+            continue;
         }
-        m_missingChunksInGeneration.clear();
-    }
 
-    if(!valid || ready)
+        spawnChunk(pos, std::move(chunk));
+    }
+}
+void Map::cancelFarChunkGeneration(const ls::Vec3I& currentChunk)
+{
+    // a chunk that would be unloaded right after spawning is not worth generating
+    for (auto iter = m_chunksInGeneration.begin(); iter != m_chunksInGeneration.end();)
     {
-        const size_t numMissingChunks = m_missingChunkPosCache.size();
-        for (size_t i = 0; i < m_maxChunksSpawnedPerUpdate && m_missingChunkPosCacheCurrentPosition < numMissingChunks; ++i)
+        if (distanceBetweenChunks(currentChunk, iter->first) >= m_minChunkDistanceToUnload)
         {
-            m_missingChunksInGeneration.emplace_back(m_missingChunkPosCache[m_missingChunkPosCacheCurrentPosition]);
-            ++m_missingChunkPosCacheCurrentPosition;
+            iter->second.cancel();
         }
 
-        m_generatedChunks = std::async(std::launch::async, [this](const std::vector<ls::Vec3I>& p) {return generateChunksIsolated(p); }, m_missingChunksInGeneration);
-        //m_generatedChunks.wait();
+        if (iter->second.isCancelled() && iter->second.isDone())
+        {
+            // if it ran anyway the result has no request and is discarded in spawnGeneratedChunks,
+            // the camera may have come back since
+            m_missingChunks.push(iter->first);
+            iter = m_chunksInGeneration.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
     }
 }
+void Map::requestChunkGeneration(const ls::Vec3I& currentChunk)
+{
+    // new chunks would only push out others
+    if (m_residency.isOverBudget()) return;
+
+    m_missingChunks.setOrigin(currentChunk);
+
+    const size_t maxChunksInGeneration = ThreadPool::instance().numThreads() * m_maxChunksInGenerationPerThread;
+    ls::Vec3I pos;
+    while (m_chunksInGeneration.size() < maxChunksInGeneration && m_missingChunks.pop(pos))
+    {
+        // positions are queued without checking, some are already there
+        if (m_chunks.contains(pos) || isChunkInGeneration(pos)) continue;
+
+        const int priority = MapChunkLoadQueue::priority(pos - currentChunk);
+        auto job = ThreadPool::instance().submit(priority, [this, pos]() { generateChunkIsolated(pos); });
+        m_chunksInGeneration.emplace(pos, std::move(job));
+    }
+}
+bool Map::isChunkInGeneration(const ls::Vec3I& pos) const
+{
+    return m_chunksInGeneration.count(pos) != 0;
+}
 
 uint32_t Map::seed() const
 {
@@ -123,13 +246,7 @@ MapChunk* Map::chunkAt(const ls::Vec3I& pos)
 {
     if (!isValidChunkPos(pos)) return nullptr;
 
-    auto iter = m_chunks.find(pos);
-    if (iter != m_chunks.end())
-    {
-        return &(iter->second);
-    }
-
-    return nullptr;
+    return m_chunks.find(pos);
 }
 MapChunkNeighbours Map::chunkNeighbours(const ls::Vec3I& pos)
 {
@@ -144,15 +261,23 @@ MapChunkNeighbours Map::chunkNeighbours(const ls::Vec3I& pos)
 }
 void Map::spawnChunk(const ls::Vec3I& pos)
 {
-    MapChunkBlockData blockData(*this, m_generator, pos);
+    MapChunkBlockData blockData(*this, pos);
+    loadOrGenerateChunk(blockData);
     spawnChunk(pos, std::move(blockData));
 }
 void Map::spawnChunk(const ls::Vec3I& pos, MapChunkBlockData&& chunk)
 {
-    const auto neighbours = chunkNeighbours(pos);
-    auto p = m_chunks.emplace(std::make_pair(pos, MapChunk(std::move(chunk), neighbours)));
-    auto& placedChunk = p.first->second;
+    auto& placedChunk = m_chunks.emplace(MapChunk(std::move(chunk), chunkNeighbours(pos)));
+    m_residency.add(pos, placedChunk.memoryUsage());
+
+    // it may have been requested before the origin moved away
+    if (distanceBetweenChunks(m_farChunkCandidatesLastOrigin, pos) >= m_minChunkDistanceToUnload)
+    {
+        m_farChunkCandidates.push_back(pos);
+    }
 
+    // emplacing may have moved other chunks, so the neighbours have to be queried again
+    const auto neighbours = chunkNeighbours(pos);
     for (const auto& side : CubeSide::values())
     {
         if (neighbours[side]) neighbours[side]->onAdjacentChunkPlaced(placedChunk, pos);
@@ -160,67 +285,97 @@ void Map::spawnChunk(const ls::Vec3I& pos, MapChunkBlockData&& chunk)
 }
 void Map::unloadFarChunks(const ls::Vec3I& currentChunk)
 {
+    if (currentChunk != m_farChunkCandidatesLastOrigin)
+    {
+        collectFarChunkCandidates(m_farChunkCandidatesLastOrigin, currentChunk);
+        m_farChunkCandidatesLastOrigin = currentChunk;
+    }
+
     int numRemovedChunks = 0;
-    for (auto iter = m_chunks.begin(); iter != m_chunks.end() && numRemovedChunks < m_maxChunksRemovedPerUpdate;)
+    while (!m_farChunkCandidates.empty() && numRemovedChunks < m_maxChunksRemovedPerUpdate)
     {
-        auto& pos = iter->first;
-        if (distanceBetweenChunks(currentChunk, pos) >= m_minChunkDistanceToUnload)
-        {
-            iter = unloadChunk(iter);
-            ++numRemovedChunks;
-        }
-        else
-        {
-            ++iter;
-        }
+        const ls::Vec3I pos = m_farChunkCandidates.back();
+        m_farChunkCandidates.pop_back();
+
+        // the camera may have come back since
+        if (distanceBetweenChunks(currentChunk, pos) < m_minChunkDistanceToUnload) continue;
+
+        if (unloadChunk(pos)) ++numRemovedChunks;
     }
 }
-std::map<ls::Vec3I, MapChunk>::iterator Map::unloadChunk(const std::map<ls::Vec3I, MapChunk>::iterator& iter)
-{
-    return m_chunks.erase(iter);
-}
-int Map::distanceBetweenChunks(const ls::Vec3I& lhs, const ls::Vec3I& rhs)
+void Map::collectFarChunkCandidates(const ls::Vec3I& previousOrigin, const ls::Vec3I& origin)
 {
-    return std::max({ std::abs(lhs.x - rhs.x), std::abs(lhs.y - rhs.y), std::abs(lhs.z - rhs.z) });
-}
+    static constexpr int range = m_minChunkDistanceToUnload - 1;
+    static constexpr int maxChunkY = m_maxWorldHeight / static_cast<int>(MapChunk::height()) - 1;
 
-void Map::updateMissingChunkPosCache(const ls::Vec3I& currentChunkPos)
-{
-    const static std::vector<ls::Vec3I> order = []() ->std::vector<ls::Vec3I>
+    const ls::Vec3I diff = origin - previousOrigin;
+    if (std::max({ std::abs(diff.x), std::abs(diff.y), std::abs(diff.z) }) > range * 2)
+    {
+        // nothing stays in range after a jump this far
+        for (const auto& chunk : m_chunks)
+        {
+            m_farChunkCandidates.push_back(chunk.pos());
+        }
+        return;
+    }
+
+    // the chunks that left the range lie in slabs along the axes the origin moved along,
+    // slabs of different axes overlap, but duplicates are skipped when unloading
+    const ls::Vec3I rangeMin(previousOrigin.x - range, std::max(0, previousOrigin.y - range), previousOrigin.z - range);
+    const ls::Vec3I rangeMax(previousOrigin.x + range, std::min(maxChunkY, previousOrigin.y + range), previousOrigin.z + range);
+    for (int axis = 0; axis < 3; ++axis)
     {
-        std::vector<ls::Vec3I> result;
-        const int dim = m_chunkLoadingRange * 2 + 1;
-        result.reserve(dim * dim * dim);
-        for (int dx = -m_chunkLoadingRange; dx <= m_chunkLoadingRange; ++dx)
+        if (diff[axis] == 0) continue;
+
+        ls::Vec3I slabMin = rangeMin;
+        ls::Vec3I slabMax = rangeMax;
+        if (diff[axis] > 0) slabMax[axis] = std::min(rangeMax[axis], origin[axis] - range - 1);
+        else slabMin[axis] = std::max(rangeMin[axis], origin[axis] + range + 1);
+
+        for (int x = slabMin.x; x <= slabMax.x; ++x)
         {
-            for (int dy = -m_chunkLoadingRange; dy <= m_chunkLoadingRange; ++dy)
+            for (int y = slabMin.y; y <= slabMax.y; ++y)
             {
-                for (int dz = -m_chunkLoadingRange; dz <= m_chunkLoadingRange; ++dz)
+                for (int z = slabMin.z; z <= slabMax.z; ++z)
                 {
-                    result.emplace_back(dx, dy, dz);
+                    const ls::Vec3I pos(x, y, z);
+                    if (m_chunks.contains(pos)) m_farChunkCandidates.push_back(pos);
                 }
             }
         }
-
-        std::sort(result.begin(), result.end(), [](const ls::Vec3I& lhs, const ls::Vec3I& rhs) {
-            return std::abs(lhs.x) + std::abs(lhs.y * 2) + std::abs(lhs.z) < std::abs(rhs.x) + std::abs(rhs.y * 2) + std::abs(rhs.z); // value horizontal directions more
-        });
-
-        return result;
-    }();
-
-    m_missingChunkPosCache.clear();
-
-    for (const auto& offset : order)
+    }
+}
+void Map::evictChunksOverBudget()
+{
+    int numRemovedChunks = 0;
+    ls::Vec3I pos;
+    while (m_residency.isOverBudget() && numRemovedChunks < m_maxChunksRemovedPerUpdate && m_residency.leastRecentlyVisible(pos))
     {
-        const auto pos = currentChunkPos + offset;
-        if (!isValidChunkPos(pos)) continue;
+        unloadChunk(pos);
+        m_residency.onEvicted();
+        m_evictedChunks.push_back(pos);
+        ++numRemovedChunks;
+    }
+}
+bool Map::unloadChunk(const ls::Vec3I& pos)
+{
+    MapChunk* chunk = m_chunks.find(pos);
+    if (chunk == nullptr) return false;
 
-        if (m_chunks.count(pos) == 0 && std::find(m_missingChunksInGeneration.begin(), m_missingChunksInGeneration.end(), pos) == m_missingChunksInGeneration.end())
-        {
-            m_missingChunkPosCache.emplace_back(pos);
-        }
+    unloadChunk(m_chunks.begin() + (chunk - &*m_chunks.begin()));
+    return true;
+}
+MapChunkIndex::iterator Map::unloadChunk(const MapChunkIndex::iterator& iter)
+{
+    if (iter->isDirty())
+    {
+        m_regions.saveChunkAsync(iter->pos(), iter->blocks());
     }
 
-    m_missingChunkPosCacheCurrentPosition = 0;
+    m_residency.remove(iter->pos(), iter->memoryUsage());
+    return m_chunks.erase(iter);
+}
+int Map::distanceBetweenChunks(const ls::Vec3I& lhs, const ls::Vec3I& rhs)
+{
+    return std::max({ std::abs(lhs.x - rhs.x), std::abs(lhs.y - rhs.y), std::abs(lhs.z - rhs.z) });
 }
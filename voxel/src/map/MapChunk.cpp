@@ -7,22 +7,24 @@
 
 #include "CubeSide.h"
 
+#include <algorithm>
+
 MapChunkBlockData::MapChunkBlockData(Map& map, MapGenerator& mapGenerator, const ls::Vec3I& pos) :
     map(&map),
     pos(pos),
     seed(map.seed()),
-    blocks(MapChunkStorageReserve::instance().loadBlockArray())
+    blocks()
 {
     mapGenerator.generateChunk(*this);
 }
-
-MapChunkBlockData::~MapChunkBlockData()
+MapChunkBlockData::MapChunkBlockData(Map& map, const ls::Vec3I& pos) :
+    map(&map),
+    pos(pos),
+    seed(map.seed()),
+    blocks()
 {
-    if (!blocks.isEmpty())
-    {
-        MapChunkStorageReserve::instance().storeBlockArray(std::move(blocks));
-    }
 }
+
 ls::Vec3I MapChunkBlockData::firstBlockPosition() const
 {
     return pos * ls::Vec3I(static_cast<int>(MapChunk::m_width), static_cast<int>(MapChunk::m_height), static_cast<int>(MapChunk::m_depth));
@@ -31,44 +33,57 @@ MapChunk::MapChunk(Map& map, const ls::Vec3I& pos, const MapChunkNeighbours& nei
     m_map(&map),
     m_seed(map.seed()),
     m_pos(pos),
-    m_blocks(MapChunkStorageReserve::instance().loadBlockArray()),
-    m_outsideOpacityCache(MapChunkStorageReserve::instance().loadOpacityArray())
-{
-    m_boundingSphere = computeBoundingSphere();
+    m_faceConnectivity(MapChunkFaceConnectivity::none()),
+    m_blocks(),
+    m_isDirty(false),
+    m_blockOpacityMasks(BlockOpacityMaskArray::makeEmpty()),
+    m_borderOpacity(createOpaqueBorderOpacity()),
+    m_memoryUsage{ 0, 0, 0, 0 }
+{
+    m_boundingSphere = computeBoundingSphere(m_pos);
+    updateVisibility();
     updateOutsideOpacityOnChunkBorders(neighbours);
+    m_memoryUsage = computeMemoryUsage();
 }
 MapChunk::MapChunk(MapChunkBlockData&& chunkBlockData, const MapChunkNeighbours& neighbours) :
     m_map(chunkBlockData.map),
     m_seed(chunkBlockData.seed),
     m_pos(chunkBlockData.pos),
+    m_faceConnectivity(MapChunkFaceConnectivity::none()),
     m_blocks(std::move(chunkBlockData.blocks)),
-    m_outsideOpacityCache(MapChunkStorageReserve::instance().loadOpacityArray())
+    m_isDirty(false),
+    m_blockOpacityMasks(m_blocks.isUniform() ? BlockOpacityMaskArray::makeEmpty() : MapChunkStorageReserve::instance().loadOpacityMasks()),
+    m_borderOpacity(createOpaqueBorderOpacity()),
+    m_memoryUsage{ 0, 0, 0, 0 }
 {
-    m_boundingSphere = computeBoundingSphere();
+    m_boundingSphere = computeBoundingSphere(m_pos);
     updateOutsideOpacity(neighbours);
+    updateVisibility();
     updateAllAsIfPlaced();
+    m_memoryUsage = computeMemoryUsage();
 }
 MapChunk::MapChunk(MapChunk&& other) noexcept :
     m_map(std::move(other.m_map)),
     m_seed(std::move(other.m_seed)),
     m_pos(std::move(other.m_pos)),
     m_boundingSphere(std::move(other.m_boundingSphere)),
+    m_occluderBox(std::move(other.m_occluderBox)),
+    m_faceConnectivity(other.m_faceConnectivity),
     m_renderer(std::move(other.m_renderer)),
     m_blocks(std::move(other.m_blocks)),
-    m_outsideOpacityCache(std::move(other.m_outsideOpacityCache))
+    m_isDirty(other.m_isDirty),
+    m_blockOpacityMasks(std::move(other.m_blockOpacityMasks)),
+    m_borderOpacity(std::move(other.m_borderOpacity)),
+    m_memoryUsage(other.m_memoryUsage)
 {
 
 }
 
 MapChunk::~MapChunk()
 {
-    if (!m_blocks.isEmpty())
-    {
-        MapChunkStorageReserve::instance().storeBlockArray(std::move(m_blocks));
-    }
-    if (!m_outsideOpacityCache.isEmpty())
+    if (!m_blockOpacityMasks.isEmpty())
     {
-        MapChunkStorageReserve::instance().storeOpacityArray(std::move(m_outsideOpacityCache));
+        MapChunkStorageReserve::instance().storeOpacityMasks(std::move(m_blockOpacityMasks));
     }
 }
 MapChunk& MapChunk::operator=(MapChunk&& other) noexcept
@@ -77,9 +92,14 @@ MapChunk& MapChunk::operator=(MapChunk&& other) noexcept
     m_seed = std::move(other.m_seed);
     m_pos = std::move(other.m_pos);
     m_boundingSphere = std::move(other.m_boundingSphere);
+    m_occluderBox = std::move(other.m_occluderBox);
+    m_faceConnectivity = other.m_faceConnectivity;
     m_renderer = std::move(other.m_renderer);
     m_blocks = std::move(other.m_blocks);
-    m_outsideOpacityCache = std::move(other.m_outsideOpacityCache);
+    m_isDirty = other.m_isDirty;
+    m_blockOpacityMasks = std::move(other.m_blockOpacityMasks);
+    m_borderOpacity = std::move(other.m_borderOpacity);
+    m_memoryUsage = other.m_memoryUsage;
 
     return *this;
 }
@@ -108,27 +128,35 @@ void MapChunk::emplaceBlock(const BlockFactory& blockFactory, const ls::Vec3I& l
 
 void MapChunk::placeBlock(BlockContainer&& block, const ls::Vec3I& localPos, bool doUpdate)
 {
-    BlockContainer& dest = at(localPos);
-    dest = std::move(block);
+    m_blocks.set(localPos.x, localPos.y, localPos.z, std::move(block));
+    ensureBlockOpacityMasks();
+    updateBlockOpacityMask(localPos);
+    updateVisibility();
+    m_isDirty = true;
     if (doUpdate)
     {
-        dest.block().onBlockPlaced(*m_map, localPos);
+        m_blocks.block(localPos.x, localPos.y, localPos.z).onBlockPlaced(*m_map, localPos);
     }
 
     m_renderer.scheduleUpdate();
+    updateMemoryUsage();
 }
 
 BlockContainer MapChunk::removeBlock(const ls::Vec3I& localPos, bool doUpdate)
 {
-    BlockContainer& block = at(localPos);
     if (doUpdate)
     {
-        block.block().onBlockRemoved(*m_map, localPos);
+        m_blocks.block(localPos.x, localPos.y, localPos.z).onBlockRemoved(*m_map, localPos);
     }
 
-    block = m_map->instantiateAirBlock();
+    BlockContainer block = m_blocks.exchange(localPos.x, localPos.y, localPos.z, m_map->instantiateAirBlock());
+    ensureBlockOpacityMasks();
+    updateBlockOpacityMask(localPos);
+    updateVisibility();
+    m_isDirty = true;
 
     m_renderer.scheduleUpdate();
+    updateMemoryUsage();
 
     return block;
 }
@@ -140,7 +168,8 @@ uint32_t MapChunk::seed() const
 
 void MapChunk::updateBlockOnAdjacentBlockChanged(const ls::Vec3I& blockToUpdateMapPos, Block& changedBlock, const ls::Vec3I& changedBlockMapPos)
 {
-    at(blockToUpdateMapPos).block().onAdjacentBlockChanged(*m_map, blockToUpdateMapPos, changedBlock, changedBlockMapPos);
+    const ls::Vec3I localPos = mapToLocalPos(blockToUpdateMapPos);
+    m_blocks.block(localPos.x, localPos.y, localPos.z).onAdjacentBlockChanged(*m_map, blockToUpdateMapPos, changedBlock, changedBlockMapPos);
     updateOutsideOpacityOnAdjacentBlockChanged(blockToUpdateMapPos, changedBlock, changedBlockMapPos);
 
     m_renderer.scheduleUpdate();
@@ -148,25 +177,28 @@ void MapChunk::updateBlockOnAdjacentBlockChanged(const ls::Vec3I& blockToUpdateM
 
 void MapChunk::updateAllAsIfPlaced()
 {
+    const auto& registry = BlockTypeRegistry::instance();
+
+    // blocks without hooks would only make no-op calls
+    if (m_blocks.isUniform() && !registry.hasHooks(m_blocks.typeIdAt(0, 0, 0))) return;
+
     for (size_t x = 0; x < MapChunk::width(); ++x)
     {
         for (size_t y = 0; y < MapChunk::height(); ++y)
         {
             for (size_t z = 0; z < MapChunk::depth(); ++z)
             {
-                auto& block = m_blocks.at(x, y, z);
+                if (!registry.hasHooks(m_blocks.typeIdAt(x, y, z))) continue;
+
+                auto& block = m_blocks.block(x, y, z);
 
                 const ls::Vec3I pos = m_pos + ls::Vec3I(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z));
-                block.block().onBlockPlaced(*m_map, pos);
+                block.onBlockPlaced(*m_map, pos);
             }
         }
     }
 }
 
-BlockContainer& MapChunk::at(const ls::Vec3I& localPos)
-{
-    return m_blocks(localPos.x, localPos.y, localPos.z);
-}
 const BlockContainer& MapChunk::at(const ls::Vec3I& localPos) const
 {
     return m_blocks(localPos.x, localPos.y, localPos.z);
@@ -176,17 +208,41 @@ const ls::Sphere3F& MapChunk::boundingSphere() const
 {
     return m_boundingSphere;
 }
-void MapChunk::draw(float dt, int& numUpdatedChunksOnDraw)
+const ls::Box3I& MapChunk::occluderBox() const
+{
+    return m_occluderBox;
+}
+const MapChunkFaceConnectivity& MapChunk::faceConnectivity() const
 {
-    m_renderer.draw(*this, dt, numUpdatedChunksOnDraw);
+    return m_faceConnectivity;
+}
+void MapChunk::draw(float dt, MapChunkMeshUpdateBudget& budget, MapChunkMeshArena::DrawList& drawList)
+{
+    m_renderer.draw(*this, dt, budget, drawList);
+    updateMemoryUsage();
+}
+size_t MapChunk::numMeshVertices() const
+{
+    return m_renderer.numVertices();
+}
+const MapChunkMemoryUsage& MapChunk::memoryUsage() const
+{
+    return m_memoryUsage;
 }
 void MapChunk::tooFarToDraw(float dt)
 {
     m_renderer.tooFarToDraw(*this, dt);
+    updateMemoryUsage();
+}
+void MapChunk::culled(float dt, MapChunkMeshUpdateBudget& budget)
+{
+    m_renderer.culled(*this, dt, budget);
+    updateMemoryUsage();
 }
-void MapChunk::culled(float dt, int& numUpdatedChunksOnCull)
+void MapChunk::unreached(float dt)
 {
-    m_renderer.culled(*this, dt, numUpdatedChunksOnCull);
+    m_renderer.unreached(*this, dt);
+    updateMemoryUsage();
 }
 
 ls::Vec3I MapChunk::mapToLocalPos(const ls::Vec3I& mapPos) const
@@ -194,45 +250,305 @@ ls::Vec3I MapChunk::mapToLocalPos(const ls::Vec3I& mapPos) const
     return mapPos - firstBlockPosition();
 }
 
-ls::Sphere3F MapChunk::computeBoundingSphere()
+ls::Sphere3F MapChunk::computeBoundingSphere(const ls::Vec3I& pos)
 {
     static constexpr ls::Vec3F chunkSizeF(static_cast<float>(MapChunk::width()), static_cast<float>(MapChunk::height()), static_cast<float>(MapChunk::depth()));
 
     ls::Sphere3F sphere;
 
-    sphere.origin = (static_cast<ls::Vec3F>(m_pos) + ls::Vec3F(0.5f, 0.5f, 0.5f)) * chunkSizeF;
+    sphere.origin = (static_cast<ls::Vec3F>(pos) + ls::Vec3F(0.5f, 0.5f, 0.5f)) * chunkSizeF;
     sphere.radius = chunkSizeF.length() / 2.0f;
 
     return sphere;
 }
 
-const MapChunk::BlockArray& MapChunk::blocks() const
+std::array<uint32_t, MapChunk::m_width * MapChunk::m_height> MapChunk::computeSolidColumns() const
+{
+    std::array<uint32_t, m_width * m_height> solidColumns;
+
+    if (m_blocks.isUniform())
+    {
+        const BlockSideOpacity opacity = blockSideOpacity(m_blocks, 0, 0, 0);
+        bool isSolid = true;
+        for (const auto& side : CubeSide::values())
+        {
+            isSolid = isSolid && opacity[side];
+        }
+        solidColumns.fill(isSolid ? ~uint32_t(0) : 0u);
+        return solidColumns;
+    }
+
+    for (int x = 0; x < static_cast<int>(m_width); ++x)
+    {
+        for (int y = 0; y < static_cast<int>(m_height); ++y)
+        {
+            uint32_t solid = ~uint32_t(0);
+            for (const auto& side : CubeSide::values())
+            {
+                solid &= blockOpacityMask(m_blocks, m_blockOpacityMasks, side, x, y);
+            }
+            solidColumns[x * m_height + y] = solid;
+        }
+    }
+
+    return solidColumns;
+}
+
+ls::Box3I MapChunk::computeOccluderBox(const std::array<uint32_t, m_width * m_height>& solidColumns) const
+{
+    static constexpr int size = 32;
+    static constexpr uint32_t full = ~uint32_t(0);
+    static_assert(m_width == size && m_height == size && m_depth == size);
+
+    // a layer is solid when all its blocks are
+    std::array<bool, m_width> isLayerXSolid;
+    std::array<bool, m_height> isLayerYSolid;
+    isLayerXSolid.fill(true);
+    isLayerYSolid.fill(true);
+    uint32_t solidLayersZ = full;
+    for (int x = 0; x < size; ++x)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            const uint32_t solid = solidColumns[x * size + y];
+            solidLayersZ &= solid;
+            if (solid != full)
+            {
+                isLayerXSolid[x] = false;
+                isLayerYSolid[y] = false;
+            }
+        }
+    }
+
+    auto solidLayersFromStart = [](auto isSolid) { int n = 0; while (n < size && isSolid(n)) ++n; return n; };
+    auto solidLayersFromEnd = [](auto isSolid) { int n = 0; while (n < size && isSolid(size - 1 - n)) ++n; return n; };
+    auto isZSolid = [solidLayersZ](int z) { return ((solidLayersZ >> z) & 1u) != 0; };
+    auto isXSolid = [&isLayerXSolid](int x) { return isLayerXSolid[x]; };
+    auto isYSolid = [&isLayerYSolid](int y) { return isLayerYSolid[y]; };
+
+    const std::array<ls::Box3I, 6> boxes{
+        ls::Box3I({ 0, 0, 0 }, { solidLayersFromStart(isXSolid), size, size }),
+        ls::Box3I({ size - solidLayersFromEnd(isXSolid), 0, 0 }, { size, size, size }),
+        ls::Box3I({ 0, 0, 0 }, { size, solidLayersFromStart(isYSolid), size }),
+        ls::Box3I({ 0, size - solidLayersFromEnd(isYSolid), 0 }, { size, size, size }),
+        ls::Box3I({ 0, 0, 0 }, { size, size, solidLayersFromStart(isZSolid) }),
+        ls::Box3I({ 0, 0, size - solidLayersFromEnd(isZSolid) }, { size, size, size })
+    };
+
+    auto volume = [](const ls::Box3I& box) { const ls::Vec3I extent = box.max - box.min; return extent.x * extent.y * extent.z; };
+    const ls::Box3I& largest = *std::max_element(boxes.begin(), boxes.end(), [&volume](const ls::Box3I& lhs, const ls::Box3I& rhs) { return volume(lhs) < volume(rhs); });
+    return volume(largest) > 0 ? largest : ls::Box3I({ 0, 0, 0 }, { 0, 0, 0 });
+}
+
+MapChunkFaceConnectivity MapChunk::computeFaceConnectivity(const std::array<uint32_t, m_width * m_height>& solidColumns) const
+{
+    static constexpr int size = 32;
+    static constexpr int last = size - 1;
+
+    if (m_blocks.isUniform())
+    {
+        const BlockSideOpacity opacity = blockSideOpacity(m_blocks, 0, 0, 0);
+        int numOpaqueSides = 0;
+        for (const auto& side : CubeSide::values())
+        {
+            numOpaqueSides += opacity[side] ? 1 : 0;
+        }
+        if (numOpaqueSides == 0) return MapChunkFaceConnectivity::all();
+        if (numOpaqueSides == 6) return MapChunkFaceConnectivity::none();
+    }
+
+    auto opaque = [this](CubeSide side, int x, int y) { return blockOpacityMask(m_blocks, m_blockOpacityMasks, side, x, y); };
+
+    // blocks that are not solid can be seen through,
+    // as long as the sides between two of them are not opaque
+    std::array<uint32_t, m_width * m_height> open;
+    for (size_t i = 0; i < open.size(); ++i)
+    {
+        open[i] = ~solidColumns[i];
+    }
+
+    // a run of open blocks along z, seeds are grown to the whole run
+    struct Run
+    {
+        int x;
+        int y;
+        uint32_t seeds;
+    };
+
+    MapChunkFaceConnectivity connectivity = MapChunkFaceConnectivity::none();
+    std::vector<Run> pending;
+    for (int startX = 0; startX < size; ++startX)
+    {
+        for (int startY = 0; startY < size; ++startY)
+        {
+            uint32_t& startOpen = open[startX * size + startY];
+            while (startOpen != 0)
+            {
+                // open blocks are cleared once visited, each iteration is a new component
+                uint8_t faces = 0;
+                pending.push_back(Run{ startX, startY, startOpen & (~startOpen + 1u) });
+                while (!pending.empty())
+                {
+                    const Run current = pending.back();
+                    pending.pop_back();
+
+                    uint32_t& columnOpen = open[current.x * size + current.y];
+                    uint32_t run = current.seeds & columnOpen;
+                    if (run == 0) continue;
+
+                    // from z to z + 1, the same sides are crossed the other way
+                    const uint32_t towardsSouth = ~opaque(CubeSide::South, current.x, current.y) & ~(opaque(CubeSide::North, current.x, current.y) >> 1) & ~(uint32_t(1) << last);
+                    for (uint32_t previous = 0; previous != run;)
+                    {
+                        previous = run;
+                        run |= ((run & towardsSouth) << 1) | ((run >> 1) & towardsSouth);
+                        run &= columnOpen;
+                    }
+                    columnOpen &= ~run;
+
+                    auto reachesFace = [&](CubeSide side, uint32_t blocks) {
+                        if ((blocks & ~opaque(side, current.x, current.y)) != 0) faces |= uint8_t(1) << side.ordinal();
+                    };
+                    reachesFace(CubeSide::North, run & 1u);
+                    reachesFace(CubeSide::South, run & (uint32_t(1) << last));
+                    if (current.x == 0) reachesFace(CubeSide::West, run);
+                    if (current.x == last) reachesFace(CubeSide::East, run);
+                    if (current.y == 0) reachesFace(CubeSide::Bottom, run);
+                    if (current.y == last) reachesFace(CubeSide::Top, run);
+
+                    auto spread = [&](CubeSide side, int x, int y) {
+                        if (x < 0 || x > last || y < 0 || y > last) return;
+
+                        const uint32_t crossing = run & ~opaque(side, current.x, current.y) & ~opaque(side.opposite(), x, y) & open[x * size + y];
+                        if (crossing != 0) pending.push_back(Run{ x, y, crossing });
+                    };
+                    spread(CubeSide::East, current.x + 1, current.y);
+                    spread(CubeSide::West, current.x - 1, current.y);
+                    spread(CubeSide::Top, current.x, current.y + 1);
+                    spread(CubeSide::Bottom, current.x, current.y - 1);
+                }
+
+                connectivity.connectAll(faces);
+            }
+        }
+    }
+
+    return connectivity;
+}
+
+void MapChunk::updateVisibility()
+{
+    const std::array<uint32_t, m_width * m_height> solidColumns = computeSolidColumns();
+    m_occluderBox = computeOccluderBox(solidColumns);
+    m_faceConnectivity = computeFaceConnectivity(solidColumns);
+}
+
+MapChunkMemoryUsage MapChunk::computeMemoryUsage() const
+{
+    static constexpr size_t opacityMasksSize = sizeof(uint32_t) * 6 * m_width * m_height;
+
+    return MapChunkMemoryUsage{
+        m_blocks.memoryUsage(),
+        (m_blockOpacityMasks.isEmpty() ? 0 : opacityMasksSize) + sizeof(m_borderOpacity),
+        m_renderer.cpuMeshMemoryUsage(),
+        m_renderer.gpuMeshMemoryUsage()
+    };
+}
+void MapChunk::updateMemoryUsage()
+{
+    const MapChunkMemoryUsage usage = computeMemoryUsage();
+    if (usage == m_memoryUsage) return;
+
+    m_map->onChunkMemoryUsageChanged(m_pos, m_memoryUsage, usage);
+    m_memoryUsage = usage;
+}
+
+const MapChunkBlockStorage& MapChunk::blocks() const
 {
     return m_blocks;
 }
-const MapChunk::BlockSideOpacityArray& MapChunk::outsideOpacityCache() const
+BlockSideOpacity MapChunk::outsideOpacity(const ls::Vec3I& localPos) const
+{
+    return outsideOpacityAt(outsideOpacityRow(localPos.x, localPos.y), localPos.z);
+}
+MapChunk::OutsideOpacityRow MapChunk::outsideOpacityRow(int x, int y) const
+{
+    return computeOutsideOpacityRow(m_blocks, m_blockOpacityMasks, m_borderOpacity, x, y);
+}
+bool MapChunk::isUniform() const
+{
+    return m_blocks.isUniform();
+}
+bool MapChunk::isDirty() const
+{
+    return m_isDirty;
+}
+BlockSideOpacity MapChunk::outsideOpacityAt(const OutsideOpacityRow& row, int z)
+{
+    return BlockSideOpacity{
+        ((row[CubeSide::East] >> z) & 1u) != 0,
+        ((row[CubeSide::West] >> z) & 1u) != 0,
+        ((row[CubeSide::Top] >> z) & 1u) != 0,
+        ((row[CubeSide::Bottom] >> z) & 1u) != 0,
+        ((row[CubeSide::South] >> z) & 1u) != 0,
+        ((row[CubeSide::North] >> z) & 1u) != 0
+    };
+}
+void MapChunk::ensureBlockOpacityMasks()
 {
-    return m_outsideOpacityCache;
+    if (!m_blockOpacityMasks.isEmpty() || m_blocks.isUniform()) return;
+
+    m_blockOpacityMasks = MapChunkStorageReserve::instance().loadOpacityMasks();
+    updateBlockOpacityMasks();
 }
 void MapChunk::updateOutsideOpacity(const MapChunkNeighbours& neighbours)
 {
-    // do the interior now, borders later
-    ls::Array3<BlockSideOpacity> blockOpacityCache = createBlockOpacityCache();
+    // uniform chunks compute the masks on demand
+    if (!m_blockOpacityMasks.isEmpty())
+    {
+        updateBlockOpacityMasks();
+    }
 
-    for (size_t x = 0; x < MapChunk::width(); ++x)
+    updateOutsideOpacityOnChunkBorders(neighbours);
+}
+void MapChunk::updateBlockOpacityMasks()
+{
+    if (m_blockOpacityMasks.isEmpty()) return;
+
+    for (int x = 0; x < static_cast<int>(m_width); ++x)
     {
-        for (size_t y = 0; y < MapChunk::height(); ++y)
+        for (int y = 0; y < static_cast<int>(m_height); ++y)
         {
-            for (size_t z = 0; z < MapChunk::depth(); ++z)
+            std::array<uint32_t, 6> columnMasks{};
+
+            for (int z = 0; z < static_cast<int>(m_depth); ++z)
             {
-                const ls::Vec3I pos{ static_cast<int>(x), static_cast<int>(y), static_cast<int>(z) };
+                const BlockSideOpacity opacity = blockSideOpacity(m_blocks, x, y, z);
+
+                for (const auto& side : CubeSide::values())
+                {
+                    columnMasks[side.ordinal()] |= static_cast<uint32_t>(opacity[side]) << z;
+                }
+            }
 
-                m_outsideOpacityCache(x, y, z) = computeOutsideOpacity(pos, blockOpacityCache);
+            for (const auto& side : CubeSide::values())
+            {
+                m_blockOpacityMasks(side.ordinal(), x, y) = columnMasks[side.ordinal()];
             }
         }
     }
+}
+void MapChunk::updateBlockOpacityMask(const ls::Vec3I& localPos)
+{
+    if (m_blockOpacityMasks.isEmpty()) return;
 
-    updateOutsideOpacityOnChunkBorders(neighbours);
+    const BlockSideOpacity opacity = blockSideOpacity(m_blocks, localPos.x, localPos.y, localPos.z);
+    const uint32_t bit = uint32_t(1) << localPos.z;
+    for (const auto& side : CubeSide::values())
+    {
+        uint32_t& mask = m_blockOpacityMasks(side.ordinal(), localPos.x, localPos.y);
+        mask = opacity[side] ? (mask | bit) : (mask & ~bit);
+    }
 }
 void MapChunk::updateOutsideOpacityOnChunkBorders(const MapChunkNeighbours& neighbours)
 {
@@ -246,91 +562,127 @@ void MapChunk::updateOutsideOpacityOnChunkBorders(const MapChunkNeighbours& neig
 }
 void MapChunk::updateOutsideOpacityOnChunkBorder(const MapChunk& other, const ls::Vec3I& otherPos)
 {
+    static constexpr int last = 31;
+
     const ls::Vec3I diff = otherPos - m_pos;
     const auto dir = CubeSide::fromDirection(diff);
+    // the face of the other chunk's blocks that touches this chunk
+    const auto otherSide = dir.opposite();
 
-    // calculate bounding coords of a 16x16 plane of blocks
-    // on the side next to the other chunk
-    int minX = diff.x == 1 ? m_width - 1 : 0;
-    int minY = diff.y == 1 ? m_height - 1 : 0;
-    int minZ = diff.z == 1 ? m_depth - 1 : 0;
-
-    int maxX = std::abs(diff.x) == 1 ? minX : m_width - 1;
-    int maxY = std::abs(diff.y) == 1 ? minY : m_height - 1;
-    int maxZ = std::abs(diff.z) == 1 ? minZ : m_depth - 1;
+    auto otherMask = [&other, otherSide](int x, int y) { return blockOpacityMask(other.m_blocks, other.m_blockOpacityMasks, otherSide, x, y); };
 
-    for (int x = minX; x <= maxX; ++x)
+    auto& plane = m_borderOpacity[dir.ordinal()];
+    for (int i = 0; i <= last; ++i)
     {
-        for (int y = minY; y <= maxY; ++y)
+        switch (dir.ordinal())
         {
-            for (int z = minZ; z <= maxZ; ++z)
+        case CubeSide::East:
+            plane[i] = otherMask(0, i);
+            break;
+        case CubeSide::West:
+            plane[i] = otherMask(last, i);
+            break;
+        case CubeSide::Top:
+            plane[i] = otherMask(i, 0);
+            break;
+        case CubeSide::Bottom:
+            plane[i] = otherMask(i, last);
+            break;
+        default:
+        {
+            // only one block of each column touches this chunk
+            const int z = dir == CubeSide::South ? 0 : last;
+            uint32_t row = 0;
+            for (int y = 0; y <= last; ++y)
             {
-                const ls::Vec3I pos{ x, y, z };
-
-                // calculate position of a block next to this one but in the other chunk
-                // avoid modulo with negative number
-                const ls::Vec3I otherPos{ (pos.x + diff.x + m_width) % m_width, (pos.y + diff.y + m_height) % m_height, (pos.z + diff.z + m_depth) % m_depth };
-                auto& selfOpacity = m_outsideOpacityCache(x, y, z);
-                const auto& otherBlock = other.m_blocks(otherPos.x, otherPos.y, otherPos.z);
-                const auto otherOpacity = otherBlock.block().sideOpacity();
-                selfOpacity[dir] = otherOpacity[dir.opposite()];
+                row |= ((otherMask(i, y) >> z) & 1u) << y;
             }
+            plane[i] = row;
+            break;
+        }
         }
     }
 }
 void MapChunk::updateOutsideOpacityOnAdjacentBlockChanged(const ls::Vec3I& blockToUpdateMapPos, Block& changedBlock, const ls::Vec3I& changedBlockMapPos)
 {
+    // changes inside the chunk are already in the block masks
     const ls::Vec3I localPos = mapToLocalPos(blockToUpdateMapPos);
-    auto& selfOpacity = m_outsideOpacityCache(localPos.x, localPos.y, localPos.z);
-    const auto otherOpacity = changedBlock.sideOpacity();
     const ls::Vec3I diff = changedBlockMapPos - blockToUpdateMapPos;
+    const ls::Vec3I changedLocalPos = localPos + diff;
+    const bool isChangedInOtherChunk =
+        changedLocalPos.x < 0 || changedLocalPos.x >= static_cast<int>(m_width)
+        || changedLocalPos.y < 0 || changedLocalPos.y >= static_cast<int>(m_height)
+        || changedLocalPos.z < 0 || changedLocalPos.z >= static_cast<int>(m_depth);
+    if (!isChangedInOtherChunk) return;
+
     const auto dir = CubeSide::fromDirection(diff);
-    selfOpacity[dir] = otherOpacity[dir.opposite()];
-}
-BlockSideOpacity MapChunk::computeOutsideOpacity(ls::Vec3I blockPos, const ls::Array3<BlockSideOpacity>& cache)
-{
-    blockPos += ls::Vec3I(1, 1, 1); // because cache is offseted
-    const ls::Vec3I eastPos = blockPos + CubeSide::makeEast().direction();
-    const ls::Vec3I westPos = blockPos + CubeSide::makeWest().direction();
-    const ls::Vec3I topPos = blockPos + CubeSide::makeTop().direction();
-    const ls::Vec3I bottomPos = blockPos + CubeSide::makeBottom().direction();
-    const ls::Vec3I southPos = blockPos + CubeSide::makeSouth().direction();
-    const ls::Vec3I northPos = blockPos + CubeSide::makeNorth().direction();
-
-    auto eastBlockOpacity = cache(eastPos.x, eastPos.y, eastPos.z);
-    auto westBlockOpacity = cache(westPos.x, westPos.y, westPos.z);
-    auto topBlockOpacity = cache(topPos.x, topPos.y, topPos.z);
-    auto bottomBlockOpacity = cache(bottomPos.x, bottomPos.y, bottomPos.z);
-    auto southBlockOpacity = cache(southPos.x, southPos.y, southPos.z);
-    auto northBlockOpacity = cache(northPos.x, northPos.y, northPos.z);
-
-    // we are interested from outside view on opacities
-    // so the sides are switched
-    return BlockSideOpacity{
-        eastBlockOpacity[CubeSide::West],
-        westBlockOpacity[CubeSide::East],
-        topBlockOpacity[CubeSide::Bottom],
-        bottomBlockOpacity[CubeSide::Top],
-        southBlockOpacity[CubeSide::North],
-        northBlockOpacity[CubeSide::South]
-    };
+    const bool isOpaque = changedBlock.sideOpacity()[dir.opposite()];
+    const ls::Vec2I rowAndBit = borderOpacityRowAndBit(dir, localPos);
+    uint32_t& row = m_borderOpacity[dir.ordinal()][rowAndBit.x];
+    const uint32_t bit = uint32_t(1) << rowAndBit.y;
+    row = isOpaque ? (row | bit) : (row & ~bit);
 }
-ls::Array3<BlockSideOpacity> MapChunk::createBlockOpacityCache()
+ls::Vec2I MapChunk::borderOpacityRowAndBit(CubeSide side, const ls::Vec3I& localPos)
 {
-    ls::Array3<BlockSideOpacity> cache(m_width + 2, m_height + 2, m_depth + 2, BlockSideOpacity::all());
-
-    for (int x = 1; x < m_width + 1; ++x)
+    // coordinates along the plane of the side
+    switch (side.ordinal())
     {
-        for (int y = 1; y < m_height + 1; ++y)
-        {
-            for (int z = 1; z < m_depth + 1; ++z)
-            {
-                const auto& block = m_blocks.at(x - 1, y - 1, z - 1);
+    case CubeSide::East:
+    case CubeSide::West:
+        return { localPos.y, localPos.z };
+    case CubeSide::Top:
+    case CubeSide::Bottom:
+        return { localPos.x, localPos.z };
+    default:
+        return { localPos.x, localPos.y };
+    }
+}
+std::array<MapChunk::BorderOpacityPlane, 6> MapChunk::createOpaqueBorderOpacity()
+{
+    // no adjacent chunk is treated as opaque
+    std::array<BorderOpacityPlane, 6> planes;
+    for (auto& plane : planes)
+    {
+        plane.fill(~uint32_t(0));
+    }
 
-                cache(x, y, z) = block.block().sideOpacity();
-            }
-        }
+    return planes;
+}
+uint32_t MapChunk::blockOpacityMask(const MapChunkBlockStorage& blocks, const BlockOpacityMaskArray& masks, CubeSide side, int x, int y)
+{
+    if (!masks.isEmpty())
+    {
+        return masks(side.ordinal(), x, y);
     }
 
-    return cache;
-}
\ No newline at end of file
+    const bool isOpaque = blockSideOpacity(blocks, 0, 0, 0)[side];
+    return isOpaque ? ~uint32_t(0) : 0u;
+}
+BlockSideOpacity MapChunk::blockSideOpacity(const MapChunkBlockStorage& blocks, int x, int y, int z)
+{
+    const auto& block = blocks.at(x, y, z);
+    const auto& registry = BlockTypeRegistry::instance();
+
+    // only stateful blocks can differ from the other blocks of their type
+    if (registry.isStateful(block.typeId())) return block.block().sideOpacity();
+
+    return registry.sideOpacity(block.typeId());
+}
+MapChunk::OutsideOpacityRow MapChunk::computeOutsideOpacityRow(const MapChunkBlockStorage& blocks, const BlockOpacityMaskArray& masks, const std::array<BorderOpacityPlane, 6>& borderOpacity, int x, int y)
+{
+    static constexpr int last = 31;
+
+    auto blockMask = [&blocks, &masks](CubeSide side, int bx, int by) { return blockOpacityMask(blocks, masks, side, bx, by); };
+
+    // a side is covered when the face of the neighbour that touches it is opaque,
+    // neighbours along z are in the same column so only a shift is needed
+    OutsideOpacityRow row;
+    row[CubeSide::East] = x < last ? blockMask(CubeSide::West, x + 1, y) : borderOpacity[CubeSide::East][y];
+    row[CubeSide::West] = x > 0 ? blockMask(CubeSide::East, x - 1, y) : borderOpacity[CubeSide::West][y];
+    row[CubeSide::Top] = y < last ? blockMask(CubeSide::Bottom, x, y + 1) : borderOpacity[CubeSide::Top][x];
+    row[CubeSide::Bottom] = y > 0 ? blockMask(CubeSide::Top, x, y - 1) : borderOpacity[CubeSide::Bottom][x];
+    row[CubeSide::South] = (blockMask(CubeSide::North, x, y) >> 1) | (((borderOpacity[CubeSide::South][x] >> y) & 1u) << last);
+    row[CubeSide::North] = (blockMask(CubeSide::South, x, y) << 1) | ((borderOpacity[CubeSide::North][x] >> y) & 1u);
+
+    return row;
+}
@@ -0,0 +1,243 @@
+#include "map/MapChunkBlockStorage.h"
+
+#include "block/Block.h"
+
+#include <utility>
+#include <algorithm>
+
+MapChunkBlockStorage::MapChunkBlockStorage() :
+    m_indices(),
+    m_palette(1),
+    m_statefulPaletteIndex(m_noPaletteIndex),
+    m_bitsPerBlockLog2(-1)
+{
+}
+
+MapChunkBlockStorage MapChunkBlockStorage::clone() const
+{
+    return MapChunkBlockStorage(*this);
+}
+
+const BlockContainer& MapChunkBlockStorage::operator()(size_t x, size_t y, size_t z) const
+{
+    return at(x, y, z);
+}
+const BlockContainer& MapChunkBlockStorage::at(size_t x, size_t y, size_t z) const
+{
+    const size_t i = index(x, y, z);
+    const uint32_t paletteIndex = paletteIndexAt(i);
+    if (paletteIndex == m_statefulPaletteIndex)
+    {
+        return m_statefulBlocks.find(static_cast<uint16_t>(i))->second;
+    }
+
+    return m_palette[paletteIndex];
+}
+
+BlockTypeId MapChunkBlockStorage::typeIdAt(size_t x, size_t y, size_t z) const
+{
+    return at(x, y, z).typeId();
+}
+
+Block& MapChunkBlockStorage::block(size_t x, size_t y, size_t z)
+{
+    const size_t i = index(x, y, z);
+    const uint32_t paletteIndex = paletteIndexAt(i);
+    if (paletteIndex == m_statefulPaletteIndex)
+    {
+        return m_statefulBlocks.find(static_cast<uint16_t>(i))->second.block();
+    }
+
+    return m_palette[paletteIndex].block();
+}
+
+void MapChunkBlockStorage::set(size_t x, size_t y, size_t z, BlockContainer&& block)
+{
+    exchange(x, y, z, std::move(block));
+}
+
+BlockContainer MapChunkBlockStorage::exchange(size_t x, size_t y, size_t z, BlockContainer&& block)
+{
+    const size_t i = index(x, y, z);
+    const uint16_t key = static_cast<uint16_t>(i);
+
+    BlockContainer previous;
+    const uint32_t previousPaletteIndex = paletteIndexAt(i);
+    if (previousPaletteIndex == m_statefulPaletteIndex)
+    {
+        auto iter = m_statefulBlocks.find(key);
+        previous = std::move(iter->second);
+        m_statefulBlocks.erase(iter);
+    }
+    else
+    {
+        previous = m_palette[previousPaletteIndex];
+    }
+
+    if (block.isStateful())
+    {
+        setPaletteIndexAt(i, statefulPaletteIndex());
+        m_statefulBlocks.insert_or_assign(key, std::move(block));
+    }
+    else
+    {
+        setPaletteIndexAt(i, findOrAddPaletteEntry(block));
+    }
+
+    return previous;
+}
+
+void MapChunkBlockStorage::fill(BlockContainer&& block)
+{
+    m_indices.clear();
+    m_indices.shrink_to_fit();
+    m_statefulBlocks.clear();
+    m_statefulPaletteIndex = m_noPaletteIndex;
+    m_bitsPerBlockLog2 = -1;
+
+    m_palette.clear();
+    m_palette.emplace_back(std::move(block));
+}
+
+bool MapChunkBlockStorage::isUniform() const
+{
+    return m_bitsPerBlockLog2 < 0;
+}
+
+int MapChunkBlockStorage::bitsPerBlock() const
+{
+    if (isUniform()) return 0;
+
+    return 1 << m_bitsPerBlockLog2;
+}
+size_t MapChunkBlockStorage::paletteSize() const
+{
+    return m_palette.size();
+}
+
+size_t MapChunkBlockStorage::memoryUsage() const
+{
+    return
+        sizeof(MapChunkBlockStorage)
+        + m_indices.capacity() * sizeof(uint64_t)
+        + m_palette.capacity() * sizeof(BlockContainer)
+        + m_statefulBlocks.size() * (sizeof(uint16_t) + sizeof(BlockContainer) + sizeof(void*) * 2);
+}
+
+size_t MapChunkBlockStorage::index(size_t x, size_t y, size_t z)
+{
+    return x * (depth * height) + y * depth + z;
+}
+
+uint32_t MapChunkBlockStorage::paletteIndexAt(size_t i) const
+{
+    if (isUniform()) return 0;
+
+    // bits per block are powers of two so an index never straddles two words
+    const int bitsLog2 = m_bitsPerBlockLog2;
+    const size_t word = i >> (6 - bitsLog2);
+    const size_t shift = (i << bitsLog2) & 63u;
+    const uint64_t mask = (uint64_t(1) << (1 << bitsLog2)) - 1u;
+
+    return static_cast<uint32_t>((m_indices[word] >> shift) & mask);
+}
+void MapChunkBlockStorage::setPaletteIndexAt(size_t i, uint32_t paletteIndex)
+{
+    // uniform storage only has index 0
+    if (isUniform()) return;
+
+    const int bitsLog2 = m_bitsPerBlockLog2;
+    const size_t word = i >> (6 - bitsLog2);
+    const size_t shift = (i << bitsLog2) & 63u;
+    const uint64_t mask = (uint64_t(1) << (1 << bitsLog2)) - 1u;
+
+    m_indices[word] = (m_indices[word] & ~(mask << shift)) | (static_cast<uint64_t>(paletteIndex) << shift);
+}
+
+uint32_t MapChunkBlockStorage::findOrAddPaletteEntry(const BlockContainer& block)
+{
+    const uint32_t paletteSize = static_cast<uint32_t>(m_palette.size());
+    for (uint32_t i = 0; i < paletteSize; ++i)
+    {
+        if (i == m_statefulPaletteIndex) continue;
+
+        if (isSameStatelessBlock(m_palette[i], block)) return i;
+    }
+
+    return addPaletteEntry(BlockContainer(block));
+}
+uint32_t MapChunkBlockStorage::statefulPaletteIndex()
+{
+    if (m_statefulPaletteIndex == m_noPaletteIndex)
+    {
+        m_statefulPaletteIndex = addPaletteEntry(BlockContainer());
+    }
+
+    return m_statefulPaletteIndex;
+}
+uint32_t MapChunkBlockStorage::addPaletteEntry(BlockContainer&& block)
+{
+    // try to reuse entries of blocks that were overwritten before widening the indices
+    if (!isUniform() && m_palette.size() >= (size_t(1) << bitsPerBlock()))
+    {
+        compactPalette();
+    }
+    if (m_palette.size() >= (size_t(1) << bitsPerBlock()))
+    {
+        repack(m_bitsPerBlockLog2 + 1);
+    }
+
+    m_palette.emplace_back(std::move(block));
+    return static_cast<uint32_t>(m_palette.size() - 1);
+}
+void MapChunkBlockStorage::compactPalette()
+{
+    std::vector<uint32_t> remap(m_palette.size(), m_noPaletteIndex);
+    for (size_t i = 0; i < size; ++i)
+    {
+        remap[paletteIndexAt(i)] = 0u;
+    }
+
+    const size_t numUsedEntries = static_cast<size_t>(std::count(remap.begin(), remap.end(), 0u));
+    if (numUsedEntries == m_palette.size()) return;
+
+    std::vector<BlockContainer> palette;
+    palette.reserve(m_palette.size());
+    for (size_t i = 0; i < m_palette.size(); ++i)
+    {
+        if (remap[i] != m_noPaletteIndex)
+        {
+            remap[i] = static_cast<uint32_t>(palette.size());
+            palette.emplace_back(std::move(m_palette[i]));
+        }
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        setPaletteIndexAt(i, remap[paletteIndexAt(i)]);
+    }
+    if (m_statefulPaletteIndex != m_noPaletteIndex)
+    {
+        m_statefulPaletteIndex = remap[m_statefulPaletteIndex];
+    }
+
+    m_palette = std::move(palette);
+}
+void MapChunkBlockStorage::repack(int newBitsPerBlockLog2)
+{
+    std::vector<uint64_t> indices(size >> (6 - newBitsPerBlockLog2), 0u);
+    for (size_t i = 0; i < size; ++i)
+    {
+        const uint64_t paletteIndex = paletteIndexAt(i);
+        indices[i >> (6 - newBitsPerBlockLog2)] |= paletteIndex << ((i << newBitsPerBlockLog2) & 63u);
+    }
+
+    m_indices = std::move(indices);
+    m_bitsPerBlockLog2 = newBitsPerBlockLog2;
+}
+
+bool MapChunkBlockStorage::isSameStatelessBlock(const BlockContainer& lhs, const BlockContainer& rhs)
+{
+    // there is a single instance of each stateless type
+    return lhs.typeId() == rhs.typeId();
+}
@@ -0,0 +1,267 @@
+#include "map/MapChunkIndex.h"
+
+#include <utility>
+
+MapChunkIndex::MapChunkIndex() :
+    m_grid(m_windowWidth * m_windowHeight * m_windowWidth, m_emptyIndex),
+    m_hash(m_initialHashCapacity, HashEntry{ ls::Vec3I(0, 0, 0), m_emptyIndex }),
+    m_hashSize(0),
+    m_center(0, 0, 0)
+{
+}
+
+void MapChunkIndex::recenter(const ls::Vec3I& center)
+{
+    if (center == m_center) return;
+
+    const ls::Vec3I oldCenter = m_center;
+
+    // first take out everything that leaves the window
+    // so the grid slots are free for the chunks that enter it
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        const ls::Vec3I& pos = m_chunks[i].pos();
+        if (isInWindow(pos, oldCenter) && !isInWindow(pos, center))
+        {
+            m_grid[gridSlot(pos)] = m_emptyIndex;
+            hashSet(pos, static_cast<int32_t>(i));
+        }
+    }
+
+    m_center = center;
+
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        const ls::Vec3I& pos = m_chunks[i].pos();
+        if (!isInWindow(pos, oldCenter) && isInWindow(pos, center))
+        {
+            hashRemove(pos);
+            m_grid[gridSlot(pos)] = static_cast<int32_t>(i);
+        }
+    }
+}
+
+MapChunk* MapChunkIndex::find(const ls::Vec3I& pos)
+{
+    const int32_t index = findIndex(pos);
+    if (index == m_emptyIndex) return nullptr;
+
+    return &(m_chunks[index]);
+}
+const MapChunk* MapChunkIndex::find(const ls::Vec3I& pos) const
+{
+    const int32_t index = findIndex(pos);
+    if (index == m_emptyIndex) return nullptr;
+
+    return &(m_chunks[index]);
+}
+bool MapChunkIndex::contains(const ls::Vec3I& pos) const
+{
+    return findIndex(pos) != m_emptyIndex;
+}
+
+MapChunk& MapChunkIndex::emplace(MapChunk&& chunk)
+{
+    const int32_t index = static_cast<int32_t>(m_chunks.size());
+    m_chunks.emplace_back(std::move(chunk));
+
+    MapChunk& placedChunk = m_chunks.back();
+    m_boundingSpheres.push_back(placedChunk.boundingSphere());
+    setIndex(placedChunk.pos(), index);
+
+    return placedChunk;
+}
+
+MapChunkIndex::iterator MapChunkIndex::erase(iterator iter)
+{
+    const size_t index = static_cast<size_t>(iter - m_chunks.begin());
+    const size_t lastIndex = m_chunks.size() - 1;
+
+    removeIndex(m_chunks[index].pos());
+    if (index != lastIndex)
+    {
+        // swap instead of move assignment, so the erased chunk is destroyed
+        // at the back and gives its storage back to the reserve
+        std::swap(m_chunks[index], m_chunks[lastIndex]);
+        m_boundingSpheres.set(index, m_boundingSpheres[lastIndex]);
+        setIndex(m_chunks[index].pos(), static_cast<int32_t>(index));
+    }
+    m_chunks.pop_back();
+    m_boundingSpheres.pop_back();
+
+    return m_chunks.begin() + index;
+}
+
+size_t MapChunkIndex::size() const
+{
+    return m_chunks.size();
+}
+bool MapChunkIndex::isEmpty() const
+{
+    return m_chunks.empty();
+}
+
+const ls::SphereArray3F& MapChunkIndex::boundingSpheres() const
+{
+    return m_boundingSpheres;
+}
+
+MapChunkIndex::iterator MapChunkIndex::begin()
+{
+    return m_chunks.begin();
+}
+MapChunkIndex::iterator MapChunkIndex::end()
+{
+    return m_chunks.end();
+}
+MapChunkIndex::const_iterator MapChunkIndex::begin() const
+{
+    return m_chunks.begin();
+}
+MapChunkIndex::const_iterator MapChunkIndex::end() const
+{
+    return m_chunks.end();
+}
+
+bool MapChunkIndex::isInWindow(const ls::Vec3I& pos) const
+{
+    return isInWindow(pos, m_center);
+}
+bool MapChunkIndex::isInWindow(const ls::Vec3I& pos, const ls::Vec3I& center)
+{
+    const ls::Vec3I diff = pos - center;
+
+    return
+        diff.x >= -m_windowWidth / 2 && diff.x < m_windowWidth / 2
+        && diff.y >= -m_windowHeight / 2 && diff.y < m_windowHeight / 2
+        && diff.z >= -m_windowWidth / 2 && diff.z < m_windowWidth / 2;
+}
+size_t MapChunkIndex::gridSlot(const ls::Vec3I& pos)
+{
+    // two's complement masking wraps negative coordinates around as well
+    const size_t x = static_cast<size_t>(pos.x & (m_windowWidth - 1));
+    const size_t y = static_cast<size_t>(pos.y & (m_windowHeight - 1));
+    const size_t z = static_cast<size_t>(pos.z & (m_windowWidth - 1));
+
+    return (((x << m_windowHeightLog2) | y) << m_windowWidthLog2) | z;
+}
+
+int32_t MapChunkIndex::findIndex(const ls::Vec3I& pos) const
+{
+    if (isInWindow(pos))
+    {
+        return m_grid[gridSlot(pos)];
+    }
+
+    return hashFind(pos);
+}
+void MapChunkIndex::setIndex(const ls::Vec3I& pos, int32_t index)
+{
+    if (isInWindow(pos))
+    {
+        m_grid[gridSlot(pos)] = index;
+    }
+    else
+    {
+        hashSet(pos, index);
+    }
+}
+void MapChunkIndex::removeIndex(const ls::Vec3I& pos)
+{
+    if (isInWindow(pos))
+    {
+        m_grid[gridSlot(pos)] = m_emptyIndex;
+    }
+    else
+    {
+        hashRemove(pos);
+    }
+}
+
+size_t MapChunkIndex::hashSlot(const ls::Vec3I& pos) const
+{
+    uint32_t h = static_cast<uint32_t>(pos.x) * 0x8da6b343u;
+    h ^= static_cast<uint32_t>(pos.y) * 0xd8163841u;
+    h ^= static_cast<uint32_t>(pos.z) * 0xcb1ab31fu;
+    h ^= h >> 16;
+
+    return static_cast<size_t>(h) & (m_hash.size() - 1);
+}
+int32_t MapChunkIndex::hashFind(const ls::Vec3I& pos) const
+{
+    const size_t mask = m_hash.size() - 1;
+    for (size_t slot = hashSlot(pos);; slot = (slot + 1) & mask)
+    {
+        const HashEntry& entry = m_hash[slot];
+        if (entry.index == m_emptyIndex) return m_emptyIndex;
+        if (entry.pos == pos) return entry.index;
+    }
+}
+void MapChunkIndex::hashSet(const ls::Vec3I& pos, int32_t index)
+{
+    // keep load factor at most 1/2 so probe sequences stay short
+    if ((m_hashSize + 1) * 2 > m_hash.size()) hashGrow();
+
+    const size_t mask = m_hash.size() - 1;
+    for (size_t slot = hashSlot(pos);; slot = (slot + 1) & mask)
+    {
+        HashEntry& entry = m_hash[slot];
+        if (entry.index == m_emptyIndex)
+        {
+            entry.pos = pos;
+            entry.index = index;
+            ++m_hashSize;
+            return;
+        }
+        if (entry.pos == pos)
+        {
+            entry.index = index;
+            return;
+        }
+    }
+}
+void MapChunkIndex::hashRemove(const ls::Vec3I& pos)
+{
+    const size_t mask = m_hash.size() - 1;
+    size_t slot = hashSlot(pos);
+    for (;; slot = (slot + 1) & mask)
+    {
+        const HashEntry& entry = m_hash[slot];
+        if (entry.index == m_emptyIndex) return;
+        if (entry.pos == pos) break;
+    }
+
+    // backward shift deletion, so no tombstones are needed
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask;; next = (next + 1) & mask)
+    {
+        const HashEntry& entry = m_hash[next];
+        if (entry.index == m_emptyIndex) break;
+
+        const size_t home = hashSlot(entry.pos);
+        // move entry into the hole only if its home slot does not lie cyclically in (hole, next]
+        const bool isHomeBetween = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!isHomeBetween)
+        {
+            m_hash[hole] = entry;
+            hole = next;
+        }
+    }
+
+    m_hash[hole].index = m_emptyIndex;
+    --m_hashSize;
+}
+void MapChunkIndex::hashGrow()
+{
+    std::vector<HashEntry> oldHash(m_hash.size() * 2, HashEntry{ ls::Vec3I(0, 0, 0), m_emptyIndex });
+    oldHash.swap(m_hash);
+    m_hashSize = 0;
+
+    for (const auto& entry : oldHash)
+    {
+        if (entry.index != m_emptyIndex)
+        {
+            hashSet(entry.pos, entry.index);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#include "map/MapChunkLoadQueue.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+MapChunkLoadQueue::MapChunkLoadQueue(int range, int minChunkY, int maxChunkY) :
+    m_range(range),
+    m_minChunkY(minChunkY),
+    m_maxChunkY(maxChunkY),
+    m_origin(0, 0, 0),
+    m_hasOrigin(false)
+{
+}
+
+void MapChunkLoadQueue::setOrigin(const ls::Vec3I& origin)
+{
+    if (m_hasOrigin && origin == m_origin) return;
+
+    ls::Vec3I min;
+    ls::Vec3I max;
+    rangeBounds(origin, min, max);
+
+    const bool hadOrigin = m_hasOrigin;
+    const ls::Vec3I previousOrigin = m_origin;
+    m_origin = origin;
+    m_hasOrigin = true;
+
+    if (!hadOrigin)
+    {
+        pushBox(min, max);
+        return;
+    }
+
+    // the new positions lie in slabs along the axes the origin moved along,
+    // each slab leaves out what the previous ones covered, so nothing is added twice
+    ls::Vec3I previousMin;
+    ls::Vec3I previousMax;
+    rangeBounds(previousOrigin, previousMin, previousMax);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (origin[axis] == previousOrigin[axis]) continue;
+
+        ls::Vec3I slabMin = min;
+        ls::Vec3I slabMax = max;
+        if (origin[axis] > previousOrigin[axis]) slabMin[axis] = std::max(min[axis], previousMax[axis] + 1);
+        else slabMax[axis] = std::min(max[axis], previousMin[axis] - 1);
+        pushBox(slabMin, slabMax);
+
+        min[axis] = std::max(min[axis], previousMin[axis]);
+        max[axis] = std::min(max[axis], previousMax[axis]);
+    }
+}
+
+void MapChunkLoadQueue::push(const ls::Vec3I& pos)
+{
+    if (!m_hasOrigin || !isInRange(pos)) return;
+
+    pushEntry(pos);
+}
+
+bool MapChunkLoadQueue::pop(ls::Vec3I& pos)
+{
+    while (!m_heap.empty())
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), isFartherThan);
+        const Entry entry = m_heap.back();
+        m_heap.pop_back();
+
+        if (!isInRange(entry.pos)) continue;
+
+        // the origin moved away since it was added, it goes back with the right priority
+        if (priority(entry.pos - m_origin) > entry.priority)
+        {
+            pushEntry(entry.pos);
+            continue;
+        }
+
+        pos = entry.pos;
+        return true;
+    }
+
+    return false;
+}
+
+void MapChunkLoadQueue::rekey()
+{
+    auto newEnd = std::remove_if(m_heap.begin(), m_heap.end(), [this](const Entry& entry) { return !isInRange(entry.pos); });
+    m_heap.erase(newEnd, m_heap.end());
+
+    for (auto& entry : m_heap)
+    {
+        entry.priority = priority(entry.pos - m_origin);
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), isFartherThan);
+}
+
+size_t MapChunkLoadQueue::size() const
+{
+    return m_heap.size();
+}
+
+int MapChunkLoadQueue::priority(const ls::Vec3I& offset)
+{
+    return std::abs(offset.x) + std::abs(offset.y * 2) + std::abs(offset.z); // value horizontal directions more
+}
+
+bool MapChunkLoadQueue::isInRange(const ls::Vec3I& pos) const
+{
+    if (pos.y < m_minChunkY || pos.y > m_maxChunkY) return false;
+
+    const ls::Vec3I diff = pos - m_origin;
+    return std::abs(diff.x) <= m_range && std::abs(diff.y) <= m_range && std::abs(diff.z) <= m_range;
+}
+
+void MapChunkLoadQueue::rangeBounds(const ls::Vec3I& origin, ls::Vec3I& min, ls::Vec3I& max) const
+{
+    min = ls::Vec3I(origin.x - m_range, std::max(m_minChunkY, origin.y - m_range), origin.z - m_range);
+    max = ls::Vec3I(origin.x + m_range, std::min(m_maxChunkY, origin.y + m_range), origin.z + m_range);
+}
+
+void MapChunkLoadQueue::pushBox(const ls::Vec3I& min, const ls::Vec3I& max)
+{
+    for (int x = min.x; x <= max.x; ++x)
+    {
+        for (int y = min.y; y <= max.y; ++y)
+        {
+            for (int z = min.z; z <= max.z; ++z)
+            {
+                pushEntry(ls::Vec3I(x, y, z));
+            }
+        }
+    }
+}
+
+void MapChunkLoadQueue::pushEntry(const ls::Vec3I& pos)
+{
+    m_heap.push_back(Entry{ priority(pos - m_origin), pos });
+    std::push_heap(m_heap.begin(), m_heap.end(), isFartherThan);
+}
+
+bool MapChunkLoadQueue::isFartherThan(const Entry& lhs, const Entry& rhs)
+{
+    return lhs.priority > rhs.priority;
+}
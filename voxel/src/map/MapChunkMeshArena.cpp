@@ -0,0 +1,440 @@
+#include "map/MapChunkMeshArena.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+double MapChunkMeshArena::RangeAllocator::Stats::fragmentation() const
+{
+    const size_t numFree = capacity - numUsed;
+    if (numFree == 0) return 0.0;
+
+    return 1.0 - static_cast<double>(largestFreeRange) / static_cast<double>(numFree);
+}
+
+MapChunkMeshArena::RangeAllocator::RangeAllocator(size_t capacity, size_t granularity) :
+    m_capacity(capacity),
+    m_granularity(granularity),
+    m_numUsed(0),
+    m_numAllocations(0)
+{
+    insertFreeRange(0, capacity);
+}
+
+bool MapChunkMeshArena::RangeAllocator::allocate(size_t size, Range& range)
+{
+    const size_t roundedSize = std::max((size + m_granularity - 1) / m_granularity, size_t(1)) * m_granularity;
+
+    // smallest free range that fits, the lowest offset among equal ones
+    auto bestFit = m_freeRangesBySize.lower_bound({ roundedSize, 0 });
+    if (bestFit == m_freeRangesBySize.end()) return false;
+
+    const size_t freeOffset = bestFit->second;
+    const size_t freeSize = bestFit->first;
+    eraseFreeRange(m_freeRangesByOffset.find(freeOffset));
+    if (freeSize > roundedSize)
+    {
+        insertFreeRange(freeOffset + roundedSize, freeSize - roundedSize);
+    }
+
+    range = Range{ freeOffset, roundedSize };
+    m_numUsed += roundedSize;
+    ++m_numAllocations;
+
+    return true;
+}
+void MapChunkMeshArena::RangeAllocator::free(const Range& range)
+{
+    size_t offset = range.offset;
+    size_t size = range.size;
+
+    // merged with the adjacent free ranges
+    auto next = m_freeRangesByOffset.lower_bound(offset);
+    if (next != m_freeRangesByOffset.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = std::next(next);
+        eraseFreeRange(std::prev(next));
+    }
+    if (next != m_freeRangesByOffset.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            eraseFreeRange(prev);
+        }
+    }
+    insertFreeRange(offset, size);
+
+    m_numUsed -= range.size;
+    --m_numAllocations;
+}
+
+bool MapChunkMeshArena::RangeAllocator::isEmpty() const
+{
+    return m_numAllocations == 0;
+}
+MapChunkMeshArena::RangeAllocator::Stats MapChunkMeshArena::RangeAllocator::stats() const
+{
+    const size_t largestFreeRange = m_freeRangesBySize.empty() ? 0 : m_freeRangesBySize.rbegin()->first;
+
+    return Stats{ m_capacity, m_numUsed, m_numAllocations, m_freeRangesByOffset.size(), largestFreeRange };
+}
+
+void MapChunkMeshArena::RangeAllocator::insertFreeRange(size_t offset, size_t size)
+{
+    m_freeRangesByOffset.emplace(offset, size);
+    m_freeRangesBySize.emplace(size, offset);
+}
+void MapChunkMeshArena::RangeAllocator::eraseFreeRange(std::map<size_t, size_t>::iterator iter)
+{
+    m_freeRangesBySize.erase({ iter->second, iter->first });
+    m_freeRangesByOffset.erase(iter);
+}
+
+MapChunkMeshArena::Allocation MapChunkMeshArena::Allocation::makeInvalid()
+{
+    return Allocation{ invalidPage, { 0, 0 }, { 0, 0 }, 0, 0 };
+}
+bool MapChunkMeshArena::Allocation::isValid() const
+{
+    return page != invalidPage;
+}
+size_t MapChunkMeshArena::Allocation::sizeInBytes() const
+{
+    return vertices.size * sizeof(BlockVertex) + indices.size * sizeof(uint32_t);
+}
+
+MapChunkMeshArena::Allocation MapChunkMeshArena::PageAllocator::allocate(size_t numVertices, size_t numIndices)
+{
+    Allocation allocation = Allocation::makeInvalid();
+
+    for (size_t i = 0; i < m_pages.size(); ++i)
+    {
+        if (m_pages[i] == nullptr) continue;
+
+        Page& page = *m_pages[i];
+        if (!page.vertices.allocate(numVertices, allocation.vertices)) continue;
+        if (!page.indices.allocate(numIndices, allocation.indices))
+        {
+            page.vertices.free(allocation.vertices);
+            continue;
+        }
+
+        allocation.page = i;
+        return allocation;
+    }
+
+    allocation.page = createPage(numVertices, numIndices);
+    Page& page = *m_pages[allocation.page];
+    page.vertices.allocate(numVertices, allocation.vertices);
+    page.indices.allocate(numIndices, allocation.indices);
+
+    return allocation;
+}
+bool MapChunkMeshArena::PageAllocator::free(const Allocation& allocation)
+{
+    if (!allocation.isValid() || !hasPage(allocation.page)) return false;
+
+    Page& page = *m_pages[allocation.page];
+    page.vertices.free(allocation.vertices);
+    page.indices.free(allocation.indices);
+
+    // the first page is kept, so a single chunk changing doesn't create and destroy it repeatedly
+    if (allocation.page == 0 || !page.vertices.isEmpty()) return false;
+
+    m_pages[allocation.page].reset();
+    return true;
+}
+void MapChunkMeshArena::PageAllocator::clear()
+{
+    m_pages.clear();
+}
+
+size_t MapChunkMeshArena::PageAllocator::numPageSlots() const
+{
+    return m_pages.size();
+}
+bool MapChunkMeshArena::PageAllocator::hasPage(size_t page) const
+{
+    return page < m_pages.size() && m_pages[page] != nullptr;
+}
+size_t MapChunkMeshArena::PageAllocator::vertexCapacity(size_t page) const
+{
+    return m_pages[page]->vertices.stats().capacity;
+}
+size_t MapChunkMeshArena::PageAllocator::indexCapacity(size_t page) const
+{
+    return m_pages[page]->indices.stats().capacity;
+}
+
+size_t MapChunkMeshArena::PageAllocator::numPages() const
+{
+    return static_cast<size_t>(std::count_if(m_pages.begin(), m_pages.end(), [](const auto& page) { return page != nullptr; }));
+}
+MapChunkMeshArena::RangeAllocator::Stats MapChunkMeshArena::PageAllocator::vertexStats() const
+{
+    RangeAllocator::Stats stats{ 0, 0, 0, 0, 0 };
+    for (const auto& page : m_pages)
+    {
+        if (page != nullptr) addPageStats(stats, page->vertices.stats());
+    }
+
+    return stats;
+}
+MapChunkMeshArena::RangeAllocator::Stats MapChunkMeshArena::PageAllocator::indexStats() const
+{
+    RangeAllocator::Stats stats{ 0, 0, 0, 0, 0 };
+    for (const auto& page : m_pages)
+    {
+        if (page != nullptr) addPageStats(stats, page->indices.stats());
+    }
+
+    return stats;
+}
+
+size_t MapChunkMeshArena::PageAllocator::createPage(size_t numVertices, size_t numIndices)
+{
+    const size_t vertexCapacity = std::max(verticesPerPage, (numVertices + vertexGranularity - 1) / vertexGranularity * vertexGranularity);
+    const size_t indexCapacity = std::max(indicesPerPage, (numIndices + indexGranularity - 1) / indexGranularity * indexGranularity);
+
+    auto freeSlot = std::find(m_pages.begin(), m_pages.end(), nullptr);
+    if (freeSlot == m_pages.end())
+    {
+        freeSlot = m_pages.emplace(m_pages.end());
+    }
+    *freeSlot = std::make_unique<Page>(Page{ RangeAllocator(vertexCapacity, vertexGranularity), RangeAllocator(indexCapacity, indexGranularity) });
+
+    return static_cast<size_t>(freeSlot - m_pages.begin());
+}
+void MapChunkMeshArena::PageAllocator::addPageStats(RangeAllocator::Stats& total, const RangeAllocator::Stats& page)
+{
+    total.capacity += page.capacity;
+    total.numUsed += page.numUsed;
+    total.numAllocations += page.numAllocations;
+    total.numFreeRanges += page.numFreeRanges;
+    // a mesh can't span pages
+    total.largestFreeRange = std::max(total.largestFreeRange, page.largestFreeRange);
+}
+
+MapChunkMeshArena::PageBuffers::PageBuffers(size_t vertexCapacity, size_t indexCapacity) :
+    chunkOrigins(GL_RGBA32I, static_cast<GLsizeiptr>(vertexCapacity / vertexGranularity * 4 * sizeof(int32_t)), GL_DYNAMIC_DRAW)
+{
+    vbo = &vao.createVertexBufferObject();
+    vbo->reserve<BlockVertex>(vertexCapacity, GL_DYNAMIC_DRAW);
+    vao.setIntegerVertexAttribute(*vbo, 0, &BlockVertex::packedPosUv, 1, GL_UNSIGNED_INT);
+    vao.setIntegerVertexAttribute(*vbo, 1, &BlockVertex::packedTile, 1, GL_UNSIGNED_INT);
+
+    // the element buffer binding is a part of the vao
+    vao.bind();
+    ibo = &vao.createIndexBufferObject();
+    ibo->reserve<uint32_t>(indexCapacity, GL_DYNAMIC_DRAW);
+}
+
+MapChunkMeshArena& MapChunkMeshArena::instance()
+{
+    static MapChunkMeshArena arena;
+    return arena;
+}
+
+MapChunkMeshArena::MapChunkMeshArena() :
+    m_numUploads(0),
+    m_numInPlaceUploads(0)
+{
+}
+
+MapChunkMeshArena::Allocation MapChunkMeshArena::upload(const std::vector<BlockVertex>& vertices, const std::vector<uint32_t>& indices, const ls::Vec3I& chunkOrigin, const Allocation& previous)
+{
+    PROFILE_ZONE("MapChunkMeshArena::upload");
+
+    Allocation allocation = previous;
+    if (allocation.isValid() && fitsInPlace(allocation, vertices.size(), indices.size()))
+    {
+        ++m_numInPlaceUploads;
+    }
+    else
+    {
+        free(allocation);
+        allocation = m_pageAllocator.allocate(vertices.size(), indices.size());
+        ensurePageBuffers(allocation.page);
+    }
+
+    allocation.numVertices = vertices.size();
+    allocation.numIndices = indices.size();
+
+    PageBuffers& page = *m_pageBuffers[allocation.page];
+    page.vbo->update(vertices.data(), static_cast<GLintptr>(allocation.vertices.offset * sizeof(BlockVertex)), static_cast<GLsizeiptr>(vertices.size()));
+    page.vao.bind();
+    page.ibo->update(indices.data(), static_cast<GLintptr>(allocation.indices.offset * sizeof(uint32_t)), static_cast<GLsizeiptr>(indices.size()));
+    writeChunkOrigins(allocation, chunkOrigin);
+    ++m_numUploads;
+
+    return allocation;
+}
+void MapChunkMeshArena::free(Allocation& allocation)
+{
+    if (!allocation.isValid()) return;
+
+    if (m_pageAllocator.free(allocation))
+    {
+        m_pageBuffers[allocation.page].reset();
+    }
+
+    allocation = Allocation::makeInvalid();
+}
+
+MapChunkMeshArena::DrawStats MapChunkMeshArena::draw(const DrawList& meshes, GLenum chunkOriginsTextureUnit)
+{
+    PROFILE_ZONE("MapChunkMeshArena::draw");
+
+    // grouped by page, the order within a page is kept
+    m_drawCommands.clear();
+    m_pageDraws.clear();
+    for (size_t i = 0; i < m_pageBuffers.size(); ++i)
+    {
+        if (m_pageBuffers[i] == nullptr) continue;
+
+        const size_t firstCommand = m_drawCommands.size();
+        for (const auto& mesh : meshes)
+        {
+            if (mesh.page != i || mesh.numIndices == 0) continue;
+
+            m_drawCommands.push_back(DrawElementsIndirectCommand{
+                static_cast<GLuint>(mesh.numIndices),
+                1,
+                static_cast<GLuint>(mesh.indices.offset),
+                static_cast<GLint>(mesh.vertices.offset),
+                0
+            });
+        }
+
+        if (m_drawCommands.size() > firstCommand)
+        {
+            m_pageDraws.push_back(PageDraw{ i, firstCommand, m_drawCommands.size() - firstCommand });
+        }
+    }
+
+    if (usesMultiDrawIndirect() && !m_drawCommands.empty())
+    {
+        m_drawCommandBuffer->reset(m_drawCommands.data(), static_cast<GLsizeiptr>(m_drawCommands.size()), GL_STREAM_DRAW);
+    }
+
+    for (const auto& pageDraw : m_pageDraws)
+    {
+        m_pageBuffers[pageDraw.page]->chunkOrigins.bind(chunkOriginsTextureUnit);
+        drawPage(pageDraw);
+    }
+
+    return DrawStats{ m_pageDraws.size(), m_drawCommands.size() };
+}
+
+void MapChunkMeshArena::shutdown()
+{
+    m_pageBuffers.clear();
+    m_pageAllocator.clear();
+    m_drawCommandBuffer.reset();
+}
+
+void MapChunkMeshArena::readBack(const Allocation& allocation, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, std::vector<ls::Vec3I>& chunkOrigins) const
+{
+    const PageBuffers& page = *m_pageBuffers[allocation.page];
+
+    vertices.resize(allocation.numVertices);
+    page.vbo->read(vertices.data(), static_cast<GLintptr>(allocation.vertices.offset * sizeof(BlockVertex)), static_cast<GLsizeiptr>(vertices.size()));
+
+    indices.resize(allocation.numIndices);
+    page.vao.bind();
+    page.ibo->read(indices.data(), static_cast<GLintptr>(allocation.indices.offset * sizeof(uint32_t)), static_cast<GLsizeiptr>(indices.size()));
+
+    std::vector<int32_t> origins(allocation.vertices.size / vertexGranularity * 4);
+    page.chunkOrigins.read(origins.data(), static_cast<GLintptr>(allocation.vertices.offset / vertexGranularity * 4 * sizeof(int32_t)), static_cast<GLsizeiptr>(origins.size()));
+    chunkOrigins.clear();
+    for (size_t i = 0; i < origins.size(); i += 4)
+    {
+        chunkOrigins.emplace_back(origins[i], origins[i + 1], origins[i + 2]);
+    }
+}
+
+bool MapChunkMeshArena::usesMultiDrawIndirect() const
+{
+    return m_drawCommandBuffer != nullptr;
+}
+
+MapChunkMeshArena::Stats MapChunkMeshArena::stats() const
+{
+    return Stats{ m_pageAllocator.numPages(), m_pageAllocator.vertexStats(), m_pageAllocator.indexStats(), m_numUploads, m_numInPlaceUploads };
+}
+
+bool MapChunkMeshArena::fitsInPlace(const Allocation& allocation, size_t numVertices, size_t numIndices) const
+{
+    // meshes that shrank a lot give the space back
+    return
+        numVertices <= allocation.vertices.size && allocation.vertices.size <= std::max(numVertices * 2, vertexGranularity)
+        && numIndices <= allocation.indices.size && allocation.indices.size <= std::max(numIndices * 2, indexGranularity);
+}
+void MapChunkMeshArena::ensurePageBuffers(size_t page)
+{
+    if (m_pageBuffers.size() < m_pageAllocator.numPageSlots())
+    {
+        m_pageBuffers.resize(m_pageAllocator.numPageSlots());
+    }
+    if (m_pageBuffers[page] != nullptr) return;
+
+    if (m_drawCommandBuffer == nullptr && (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect))
+    {
+        m_drawCommandBuffer = std::make_unique<ls::gl::DrawIndirectBufferObject>();
+    }
+
+    m_pageBuffers[page] = std::make_unique<PageBuffers>(m_pageAllocator.vertexCapacity(page), m_pageAllocator.indexCapacity(page));
+}
+void MapChunkMeshArena::writeChunkOrigins(const Allocation& allocation, const ls::Vec3I& chunkOrigin)
+{
+    const size_t firstEntry = allocation.vertices.offset / vertexGranularity;
+    const size_t numEntries = allocation.vertices.size / vertexGranularity;
+
+    m_chunkOriginsScratch.clear();
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        m_chunkOriginsScratch.insert(m_chunkOriginsScratch.end(), { chunkOrigin.x, chunkOrigin.y, chunkOrigin.z, 0 });
+    }
+
+    m_pageBuffers[allocation.page]->chunkOrigins.update(m_chunkOriginsScratch.data(), static_cast<GLintptr>(firstEntry * 4 * sizeof(int32_t)), static_cast<GLsizeiptr>(m_chunkOriginsScratch.size()));
+}
+void MapChunkMeshArena::drawPage(const PageDraw& pageDraw)
+{
+    PageBuffers& page = *m_pageBuffers[pageDraw.page];
+
+    if (usesMultiDrawIndirect())
+    {
+        page.vao.multiDrawElementsIndirect(
+            GL_TRIANGLES,
+            GL_UNSIGNED_INT,
+            static_cast<GLintptr>(pageDraw.firstCommand * sizeof(DrawElementsIndirectCommand)),
+            static_cast<GLsizei>(pageDraw.numCommands),
+            0
+        );
+        return;
+    }
+
+    m_drawCounts.clear();
+    m_drawFirstIndices.clear();
+    m_drawBaseVertices.clear();
+    for (size_t i = pageDraw.firstCommand; i < pageDraw.firstCommand + pageDraw.numCommands; ++i)
+    {
+        const auto& command = m_drawCommands[i];
+        m_drawCounts.push_back(static_cast<GLsizei>(command.count));
+        m_drawFirstIndices.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(command.firstIndex) * sizeof(uint32_t)));
+        m_drawBaseVertices.push_back(command.baseVertex);
+    }
+
+    page.vao.multiDrawElementsBaseVertex(
+        GL_TRIANGLES,
+        m_drawCounts.data(),
+        GL_UNSIGNED_INT,
+        m_drawFirstIndices.data(),
+        static_cast<GLsizei>(pageDraw.numCommands),
+        m_drawBaseVertices.data()
+    );
+}
@@ -2,17 +2,26 @@
 
 #include "map/MapChunk.h"
 
-MapChunkRenderQueue::MapChunkRenderQueue(int maxDistance) :
-    m_maxDistance(maxDistance),
-    m_drawQueue(maxDistance + 1)
+#include <algorithm>
+#include <chrono>
+
+MapChunkRenderQueue::MapChunkRenderQueue() :
+    m_cameraPosition(0.0f, 0.0f, 0.0f)
 {
 
 }
 
-void MapChunkRenderQueue::enqueueDraw(MapChunk& chunk, int distance)
+void MapChunkRenderQueue::beginFrame(const ls::Vec3F& cameraPosition)
+{
+    m_cameraPosition = cameraPosition;
+    m_drawQueue.clear();
+    m_cullQueue.clear();
+}
+
+void MapChunkRenderQueue::enqueueDraw(MapChunk& chunk)
 {
-    if (distance > m_maxDistance) distance = m_maxDistance;
-    m_drawQueue[distance].emplace_back(&chunk);
+    const float distanceSquared = chunk.boundingSphere().origin.distanceSquared(m_cameraPosition);
+    m_drawQueue.push_back(DrawEntry{ distanceSquared, static_cast<uint32_t>(m_drawQueue.size()), &chunk });
 }
 
 void MapChunkRenderQueue::enqueueCull(MapChunk& chunk)
@@ -20,20 +29,32 @@ void MapChunkRenderQueue::enqueueCull(MapChunk& chunk)
     m_cullQueue.emplace_back(&chunk);
 }
 
-void MapChunkRenderQueue::draw(float dt)
+MapChunkRenderQueue::DrawStats MapChunkRenderQueue::draw(float dt, GLenum chunkOriginsTextureUnit)
 {
-    int drawCounter = 0;
-    for (auto& queue : m_drawQueue)
+    // std::stable_sort may allocate a buffer, the order of enqueueing breaks the ties instead
+    std::sort(m_drawQueue.begin(), m_drawQueue.end(), [](const DrawEntry& lhs, const DrawEntry& rhs) {
+        if (lhs.distanceSquared != rhs.distanceSquared) return lhs.distanceSquared < rhs.distanceSquared;
+        return lhs.order < rhs.order;
+    });
+
+    // visible chunks are nearest first, so they get the budget before the culled ones
+    MapChunkMeshUpdateBudget budget{ m_maxMeshJobsScheduledPerFrame, m_maxMeshBytesUploadedPerFrame };
+    m_drawList.clear();
+    size_t numDrawnVertices = 0;
+    for (const DrawEntry& entry : m_drawQueue)
     {
-        for (MapChunk* chunk : queue)
-        {
-            chunk->draw(dt, drawCounter);
-        }
+        entry.chunk->draw(dt, budget, m_drawList);
+        numDrawnVertices += entry.chunk->numMeshVertices();
     }
 
-    int cullCounter = 0;
     for (MapChunk* chunk : m_cullQueue)
     {
-        chunk->culled(dt, cullCounter);
+        chunk->culled(dt, budget);
     }
+
+    const auto submitStart = std::chrono::steady_clock::now();
+    const MapChunkMeshArena::DrawStats arenaStats = MapChunkMeshArena::instance().draw(m_drawList, chunkOriginsTextureUnit);
+
+    const auto submitTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - submitStart);
+    return DrawStats{ numDrawnVertices, arenaStats.numMeshes, arenaStats.numDrawCalls, static_cast<uint64_t>(submitTime.count()) };
 }
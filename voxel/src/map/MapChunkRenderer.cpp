@@ -5,31 +5,72 @@
 #include "block/BlockContainer.h"
 
 #include "map/MapChunk.h"
+#include "map/MapChunkSnapshot.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+MapChunkRenderer::MeshingMode MapChunkRenderer::m_meshingMode = MapChunkRenderer::MeshingMode::Greedy;
+int MapChunkRenderer::m_currentMeshingModeVersion = 0;
 
 MapChunkRenderer::MapChunkRenderer() :
+    m_meshAllocation(MapChunkMeshArena::Allocation::makeInvalid()),
     m_timeOutsideDrawingRange(0.0f),
-    m_iboSize(0),
-    m_needsUpdate(true)
+    m_needsUpdate(true),
+    m_meshingModeVersion(m_currentMeshingModeVersion)
+{
+}
+MapChunkRenderer::MapChunkRenderer(MapChunkRenderer&& other) noexcept :
+    m_meshAllocation(other.m_meshAllocation),
+    m_timeOutsideDrawingRange(other.m_timeOutsideDrawingRange),
+    m_needsUpdate(other.m_needsUpdate),
+    m_meshingModeVersion(other.m_meshingModeVersion),
+    m_meshJob(std::move(other.m_meshJob)),
+    m_pendingMesh(std::move(other.m_pendingMesh))
 {
-    m_vbo = &m_vao.createVertexBufferObject();
-    m_vao.setVertexAttribute(*m_vbo, 0, &BlockVertex::pos, 3, GL_FLOAT, GL_FALSE);
-    m_vao.setVertexAttribute(*m_vbo, 1, &BlockVertex::uv, 2, GL_FLOAT, GL_FALSE);
+    other.m_meshAllocation = MapChunkMeshArena::Allocation::makeInvalid();
+}
+MapChunkRenderer& MapChunkRenderer::operator=(MapChunkRenderer&& other) noexcept
+{
+    MapChunkMeshArena::instance().free(m_meshAllocation);
+
+    m_meshAllocation = other.m_meshAllocation;
+    m_timeOutsideDrawingRange = other.m_timeOutsideDrawingRange;
+    m_needsUpdate = other.m_needsUpdate;
+    m_meshingModeVersion = other.m_meshingModeVersion;
+    m_meshJob = std::move(other.m_meshJob);
+    m_pendingMesh = std::move(other.m_pendingMesh);
+
+    other.m_meshAllocation = MapChunkMeshArena::Allocation::makeInvalid();
 
-    m_ibo = &m_vao.createIndexBufferObject();
+    return *this;
 }
-void MapChunkRenderer::draw(MapChunk& chunk, float dt, int& numUpdatedChunksOnDraw)
+MapChunkRenderer::~MapChunkRenderer()
 {
-    if (m_needsUpdate && numUpdatedChunksOnDraw < m_maxChunksUpdatedOnDrawPerFrame)
-    {
-        update(chunk);
-        m_needsUpdate = false;
+    MapChunkMeshArena::instance().free(m_meshAllocation);
+}
+void MapChunkRenderer::setMeshingMode(MeshingMode mode)
+{
+    if (mode == m_meshingMode) return;
 
-        ++numUpdatedChunksOnDraw;
-    }
+    m_meshingMode = mode;
+    ++m_currentMeshingModeVersion;
+}
+MapChunkRenderer::MeshingMode MapChunkRenderer::meshingMode()
+{
+    return m_meshingMode;
+}
 
-    if (m_iboSize > 0)
+void MapChunkRenderer::draw(MapChunk& chunk, float dt, MapChunkMeshUpdateBudget& budget, MapChunkMeshArena::DrawList& drawList)
+{
+    update(chunk, budget);
+
+    if (m_meshAllocation.isValid())
     {
-        m_vao.drawElements(GL_TRIANGLES, static_cast<GLsizei>(m_iboSize), GL_UNSIGNED_INT);
+        drawList.emplace_back(m_meshAllocation);
     }
 
     m_timeOutsideDrawingRange = 0.0f;
@@ -37,64 +78,365 @@ void MapChunkRenderer::draw(MapChunk& chunk, float dt, int& numUpdatedChunksOnDr
 
 void MapChunkRenderer::scheduleUpdate()
 {
+    cancelMeshJob();
     m_needsUpdate = true;
 }
 void MapChunkRenderer::tooFarToDraw(MapChunk& chunk, float dt)
 {
     m_timeOutsideDrawingRange += dt;
-    if (m_iboSize > 0 && m_timeOutsideDrawingRange > m_maxTimeOutsideDrawingRange)
+    if (m_meshAllocation.isValid() && m_timeOutsideDrawingRange > m_maxTimeOutsideDrawingRange)
     {
-        // TODO: better emptying of the buffers
-        m_vbo->reset<char>(nullptr, 1, GL_STATIC_DRAW);
-        m_ibo->reset<char>(nullptr, 1, GL_STATIC_DRAW);
+        MapChunkMeshArena::instance().free(m_meshAllocation);
 
-        m_iboSize = 0;
+        cancelMeshJob();
         m_needsUpdate = true;
     }
 }
-void MapChunkRenderer::culled(MapChunk& chunk, float dt, int& numUpdatedChunksOnCull)
+void MapChunkRenderer::culled(MapChunk& chunk, float dt, MapChunkMeshUpdateBudget& budget)
+{
+    update(chunk, budget);
+
+    m_timeOutsideDrawingRange = 0.0f;
+}
+void MapChunkRenderer::unreached(MapChunk& chunk, float dt)
+{
+    // the mesh is kept for a while, like for chunks out of range
+    tooFarToDraw(chunk, dt);
+}
+size_t MapChunkRenderer::numVertices() const
 {
-    if (m_needsUpdate && numUpdatedChunksOnCull < m_maxChunksUpdatedOnCullPerFrame)
+    return m_meshAllocation.numVertices;
+}
+size_t MapChunkRenderer::cpuMeshMemoryUsage() const
+{
+    // the mesh is written by the job until it is done
+    if (!m_meshJob.isValid() || !m_meshJob.isDone()) return 0;
+
+    return m_pendingMesh->sizeInBytes();
+}
+size_t MapChunkRenderer::gpuMeshMemoryUsage() const
+{
+    return m_meshAllocation.sizeInBytes();
+}
+void MapChunkRenderer::update(MapChunk& chunk, MapChunkMeshUpdateBudget& budget)
+{
+    PROFILE_ZONE("MapChunkRenderer::update");
+
+    if (m_meshingModeVersion != m_currentMeshingModeVersion)
     {
-        update(chunk);
+        m_meshingModeVersion = m_currentMeshingModeVersion;
+        scheduleUpdate();
+    }
+
+    if (m_meshJob.isValid())
+    {
+        if (m_meshJob.isDone() && tryUploadPendingMesh(chunk, budget))
+        {
+            m_meshJob = ThreadPool::JobHandle();
+            m_pendingMesh.reset();
+        }
+    }
+    else if (m_needsUpdate && budget.numMeshJobsLeft > 0)
+    {
+        scheduleMeshJob(chunk);
         m_needsUpdate = false;
 
-        ++numUpdatedChunksOnCull;
+        --budget.numMeshJobsLeft;
     }
+}
+void MapChunkRenderer::scheduleMeshJob(MapChunk& chunk)
+{
+    // the snapshot is taken here, so the job never touches the chunk
+    auto snapshot = std::make_shared<const MapChunkSnapshot>(chunk);
+    m_pendingMesh = std::make_shared<Mesh>();
+    m_meshJob = ThreadPool::instance().submit(m_meshJobPriority, [snapshot, mode = m_meshingMode, mesh = m_pendingMesh]() {
+        buildMesh(*snapshot, mode, *mesh);
+    });
+}
+bool MapChunkRenderer::tryUploadPendingMesh(const MapChunk& chunk, MapChunkMeshUpdateBudget& budget)
+{
+    // the last upload may exceed the budget, so big meshes can't get stuck
+    if (budget.numBytesToUploadLeft == 0) return false;
+    budget.numBytesToUploadLeft -= std::min(m_pendingMesh->sizeInBytes(), budget.numBytesToUploadLeft);
 
-    m_timeOutsideDrawingRange = 0.0f;
+    const auto& vertices = m_pendingMesh->vertices;
+    const auto& indices = m_pendingMesh->indices;
+    if (indices.empty())
+    {
+        MapChunkMeshArena::instance().free(m_meshAllocation);
+    }
+    else
+    {
+        m_meshAllocation = MapChunkMeshArena::instance().upload(vertices, indices, chunk.firstBlockPosition(), m_meshAllocation);
+    }
+
+    return true;
 }
-void MapChunkRenderer::update(MapChunk& chunk)
+void MapChunkRenderer::cancelMeshJob()
 {
-    static constexpr size_t vertexBufferCapacity = 1024;
-    static constexpr size_t indexBufferCapacity = 1024;
+    if (!m_meshJob.isValid()) return;
 
-    static thread_local std::vector<BlockVertex> vertices;
-    static thread_local std::vector<uint32_t> indices;
-    vertices.clear();
-    indices.clear();
+    // a running job still finishes, but its result is dropped with the pending mesh
+    m_meshJob.cancel();
+    m_meshJob = ThreadPool::JobHandle();
+    m_pendingMesh.reset();
+}
+size_t MapChunkRenderer::Mesh::sizeInBytes() const
+{
+    return vertices.size() * sizeof(BlockVertex) + indices.size() * sizeof(uint32_t);
+}
+
+void MapChunkRenderer::buildMesh(const MapChunkSnapshot& chunk, MeshingMode mode, Mesh& mesh)
+{
+    PROFILE_ZONE("MapChunkRenderer::buildMesh");
 
-    const ls::Vec3I firstBlockPos = chunk.firstBlockPosition();
+    if (mode == MeshingMode::Greedy)
+    {
+        appendChunkGreedy(chunk, mesh.vertices, mesh.indices);
+    }
+    else if (chunk.isUniform())
+    {
+        appendUniformChunk(chunk, mesh.vertices, mesh.indices);
+    }
+    else
+    {
+        appendChunk(chunk, mesh.vertices, mesh.indices);
+    }
+}
+void MapChunkRenderer::appendChunk(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices)
+{
     const auto& blocks = chunk.blocks();
-    const auto& opacity = chunk.outsideOpacityCache();
+    for (int x = 0; x < static_cast<int>(MapChunk::width()); ++x)
+    {
+        for (int y = 0; y < static_cast<int>(MapChunk::height()); ++y)
+        {
+            const MapChunk::OutsideOpacityRow opacity = chunk.outsideOpacityRow(x, y);
+
+            // blocks covered from all sides have no faces to draw
+            const uint32_t uncoveredBlocks = ~(
+                opacity[CubeSide::East] & opacity[CubeSide::West]
+                & opacity[CubeSide::Top] & opacity[CubeSide::Bottom]
+                & opacity[CubeSide::South] & opacity[CubeSide::North]);
+            if (uncoveredBlocks == 0) continue;
+
+            for (int z = 0; z < static_cast<int>(MapChunk::depth()); ++z)
+            {
+                if (((uncoveredBlocks >> z) & 1u) == 0) continue;
+
+                const ls::Vec3I pos(x, y, z);
+                appendBlock(vertices, indices, blocks(x, y, z), pos, MapChunk::outsideOpacityAt(opacity, z));
+            }
+        }
+    }
+}
+void MapChunkRenderer::appendUniformChunk(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const auto& block = chunk.blocks()(0, 0, 0);
+    if (BlockTypeRegistry::instance().mesherKind(block.typeId()) == BlockMesherKind::None) return;
+
+    // all interior blocks see the same neighbours, so if one of them
+    // produces no faces only the blocks on the border have to be visited
+    const size_t numVerticesBefore = vertices.size();
+    const size_t numIndicesBefore = indices.size();
+    const ls::Vec3I probePos(1, 1, 1);
+    appendBlock(vertices, indices, block, probePos, chunk.outsideOpacity(probePos));
+    const bool isInteriorVisible = vertices.size() != numVerticesBefore;
+    vertices.resize(numVerticesBefore);
+    indices.resize(numIndicesBefore);
+
     for (size_t x = 0; x < MapChunk::width(); ++x)
     {
         for (size_t y = 0; y < MapChunk::height(); ++y)
         {
-            for (size_t z = 0; z < MapChunk::depth(); ++z)
+            const bool isBorderColumn = x == 0 || x == MapChunk::width() - 1 || y == 0 || y == MapChunk::height() - 1;
+            const size_t zStep = (isBorderColumn || isInteriorVisible) ? 1 : MapChunk::depth() - 1;
+            for (size_t z = 0; z < MapChunk::depth(); z += zStep)
+            {
+                const ls::Vec3I localPos(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z));
+                appendBlock(vertices, indices, block, localPos, chunk.outsideOpacity(localPos));
+            }
+        }
+    }
+}
+void MapChunkRenderer::appendChunkGreedy(const MapChunkSnapshot& chunk, std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    static constexpr int size = static_cast<int>(MapChunk::width());
+    static_assert(MapChunk::width() == MapChunk::height() && MapChunk::width() == MapChunk::depth(), "slices are assumed to be square");
+
+    const auto& blocks = chunk.blocks();
+    const auto& registry = BlockTypeRegistry::instance();
+
+    // blocks that can't be merged are drawn as usual
+    if (chunk.isUniform())
+    {
+        const BlockMesherKind mesherKind = registry.mesherKind(blocks.typeIdAt(0, 0, 0));
+        if (mesherKind == BlockMesherKind::None) return;
+        if (mesherKind != BlockMesherKind::Cube)
+        {
+            appendUniformChunk(chunk, vertices, indices);
+            return;
+        }
+    }
+
+    // faces are looked up many times in different orders
+    std::vector<MapChunk::OutsideOpacityRow> opacityRows(size * size);
+    for (int x = 0; x < size; ++x)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            opacityRows[x * size + y] = chunk.outsideOpacityRow(x, y);
+        }
+    }
+
+    if (!chunk.isUniform())
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            for (int y = 0; y < size; ++y)
+            {
+                for (int z = 0; z < size; ++z)
+                {
+                    const auto& blockCont = blocks(x, y, z);
+                    if (registry.mesherKind(blockCont.typeId()) != BlockMesherKind::Custom) continue;
+
+                    const ls::Vec3I localPos(x, y, z);
+                    appendBlock(vertices, indices, blockCont, localPos, MapChunk::outsideOpacityAt(opacityRows[x * size + y], z));
+                }
+            }
+        }
+    }
+
+    // types of the visible faces of one slice, the empty type where there is none
+    std::array<BlockTypeId, size * size> mask;
+    for (const auto& side : CubeSide::values())
+    {
+        const ls::Vec3I& normal = side.direction();
+        const int n = normal.x != 0 ? 0 : (normal.y != 0 ? 1 : 2);
+        const int a = (n + 1) % 3;
+        const int b = (n + 2) % 3;
+
+        // in a uniform chunk either every interior face is visible or none is
+        const ls::Vec3I probePos(1, 1, 1);
+        const bool isInteriorVisible = !chunk.isUniform() || !MapChunk::outsideOpacityAt(opacityRows[probePos.x * size + probePos.y], probePos.z)[side];
+        const int borderSlice = normal[n] > 0 ? size - 1 : 0;
+
+        for (int slice = 0; slice < size; ++slice)
+        {
+            if (!isInteriorVisible && slice != borderSlice) continue;
+
+            bool isEmpty = true;
+            for (int v = 0; v < size; ++v)
             {
-                const auto& blockCont = blocks(x, y, z);
+                for (int u = 0; u < size; ++u)
+                {
+                    ls::Vec3I localPos;
+                    localPos[n] = slice;
+                    localPos[a] = u;
+                    localPos[b] = v;
 
-                const ls::Vec3I pos = firstBlockPos + ls::Vec3I(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z));
-                blockCont.block().draw(vertices, indices, pos, opacity(x, y, z));
+                    const BlockTypeId typeId = blocks.typeIdAt(localPos.x, localPos.y, localPos.z);
+                    const bool isCovered = ((opacityRows[localPos.x * size + localPos.y][side] >> localPos.z) & 1u) != 0;
+                    const bool isVisible = registry.mesherKind(typeId) == BlockMesherKind::Cube && !isCovered;
+
+                    mask[v * size + u] = isVisible ? typeId : BlockTypeRegistry::emptyTypeId;
+                    isEmpty = isEmpty && !isVisible;
+                }
             }
+            if (isEmpty) continue;
+
+            for (int v = 0; v < size; ++v)
+            {
+                for (int u = 0; u < size;)
+                {
+                    const BlockTypeId typeId = mask[v * size + u];
+                    if (typeId == BlockTypeRegistry::emptyTypeId)
+                    {
+                        ++u;
+                        continue;
+                    }
+
+                    // grow along u first, then add rows as long as they are fully covered
+                    int width = 1;
+                    while (u + width < size && mask[v * size + u + width] == typeId) ++width;
+
+                    int height = 1;
+                    for (; v + height < size; ++height)
+                    {
+                        const auto rowBegin = mask.begin() + (v + height) * size + u;
+                        if (!std::all_of(rowBegin, rowBegin + width, [typeId](BlockTypeId t) { return t == typeId; })) break;
+                    }
+
+                    for (int dv = 0; dv < height; ++dv)
+                    {
+                        const auto rowBegin = mask.begin() + (v + dv) * size + u;
+                        std::fill(rowBegin, rowBegin + width, BlockTypeRegistry::emptyTypeId);
+                    }
+
+                    ls::Vec3I localPos;
+                    localPos[n] = slice;
+                    localPos[a] = u;
+                    localPos[b] = v;
+                    ls::Vec3I extent;
+                    extent[n] = 1;
+                    extent[a] = width;
+                    extent[b] = height;
+                    appendQuad(vertices, indices, typeId, side, localPos, extent);
+
+                    u += width;
+                }
+            }
+        }
+    }
+}
+void MapChunkRenderer::appendBlock(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, const BlockContainer& block, const ls::Vec3I& position, BlockSideOpacity outsideOpacity)
+{
+    static const ls::Vec3I unitExtent(1, 1, 1);
+
+    const BlockTypeId typeId = block.typeId();
+    switch (BlockTypeRegistry::instance().mesherKind(typeId))
+    {
+    case BlockMesherKind::None:
+        break;
+    case BlockMesherKind::Cube:
+        for (const auto& side : CubeSide::values())
+        {
+            if (!outsideOpacity[side]) appendQuad(vertices, indices, typeId, side, position, unitExtent);
         }
+        break;
+    case BlockMesherKind::Custom:
+        block.block().draw(vertices, indices, position, outsideOpacity);
+        break;
+    }
+}
+void MapChunkRenderer::appendQuad(std::vector<BlockVertex>& vertices, std::vector<uint32_t>& indices, BlockTypeId typeId, CubeSide side, const ls::Vec3I& position, const ls::Vec3I& extent)
+{
+    static const std::array<unsigned, 6> faceIndices = CubeSide::faceIndices();
+
+    const auto& face = side.faceVertices();
+
+    // uv of the unit face grows along one axis each, the tile repeats once per block
+    const ls::Vec3I uDir = face[1].pos - face[0].pos;
+    const ls::Vec3I vDir = face[3].pos - face[0].pos;
+    const ls::Vec2I uvScale(
+        std::abs(uDir.x) * extent.x + std::abs(uDir.y) * extent.y + std::abs(uDir.z) * extent.z,
+        std::abs(vDir.x) * extent.x + std::abs(vDir.y) * extent.y + std::abs(vDir.z) * extent.z
+    );
+    const ls::Vec2I tile = BlockTypeRegistry::instance().faceTile(typeId, side);
+
+    const uint32_t lastIndex = static_cast<uint32_t>(vertices.size());
+    for (const auto& v : face)
+    {
+        vertices.push_back(
+            BlockVertex{
+                v.pos * extent + position,
+                v.uv * uvScale,
+                tile
+            }
+        );
     }
 
-    m_iboSize = indices.size();
-    if (m_iboSize > 0)
+    for (const auto& i : faceIndices)
     {
-        m_vbo->reset(vertices.data(), vertices.size(), GL_DYNAMIC_DRAW);
-        m_ibo->reset(indices.data(), indices.size(), GL_DYNAMIC_DRAW);
+        indices.emplace_back(lastIndex + i);
     }
 }
@@ -0,0 +1,44 @@
+#include "map/MapChunkSnapshot.h"
+
+#include <algorithm>
+
+MapChunkSnapshot::MapChunkSnapshot(const MapChunk& chunk) :
+    m_firstBlockPosition(chunk.firstBlockPosition()),
+    m_blocks(chunk.m_blocks.clone()),
+    m_blockOpacityMasks(chunk.m_blockOpacityMasks.isEmpty() ? BlockOpacityMaskArray::makeEmpty() : MapChunkStorageReserve::instance().loadOpacityMasks()),
+    m_borderOpacity(chunk.m_borderOpacity)
+{
+    if (!m_blockOpacityMasks.isEmpty())
+    {
+        std::copy(chunk.m_blockOpacityMasks.begin(), chunk.m_blockOpacityMasks.end(), m_blockOpacityMasks.begin());
+    }
+}
+MapChunkSnapshot::~MapChunkSnapshot()
+{
+    if (!m_blockOpacityMasks.isEmpty())
+    {
+        MapChunkStorageReserve::instance().storeOpacityMasks(std::move(m_blockOpacityMasks));
+    }
+}
+
+const ls::Vec3I& MapChunkSnapshot::firstBlockPosition() const
+{
+    return m_firstBlockPosition;
+}
+const MapChunkBlockStorage& MapChunkSnapshot::blocks() const
+{
+    return m_blocks;
+}
+bool MapChunkSnapshot::isUniform() const
+{
+    return m_blocks.isUniform();
+}
+
+BlockSideOpacity MapChunkSnapshot::outsideOpacity(const ls::Vec3I& localPos) const
+{
+    return MapChunk::outsideOpacityAt(outsideOpacityRow(localPos.x, localPos.y), localPos.z);
+}
+MapChunk::OutsideOpacityRow MapChunkSnapshot::outsideOpacityRow(int x, int y) const
+{
+    return MapChunk::computeOutsideOpacityRow(m_blocks, m_blockOpacityMasks, m_borderOpacity, x, y);
+}
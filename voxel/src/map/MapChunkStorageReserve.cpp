@@ -0,0 +1,153 @@
+#include "map/MapChunkStorageReserve.h"
+
+#include <algorithm>
+#include <memory>
+
+MapChunkStorageReserve& MapChunkStorageReserve::instance()
+{
+    static MapChunkStorageReserve singleton;
+
+    return singleton;
+}
+
+MapChunkStorageReserve::MapChunkStorageReserve() :
+    m_numRetained(0),
+    m_maxRetained(m_defaultMaxRetained),
+    m_minRetainedSinceTrim(0),
+    m_slotHint(0),
+    m_numHits(0),
+    m_numMisses(0),
+    m_numStored(0),
+    m_numDropped(0),
+    m_numTrimmed(0)
+{
+    for (auto& slot : m_slots)
+    {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+MapChunkStorageReserve::~MapChunkStorageReserve()
+{
+    for (auto& slot : m_slots)
+    {
+        delete[] slot.exchange(nullptr, std::memory_order_acquire);
+    }
+}
+
+detail::BlockOpacityMaskArray MapChunkStorageReserve::loadOpacityMasks()
+{
+    OpacityMaskBuffer* buffer = takeBuffer();
+    if (buffer == nullptr)
+    {
+        m_numMisses.fetch_add(1, std::memory_order_relaxed);
+        return detail::BlockOpacityMaskArray();
+    }
+
+    m_numHits.fetch_add(1, std::memory_order_relaxed);
+    return detail::BlockOpacityMaskArray::fromBuffer(std::unique_ptr<OpacityMaskBuffer[]>(buffer));
+}
+void MapChunkStorageReserve::storeOpacityMasks(detail::BlockOpacityMaskArray&& arr)
+{
+    if (arr.isEmpty()) return;
+
+    size_t numRetained = m_numRetained.load(std::memory_order_relaxed);
+    do
+    {
+        if (numRetained >= m_maxRetained.load(std::memory_order_relaxed))
+        {
+            // freed together with arr
+            m_numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!m_numRetained.compare_exchange_weak(numRetained, numRetained + 1, std::memory_order_relaxed));
+
+    placeBuffer(arr.releaseBuffer().release());
+    m_numStored.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MapChunkStorageReserve::setMaxRetained(size_t maxRetained)
+{
+    // buffers above the new limit are freed by the next trim
+    m_maxRetained.store(std::min(maxRetained, m_numSlots), std::memory_order_relaxed);
+}
+size_t MapChunkStorageReserve::maxRetained() const
+{
+    return m_maxRetained.load(std::memory_order_relaxed);
+}
+
+void MapChunkStorageReserve::trim()
+{
+    const size_t numRetained = m_numRetained.load(std::memory_order_relaxed);
+    const size_t numOverLimit = numRetained - std::min(numRetained, m_maxRetained.load(std::memory_order_relaxed));
+    const size_t numToFree = std::max(m_minRetainedSinceTrim.load(std::memory_order_relaxed), numOverLimit);
+
+    for (size_t i = 0; i < numToFree; ++i)
+    {
+        OpacityMaskBuffer* buffer = takeBuffer();
+        if (buffer == nullptr) break;
+
+        delete[] buffer;
+        m_numTrimmed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_minRetainedSinceTrim.store(m_numRetained.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+MapChunkStorageReserve::Stats MapChunkStorageReserve::stats() const
+{
+    const size_t numRetained = m_numRetained.load(std::memory_order_relaxed);
+
+    return Stats{
+        m_numHits.load(std::memory_order_relaxed),
+        m_numMisses.load(std::memory_order_relaxed),
+        m_numStored.load(std::memory_order_relaxed),
+        m_numDropped.load(std::memory_order_relaxed),
+        m_numTrimmed.load(std::memory_order_relaxed),
+        numRetained,
+        m_maxRetained.load(std::memory_order_relaxed),
+        numRetained * m_opacityMaskBytes
+    };
+}
+
+MapChunkStorageReserve::OpacityMaskBuffer* MapChunkStorageReserve::takeBuffer()
+{
+    if (m_numRetained.load(std::memory_order_relaxed) == 0) return nullptr;
+
+    // buffers are placed after the hint, so the most recently stored ones are found first
+    const size_t start = m_slotHint.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < m_numSlots; ++i)
+    {
+        auto& slot = m_slots[(start + m_numSlots - i) % m_numSlots];
+        if (slot.load(std::memory_order_relaxed) == nullptr) continue;
+
+        OpacityMaskBuffer* buffer = slot.exchange(nullptr, std::memory_order_acquire);
+        if (buffer == nullptr) continue;
+
+        const size_t numRemaining = m_numRetained.fetch_sub(1, std::memory_order_relaxed) - 1;
+        size_t minRetained = m_minRetainedSinceTrim.load(std::memory_order_relaxed);
+        while (numRemaining < minRetained && !m_minRetainedSinceTrim.compare_exchange_weak(minRetained, numRemaining, std::memory_order_relaxed))
+        {
+        }
+
+        return buffer;
+    }
+
+    // the remaining buffers are still being placed
+    return nullptr;
+}
+void MapChunkStorageReserve::placeBuffer(OpacityMaskBuffer* buffer)
+{
+    // a slot was reserved through m_numRetained, at least one of them is empty
+    for (size_t i = m_slotHint.load(std::memory_order_relaxed);; i = (i + 1) % m_numSlots)
+    {
+        auto& slot = m_slots[i];
+        if (slot.load(std::memory_order_relaxed) != nullptr) continue;
+
+        OpacityMaskBuffer* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, buffer, std::memory_order_release, std::memory_order_relaxed))
+        {
+            m_slotHint.store(i, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
@@ -3,46 +3,64 @@
 #include "map/MapChunk.h"
 
 #include "ResourceManager.h"
+#include "Profiler.h"
 #include "block/BlockFactory.h"
 #include "block/Block.h"
 #include "block/BlockContainer.h"
 
 #include "../LibS/Noise/NoiseSampler.h"
 #include "../LibS/Noise/SimplexNoise.h"
+#include "../LibS/Noise/BatchedSimplexNoise.h"
 #include "../LibS/Array3.h"
 #include "../LibS/Shapes/Vec3.h"
 
 #include "map\Map.h"
 
 #include <cstdlib>
+#include <cmath>
+#include <limits>
 #include <utility>
+#include <algorithm>
+#include <array>
+#include <chrono>
 
 MapGenerator::MapGenerator(Map& map) :
-    m_map(&map)
+    m_map(&map),
+    m_heightmaps(m_maxCachedColumns),
+    m_caveSegments(m_maxCachedCaveSegments),
+    m_numGeneratedChunks(0),
+    m_generationTimeUs(0)
 {
 
 }
 
-MapGenerator::CaveMapType MapGenerator::generateCaveMap(const ls::Vec3I& chunkPos, uint32_t seed) const
+void MapGenerator::evictFarCaches(const ls::Vec3I& currentChunk, int minDistance)
 {
-    static constexpr int simulationRadiusInChunks = 1;
-    static constexpr float stepSize = 2.0f;
-    static constexpr float wormSize = (MapChunk::width() + MapChunk::height() + MapChunk::width()) * (0.5f * 1.5f); // average times 1.5
-    static constexpr int maxWormsPerChunk = 3;
-    static constexpr int minWormsPerChunk = 0;
-    static constexpr std::array<float, 3> wormRadii{ 1.8f, 2.5f, 3.5f };
-    static constexpr int maxWormStartHeight = 100;
+    m_heightmaps.evictIf([&currentChunk, minDistance](const ls::Vec3I& pos) {
+        return std::abs(pos.x - currentChunk.x) >= minDistance || std::abs(pos.z - currentChunk.z) >= minDistance;
+    });
+
+    // worms are carved into chunks up to the simulation radius away
+    m_caveSegments.evictIf([&currentChunk, minDistance](const ls::Vec3I& pos) {
+        return Map::distanceBetweenChunks(pos, currentChunk) >= minDistance + m_caveSimulationRadiusInChunks;
+    });
+}
 
-    Hasher hasher(seed);
+MapGenerator::Stats MapGenerator::stats() const
+{
+    return Stats{ m_numGeneratedChunks.load(std::memory_order_relaxed), m_generationTimeUs.load(std::memory_order_relaxed), m_heightmaps.stats(), m_caveSegments.stats() };
+}
 
-    static const std::vector<ls::Array3<bool>> carvingTemplates = []() -> std::vector<ls::Array3<bool>> {
+const std::vector<MapGenerator::CarvingTemplate>& MapGenerator::carvingTemplates()
+{
+    static const std::vector<CarvingTemplate> templates = []() -> std::vector<CarvingTemplate> {
 
-        std::vector<ls::Array3<bool>> templates;
-        templates.reserve(wormRadii.size());
-        for (const auto wormRadius : wormRadii)
+        std::vector<CarvingTemplate> templates;
+        templates.reserve(m_wormRadii.size());
+        for (const auto wormRadius : m_wormRadii)
         {
             const int dim = static_cast<int>(std::round(wormRadius * 2 + 1));
-            ls::Array3<bool> result(dim, dim, dim, false);
+            CarvingTemplate result(dim, dim, dim, false);
             for (int x = 0; x < dim; ++x)
             {
                 for (int y = 0; y < dim; ++y)
@@ -65,7 +83,89 @@ MapGenerator::CaveMapType MapGenerator::generateCaveMap(const ls::Vec3I& chunkPo
         return templates;
     }();
 
-    auto applyTemplate = [](CaveMapType& map, const ls::Array3<bool>& t, const ls::Vec3I& center)
+    return templates;
+}
+
+void MapGenerator::computeCaveSegments(uint32_t seed, const ls::Vec3I& chunkPos, MapCaveSegments& caveSegments)
+{
+    PROFILE_ZONE("MapGenerator::computeCaveSegments");
+
+    Hasher hasher(seed);
+
+    constexpr int maxInt = std::numeric_limits<int>::max();
+    constexpr int minInt = std::numeric_limits<int>::min();
+    caveSegments.min = ls::Vec3I(maxInt, maxInt, maxInt);
+    caveSegments.max = ls::Vec3I(minInt, minInt, minInt);
+
+    const uint32_t chunkHash = hasher(chunkPos.x, chunkPos.y, chunkPos.z);
+    const int numWorms = chunkHash % (m_maxWormsPerChunk - m_minWormsPerChunk + 1) + m_minWormsPerChunk;
+    if (numWorms == 0) return;
+
+    // all worms of a chunk take the same turns, so the steps are sampled once
+    constexpr float xSampleOffset = 0.0f;
+    constexpr float ySampleOffset = m_wormSize * 16.0f;
+    constexpr float zSampleOffset = m_wormSize * 32.0f;
+
+    ls::SimplexNoise<float, Hasher> noiseGen(Hasher{ seed });
+    ls::NoiseSampler2F sampler;
+    sampler.setLowerBound(-1.0f);
+    sampler.setUpperBound(1.0f);
+    sampler.setOctaves(3);
+    sampler.setScale({ 0.01f, 0.01f });
+
+    const float x = static_cast<float>(chunkHash & 0xFFFF);
+    std::array<ls::Vec3F, m_numWormSteps> steps;
+    for (int i = 0; i < m_numWormSteps; ++i)
+    {
+        const float length = i * m_wormStepSize;
+        const float dx = sampler.sample({ x , length + xSampleOffset }, noiseGen);
+        const float dy = sampler.sample({ x , length + ySampleOffset }, noiseGen);
+        const float dz = sampler.sample({ x , length + zSampleOffset }, noiseGen);
+
+        steps[i] = ls::Vec3F(dx, dy * 0.7f, dz).normalized() * m_wormStepSize; // 0.7 factor for y coord to make caves less vertical
+    }
+
+    const auto& templates = carvingTemplates();
+    for (int i = 0; i < numWorms; ++i)
+    {
+        const uint32_t xh = hasher(chunkHash, i);
+        const uint32_t yh = hasher(xh, i);
+        if (yh % MapChunk::height() + chunkPos.y * MapChunk::height() > m_maxWormStartHeight) continue; // to reduce amount of caves on teh surface
+
+        const uint32_t zh = hasher(yh, i);
+        const uint8_t carvingTemplateId = static_cast<uint8_t>(hasher(zh, i) % templates.size());
+        const int halfSize = static_cast<int>(templates[carvingTemplateId].width()) / 2;
+
+        ls::Vec3F pos(
+            static_cast<float>(xh % MapChunk::width()),
+            static_cast<float>(yh % MapChunk::height()),
+            static_cast<float>(zh % MapChunk::depth())
+        );
+        for (const auto& step : steps)
+        {
+            pos += step;
+
+            const ls::Vec3I center = static_cast<ls::Vec3I>(pos);
+            caveSegments.segments.push_back(MapCaveSegments::Segment{
+                static_cast<int16_t>(center.x),
+                static_cast<int16_t>(center.y),
+                static_cast<int16_t>(center.z),
+                carvingTemplateId
+            });
+
+            caveSegments.min = ls::Vec3I(std::min(caveSegments.min.x, center.x - halfSize), std::min(caveSegments.min.y, center.y - halfSize), std::min(caveSegments.min.z, center.z - halfSize));
+            caveSegments.max = ls::Vec3I(std::max(caveSegments.max.x, center.x + halfSize), std::max(caveSegments.max.y, center.y + halfSize), std::max(caveSegments.max.z, center.z + halfSize));
+        }
+    }
+}
+
+MapGenerator::CaveMapType MapGenerator::generateCaveMap(const ls::Vec3I& chunkPos, uint32_t seed) const
+{
+    static constexpr ls::Vec3I chunkSize(static_cast<int>(MapChunk::width()), static_cast<int>(MapChunk::height()), static_cast<int>(MapChunk::depth()));
+
+    const auto& templates = carvingTemplates();
+
+    auto applyTemplate = [](CaveMapType& map, const CarvingTemplate& t, const ls::Vec3I& center)
     {
         const int w = static_cast<int>(t.width());
         const int h = static_cast<int>(t.height());
@@ -90,61 +190,29 @@ MapGenerator::CaveMapType MapGenerator::generateCaveMap(const ls::Vec3I& chunkPo
         }
     };
 
-    ls::SimplexNoise<float, Hasher> noiseGen(Hasher{ seed });
-    ls::NoiseSampler2F sampler;
-    sampler.setLowerBound(-1.0f);
-    sampler.setUpperBound(1.0f);
-    sampler.setOctaves(3);
-    sampler.setScale({ 0.01f, 0.01f });
-
-    auto simulateWorm = [&sampler, &noiseGen, &applyTemplate](CaveMapType& map, const ls::Array3<bool>& carvingTemplate, ls::Vec3F pos, uint32_t chunkHash)
-    {
-        constexpr float xSampleOffset = 0.0f;
-        constexpr float ySampleOffset = wormSize * 16.0f;
-        constexpr float zSampleOffset = wormSize * 32.0f;
-
-        const float x = static_cast<float>(chunkHash & 0xFFFF);
-
-        float length = 0.0f;
-        while (length < wormSize)
-        {
-            const float dx = sampler.sample({ x , length + xSampleOffset }, noiseGen);
-            const float dy = sampler.sample({ x , length + ySampleOffset }, noiseGen);
-            const float dz = sampler.sample({ x , length + zSampleOffset }, noiseGen);
-
-            const ls::Vec3F step = ls::Vec3F(dx, dy * 0.7f, dz).normalized() * stepSize; // 0.5 factor for y coord to make caves less vertical
-            pos += step;
-            applyTemplate(map, carvingTemplate, static_cast<ls::Vec3I>(pos));
-
-            length += stepSize;
-        }
-    };
-
     CaveMapType result(false);
 
-    for (int cdx = -simulationRadiusInChunks; cdx <= simulationRadiusInChunks; ++cdx)
+    for (int cdx = -m_caveSimulationRadiusInChunks; cdx <= m_caveSimulationRadiusInChunks; ++cdx)
     {
-        for (int cdy = -simulationRadiusInChunks; cdy <= simulationRadiusInChunks; ++cdy)
+        for (int cdy = -m_caveSimulationRadiusInChunks; cdy <= m_caveSimulationRadiusInChunks; ++cdy)
         {
-            for (int cdz = -simulationRadiusInChunks; cdz <= simulationRadiusInChunks; ++cdz)
+            for (int cdz = -m_caveSimulationRadiusInChunks; cdz <= m_caveSimulationRadiusInChunks; ++cdz)
             {
-                const ls::Vec3I chunkPos(chunkPos.x + cdx, chunkPos.y + cdy, chunkPos.z + cdz);
-                const uint32_t chunkHash = hasher(chunkPos.x, chunkPos.y, chunkPos.z);
-                const int numWorms = chunkHash % (maxWormsPerChunk - minWormsPerChunk + 1) + minWormsPerChunk;
-                for (int i = 0; i < numWorms; ++i)
+                const ls::Vec3I sourceChunkPos(chunkPos.x + cdx, chunkPos.y + cdy, chunkPos.z + cdz);
+                const auto caveSegments = m_caveSegments.getOrCompute(seed, sourceChunkPos, [seed, &sourceChunkPos](MapCaveSegments& s) {
+                    computeCaveSegments(seed, sourceChunkPos, s);
+                });
+
+                // from the source chunk's coordinates to this chunk's
+                const ls::Vec3I offset(cdx * chunkSize.x, cdy * chunkSize.y, cdz * chunkSize.z);
+                const ls::Vec3I min = caveSegments->min + offset;
+                const ls::Vec3I max = caveSegments->max + offset;
+                if (max.x < 0 || max.y < 0 || max.z < 0 || min.x >= chunkSize.x || min.y >= chunkSize.y || min.z >= chunkSize.z) continue;
+
+                for (const auto& segment : caveSegments->segments)
                 {
-                    const uint32_t xh = hasher(chunkHash, i);
-                    const uint32_t yh = hasher(xh, i);
-                    if (yh % MapChunk::height() + chunkPos.y * MapChunk::height() > maxWormStartHeight) continue; // to reduce amount of caves on teh surface
-
-                    const uint32_t zh = hasher(yh, i);
-                    const uint32_t carvingTemplateId = hasher(zh, i) % carvingTemplates.size();
-                    ls::Vec3F wormPos;
-                    wormPos.x = static_cast<float>(static_cast<int>(xh % MapChunk::width()) + cdx * MapChunk::width());
-                    wormPos.y = static_cast<float>(static_cast<int>(yh % MapChunk::height()) + cdy * MapChunk::height());
-                    wormPos.z = static_cast<float>(static_cast<int>(zh % MapChunk::depth()) + cdz * MapChunk::depth());
-
-                    simulateWorm(result, carvingTemplates[carvingTemplateId], wormPos, chunkHash);
+                    const ls::Vec3I center(segment.x + offset.x, segment.y + offset.y, segment.z + offset.z);
+                    applyTemplate(result, templates[segment.carvingTemplateId], center);
                 }
             }
         }
@@ -155,51 +223,104 @@ MapGenerator::CaveMapType MapGenerator::generateCaveMap(const ls::Vec3I& chunkPo
 
 void MapGenerator::generateChunk(MapChunkBlockData& chunk) const
 {
-    const auto& grassFactory = ResourceManager<BlockFactory>::instance().get("Grass");
-    const auto& dirtFactory = ResourceManager<BlockFactory>::instance().get("Dirt");
-    const auto& stoneFactory = ResourceManager<BlockFactory>::instance().get("Stone");
+    PROFILE_ZONE("MapGenerator::generateChunk");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    generateChunkBlocks(chunk);
+
+    const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    m_generationTimeUs.fetch_add(static_cast<uint64_t>(duration.count()), std::memory_order_relaxed);
+    m_numGeneratedChunks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MapGenerator::computeHeightmap(uint32_t seed, int chunkX, int chunkZ, MapColumnHeightmap& heightmap)
+{
+    PROFILE_ZONE("MapGenerator::computeHeightmap");
 
-    ls::NoiseSampler2D sampler;
-    sampler.setLowerBound(0.0);
-    sampler.setUpperBound(1.0);
+    ls::NoiseSampler2F sampler;
+    sampler.setLowerBound(0.0f);
+    sampler.setUpperBound(1.0f);
     sampler.setOctaves(4);
-    sampler.setScale({ 0.01, 0.01 });
+    sampler.setScale({ 0.01f, 0.01f });
 
-    ls::SimplexNoise<double, Hasher> simplexNoise(Hasher(chunk.seed));
+    const ls::BatchedSimplexNoise simplexNoise(seed);
+
+    sampler.sampleGrid(
+        { static_cast<float>(chunkX * static_cast<int>(MapChunk::width())), static_cast<float>(chunkZ * static_cast<int>(MapChunk::depth())) },
+        { 1.0f, 1.0f },
+        { static_cast<int>(MapChunk::width()), static_cast<int>(MapChunk::depth()) },
+        heightmap.surface.data(),
+        simplexNoise
+    );
+
+    const auto range = std::minmax_element(heightmap.surface.begin(), heightmap.surface.end());
+    heightmap.minSurface = *range.first;
+    heightmap.maxSurface = *range.second;
+}
+
+void MapGenerator::generateChunkBlocks(MapChunkBlockData& chunk) const
+{
+    const auto& grassFactory = ResourceManager<BlockFactory>::instance().get("Grass");
+    const auto& dirtFactory = ResourceManager<BlockFactory>::instance().get("Dirt");
+    const auto& stoneFactory = ResourceManager<BlockFactory>::instance().get("Stone");
 
     const ls::Vec3I firstBlockPos = chunk.firstBlockPosition();
 
+    // surface is sampled first, so chunks that are entirely above it or below it
+    // can be stored as uniform without touching each block
+    const uint32_t seed = chunk.seed;
+    const auto heightmap = m_heightmaps.getOrCompute(seed, ls::Vec3I(chunk.pos.x, 0, chunk.pos.z), [seed, &chunk](MapColumnHeightmap& h) {
+        computeHeightmap(seed, chunk.pos.x, chunk.pos.z, h);
+    });
+    const auto& surfaceNoise = heightmap->surface;
+    const float minSurfaceNoise = heightmap->minSurface;
+    const float maxSurfaceNoise = heightmap->maxSurface;
+
+    // layer tops are nondecreasing in r
+    auto stoneLayerTopAt = [&firstBlockPos](float r) { return 110 + static_cast<int>(r * 5.0f) - firstBlockPos.y; };
+    auto dirtLayerTopAt = [&stoneLayerTopAt](float r) { return stoneLayerTopAt(r) + static_cast<int>(r * 2.0f) + 2; };
+    auto grassLayerTopAt = [&dirtLayerTopAt](float r) { return dirtLayerTopAt(r) + 1; };
+
+    chunk.blocks.fill(m_map->instantiateAirBlock());
+    if (grassLayerTopAt(maxSurfaceNoise) < 0)
+    {
+        return;
+    }
+
     const auto& caveMap = generateCaveMap(chunk.pos, chunk.seed);
 
+    if (stoneLayerTopAt(minSurfaceNoise) >= static_cast<int>(MapChunk::height()) - 1 && std::none_of(caveMap.begin(), caveMap.end(), [](bool isCave) { return isCave; }))
+    {
+        chunk.blocks.fill(stoneFactory.get().instantiate());
+        return;
+    }
+
+    // the storage is already filled with air, so only the solid blocks are set
     for (size_t x = 0; x < MapChunk::width(); ++x)
     {
         for (size_t z = 0; z < MapChunk::depth(); ++z)
         {
-            const double r = sampler.sample({ static_cast<double>(static_cast<int>(x) + firstBlockPos.x), static_cast<double>(static_cast<int>(z) + firstBlockPos.z) }, simplexNoise);
+            const float r = surfaceNoise[x * MapChunk::depth() + z];
 
-            const int stoneLayerTop = 110 + static_cast<int>(r * 5.0) - firstBlockPos.y;
-            const int dirtLayerTop = stoneLayerTop + static_cast<int>(r * 2.0) + 2;
-            const int grassLayerTop = dirtLayerTop + 1;
+            const int stoneLayerTop = stoneLayerTopAt(r);
+            const int dirtLayerTop = dirtLayerTopAt(r);
+            const int grassLayerTop = grassLayerTopAt(r);
 
             int y = 0;
             while (y < static_cast<int>(MapChunk::height()) && y <= stoneLayerTop)
             {
-                chunk.blocks(x, y, z) = caveMap(x, y, z) ? m_map->instantiateAirBlock() : stoneFactory.get().instantiate();
-                 ++y;
+                if (!caveMap(x, y, z)) chunk.blocks.set(x, y, z, stoneFactory.get().instantiate());
+                ++y;
             }
             while (y < static_cast<int>(MapChunk::height()) && y <= dirtLayerTop)
             {
-                chunk.blocks(x, y, z) = caveMap(x, y, z) ? m_map->instantiateAirBlock() : dirtFactory.get().instantiate();;
+                if (!caveMap(x, y, z)) chunk.blocks.set(x, y, z, dirtFactory.get().instantiate());
                 ++y;
             }
             while (y < static_cast<int>(MapChunk::height()) && y <= grassLayerTop)
             {
-                chunk.blocks(x, y, z) = caveMap(x, y, z) ? m_map->instantiateAirBlock() : grassFactory.get().instantiate();
-                ++y;
-            }
-            while (y < static_cast<int>(MapChunk::height()))
-            {
-                chunk.blocks(x, y, z) = m_map->instantiateAirBlock();
+                if (!caveMap(x, y, z)) chunk.blocks.set(x, y, z, grassFactory.get().instantiate());
                 ++y;
             }
         }
@@ -0,0 +1,312 @@
+#include "map/MapOcclusionCuller.h"
+
+#include "map/MapChunk.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+MapOcclusionCuller::MapOcclusionCuller() :
+    m_cameraPosition(0.0f, 0.0f, 0.0f),
+    m_viewProjection(ls::Matrix4x4F::identity()),
+    m_stats{ 0, 0, 0, 0, 0, 0 },
+    m_rasterizationTime(Clock::duration::zero()),
+    m_testTime(Clock::duration::zero())
+{
+    int levelWidth = width;
+    int levelHeight = height;
+    for (;;)
+    {
+        m_levels.push_back(Level{ levelWidth, levelHeight, std::vector<float>(static_cast<size_t>(levelWidth) * levelHeight, 0.0f) });
+        if (levelWidth == 1 && levelHeight == 1) break;
+
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+}
+
+void MapOcclusionCuller::beginFrame(const ls::Vec3F& cameraPosition, const ls::Matrix4x4F& viewProjection)
+{
+    m_cameraPosition = cameraPosition;
+    m_viewProjection = viewProjection;
+    m_stats = Stats{ 0, 0, 0, 0, 0, 0 };
+    m_rasterizationTime = Clock::duration::zero();
+    m_testTime = Clock::duration::zero();
+
+    std::fill(m_levels[0].depth.begin(), m_levels[0].depth.end(), 0.0f);
+}
+
+void MapOcclusionCuller::addOccluder(const MapChunk& chunk)
+{
+    const ls::Box3I& box = chunk.occluderBox();
+    if (box.min == box.max) return;
+
+    const auto start = Clock::now();
+
+    const ls::Vec3F first = static_cast<ls::Vec3F>(chunk.firstBlockPosition());
+    const ls::Vec3F min = first + static_cast<ls::Vec3F>(box.min);
+    const ls::Vec3F max = first + static_cast<ls::Vec3F>(box.max);
+
+    // only the faces that look towards the camera, there are none when it's inside the box
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float plane;
+        if (m_cameraPosition[axis] < min[axis]) plane = min[axis];
+        else if (m_cameraPosition[axis] > max[axis]) plane = max[axis];
+        else continue;
+
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        std::array<ls::Vec3F, 4> corners;
+        for (int i = 0; i < 4; ++i)
+        {
+            corners[i][axis] = plane;
+            corners[i][u] = (i == 1 || i == 2) ? max[u] : min[u];
+            corners[i][v] = (i >= 2) ? max[v] : min[v];
+        }
+
+        rasterizeQuad(corners);
+        ++m_stats.numOccluderFaces;
+    }
+
+    ++m_stats.numOccluders;
+    m_rasterizationTime += Clock::now() - start;
+}
+
+void MapOcclusionCuller::finishOccluders()
+{
+    for (size_t i = 1; i < m_levels.size(); ++i)
+    {
+        const Level& source = m_levels[i - 1];
+        Level& level = m_levels[i];
+        for (int y = 0; y < level.height; ++y)
+        {
+            const int y0 = y * 2;
+            const int y1 = std::min(y0 + 1, source.height - 1);
+            for (int x = 0; x < level.width; ++x)
+            {
+                const int x0 = x * 2;
+                const int x1 = std::min(x0 + 1, source.width - 1);
+                level.depth[y * level.width + x] = std::min(
+                    std::min(source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1]),
+                    std::min(source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1])
+                );
+            }
+        }
+    }
+}
+
+bool MapOcclusionCuller::isOccluded(const MapChunk& chunk)
+{
+    const auto start = Clock::now();
+    ++m_stats.numTested;
+
+    const bool occluded = [&]() {
+        const ls::Vec3F min = static_cast<ls::Vec3F>(chunk.firstBlockPosition());
+        const ls::Vec3F max = min + ls::Vec3F(static_cast<float>(MapChunk::width()), static_cast<float>(MapChunk::height()), static_cast<float>(MapChunk::depth()));
+
+        float minX = std::numeric_limits<float>::max();
+        float minY = std::numeric_limits<float>::max();
+        float maxX = std::numeric_limits<float>::lowest();
+        float maxY = std::numeric_limits<float>::lowest();
+        // w is linear, so the nearest point of the box is one of the corners
+        float maxInvW = 0.0f;
+        for (int i = 0; i < 8; ++i)
+        {
+            const ls::Vec3F corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+            const ClipVertex clip = toClip(corner);
+            // the box reaches the camera
+            if (clip.w < m_minW) return false;
+
+            const float invW = 1.0f / clip.w;
+            const float x = (clip.x * invW * 0.5f + 0.5f) * width;
+            const float y = (clip.y * invW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+            maxInvW = std::max(maxInvW, invW);
+        }
+
+        // occluders only cover the texels whose centers they cover, one more on each side
+        // keeps the box from being seen through the part of a texel they miss
+        int x0 = std::max(static_cast<int>(std::floor(minX)) - 1, 0);
+        int y0 = std::max(static_cast<int>(std::floor(minY)) - 1, 0);
+        int x1 = std::min(static_cast<int>(std::floor(maxX)) + 1, width - 1);
+        int y1 = std::min(static_cast<int>(std::floor(maxY)) + 1, height - 1);
+        // off screen, it's for the frustum test to decide
+        if (x0 > x1 || y0 > y1) return false;
+
+        size_t levelIndex = 0;
+        while (levelIndex + 1 < m_levels.size() && (x1 - x0 >= m_maxTestedTexels || y1 - y0 >= m_maxTestedTexels))
+        {
+            ++levelIndex;
+            x0 /= 2;
+            y0 /= 2;
+            x1 /= 2;
+            y1 /= 2;
+        }
+
+        const Level& level = m_levels[levelIndex];
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                // strictly behind, so a chunk is never hidden by its own faces
+                if (level.depth[y * level.width + x] <= maxInvW) return false;
+            }
+        }
+
+        return true;
+    }();
+
+    if (occluded) ++m_stats.numOccluded;
+    m_testTime += Clock::now() - start;
+
+    return occluded;
+}
+
+MapOcclusionCuller::Stats MapOcclusionCuller::stats() const
+{
+    Stats stats = m_stats;
+    stats.rasterizationTimeUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(m_rasterizationTime).count());
+    stats.testTimeUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(m_testTime).count());
+    return stats;
+}
+
+float MapOcclusionCuller::depthAt(int x, int y) const
+{
+    return m_levels[0].depth[y * width + x];
+}
+
+MapOcclusionCuller::ClipVertex MapOcclusionCuller::toClip(const ls::Vec3F& worldPos) const
+{
+    const auto& m = m_viewProjection;
+    return ClipVertex{
+        m[0][0] * worldPos.x + m[0][1] * worldPos.y + m[0][2] * worldPos.z + m[0][3],
+        m[1][0] * worldPos.x + m[1][1] * worldPos.y + m[1][2] * worldPos.z + m[1][3],
+        m[3][0] * worldPos.x + m[3][1] * worldPos.y + m[3][2] * worldPos.z + m[3][3]
+    };
+}
+
+void MapOcclusionCuller::rasterizeQuad(const std::array<ls::Vec3F, 4>& corners)
+{
+    std::array<ClipVertex, 4> clipCorners;
+    for (int i = 0; i < 4; ++i)
+    {
+        clipCorners[i] = toClip(corners[i]);
+    }
+
+    // clipped against the near plane, x and y are only limited by the bounds of the screen later
+    std::array<ScreenVertex, m_maxPolygonVertices> polygon;
+    size_t numVertices = 0;
+    auto emit = [&polygon, &numVertices](const ClipVertex& clip) {
+        const float invW = 1.0f / clip.w;
+        polygon[numVertices++] = ScreenVertex{ (clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height, invW };
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        const ClipVertex& current = clipCorners[i];
+        const ClipVertex& next = clipCorners[(i + 1) % 4];
+        const bool isCurrentInside = current.w >= m_minW;
+        const bool isNextInside = next.w >= m_minW;
+
+        if (isCurrentInside) emit(current);
+        if (isCurrentInside != isNextInside)
+        {
+            const float t = (m_minW - current.w) / (next.w - current.w);
+            emit(ClipVertex{ current.x + (next.x - current.x) * t, current.y + (next.y - current.y) * t, m_minW });
+        }
+    }
+
+    if (numVertices >= 3)
+    {
+        rasterizePolygon(polygon.data(), numVertices);
+    }
+}
+
+void MapOcclusionCuller::rasterizePolygon(const ScreenVertex* vertices, size_t numVertices)
+{
+    // twice the signed area, the sign tells the winding
+    float area = 0.0f;
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        const ScreenVertex& a = vertices[i];
+        const ScreenVertex& b = vertices[(i + 1) % numVertices];
+        area += a.x * b.y - b.x * a.y;
+    }
+    // seen edge on
+    if (std::abs(area) < 1e-6f) return;
+    const float winding = area > 0.0f ? 1.0f : -1.0f;
+
+    // 1/w over the screen from the triangle of the first three vertices that isn't degenerate,
+    // the polygon is planar so any such triangle gives the same plane
+    const ScreenVertex& v0 = vertices[0];
+    float dInvWdX = 0.0f;
+    float dInvWdY = 0.0f;
+    bool hasPlane = false;
+    for (size_t i = 1; i + 1 < numVertices && !hasPlane; ++i)
+    {
+        const ScreenVertex& v1 = vertices[i];
+        const ScreenVertex& v2 = vertices[i + 1];
+        const float triangleArea = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (std::abs(triangleArea) < 1e-6f) continue;
+
+        dInvWdX = ((v1.invW - v0.invW) * (v2.y - v0.y) - (v2.invW - v0.invW) * (v1.y - v0.y)) / triangleArea;
+        dInvWdY = ((v2.invW - v0.invW) * (v1.x - v0.x) - (v1.invW - v0.invW) * (v2.x - v0.x)) / triangleArea;
+        hasPlane = true;
+    }
+    if (!hasPlane) return;
+
+    // the farthest depth anywhere in a texel, so the occluder is never nearer than it really is
+    const float texelSlack = 0.5f * (std::abs(dInvWdX) + std::abs(dInvWdY));
+
+    float minX = vertices[0].x;
+    float minY = vertices[0].y;
+    float maxX = vertices[0].x;
+    float maxY = vertices[0].y;
+    for (size_t i = 1; i < numVertices; ++i)
+    {
+        minX = std::min(minX, vertices[i].x);
+        minY = std::min(minY, vertices[i].y);
+        maxX = std::max(maxX, vertices[i].x);
+        maxY = std::max(maxY, vertices[i].y);
+    }
+
+    // texels whose centers are inside the bounds
+    const int x0 = std::max(static_cast<int>(std::ceil(std::max(minX, -1.0f) - 0.5f)), 0);
+    const int y0 = std::max(static_cast<int>(std::ceil(std::max(minY, -1.0f) - 0.5f)), 0);
+    const int x1 = std::min(static_cast<int>(std::floor(std::min(maxX, static_cast<float>(width)) - 0.5f)), width - 1);
+    const int y1 = std::min(static_cast<int>(std::floor(std::min(maxY, static_cast<float>(height)) - 0.5f)), height - 1);
+
+    // edge functions as a * x + b * y + c, positive inside
+    std::array<std::array<float, 3>, m_maxPolygonVertices> edges;
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        const ScreenVertex& a = vertices[i];
+        const ScreenVertex& b = vertices[(i + 1) % numVertices];
+        edges[i] = { -(b.y - a.y) * winding, (b.x - a.x) * winding, ((b.y - a.y) * a.x - (b.x - a.x) * a.y) * winding };
+    }
+
+    Level& level = m_levels[0];
+    for (int y = y0; y <= y1; ++y)
+    {
+        const float centerY = y + 0.5f;
+        float* row = &level.depth[y * width];
+        for (int x = x0; x <= x1; ++x)
+        {
+            const float centerX = x + 0.5f;
+
+            bool isInside = true;
+            for (size_t i = 0; i < numVertices; ++i)
+            {
+                isInside &= edges[i][0] * centerX + edges[i][1] * centerY + edges[i][2] >= 0.0f;
+            }
+            if (!isInside) continue;
+
+            const float invW = v0.invW + dInvWdX * (centerX - v0.x) + dInvWdY * (centerY - v0.y) - texelSlack;
+            row[x] = std::max(row[x], invW);
+        }
+    }
+}
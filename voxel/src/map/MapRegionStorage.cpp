@@ -0,0 +1,383 @@
+#include "map/MapRegionStorage.h"
+
+#include "block/Block.h"
+#include "block/BlockFactory.h"
+
+#include "ResourceManager.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+MapRegionStorage::MapRegionStorage(const std::string& directory) :
+    m_directory(directory),
+    m_mappedRegionUseCounter(0)
+{
+    std::filesystem::create_directories(m_directory);
+}
+MapRegionStorage::~MapRegionStorage()
+{
+    flush();
+}
+
+void MapRegionStorage::saveChunkAsync(const ls::Vec3I& pos, const MapChunkBlockStorage& blocks)
+{
+    auto savedBlocks = std::make_shared<const MapChunkBlockStorage>(blocks.clone());
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pendingWrites[pos] = savedBlocks;
+
+    m_writeJobs.erase(std::remove_if(m_writeJobs.begin(), m_writeJobs.end(), [](const ThreadPool::JobHandle& job) { return job.isDone(); }), m_writeJobs.end());
+    m_writeJobs.push_back(ThreadPool::instance().submit(m_writeJobPriority, [this, pos, savedBlocks]() { writePendingChunk(pos, savedBlocks); }));
+}
+bool MapRegionStorage::tryLoadChunk(const ls::Vec3I& pos, MapChunkBlockStorage& blocks)
+{
+    PROFILE_ZONE("MapRegionStorage::tryLoadChunk");
+
+    try
+    {
+        std::shared_ptr<const MemoryMappedFile> region;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto pending = m_pendingWrites.find(pos);
+            if (pending != m_pendingWrites.end())
+            {
+                blocks = pending->second->clone();
+                return true;
+            }
+
+            region = mappedRegion(regionPosOf(pos));
+        }
+        if (region == nullptr) return false;
+
+        // a chunk is never saved while it is being loaded,
+        // so its bytes don't change while they are read without the lock
+        const uint8_t* data = region->data();
+        if (region->size() < m_chunkPayloadsOffset) throw std::runtime_error("Truncated region file");
+
+        RegionHeader header;
+        std::memcpy(&header, data, sizeof(RegionHeader));
+        if (header.magic != m_magic || header.version != m_version) throw std::runtime_error("Unsupported region file");
+
+        ChunkTableEntry entry;
+        std::memcpy(&entry, data + m_chunkTableOffset + chunkIndexInRegion(pos) * sizeof(ChunkTableEntry), sizeof(ChunkTableEntry));
+        if (entry.size == 0) return false;
+        if (static_cast<size_t>(entry.offset) + entry.size > region->size()) throw std::runtime_error("Chunk outside of the region file");
+
+        decode(data + entry.offset, entry.size, blocks);
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        Logger::instance().log(Logger::Priority::Error, std::string("Could not load chunk, it will be generated: ") + e.what());
+        blocks.fill(BlockContainer());
+        return false;
+    }
+}
+
+void MapRegionStorage::flush()
+{
+    std::vector<ThreadPool::JobHandle> jobs;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        jobs = m_writeJobs;
+    }
+
+    // the jobs need the lock themselves
+    for (const auto& job : jobs)
+    {
+        job.wait();
+    }
+}
+
+void MapRegionStorage::writePendingChunk(const ls::Vec3I& pos, const std::shared_ptr<const MapChunkBlockStorage>& blocks)
+{
+    PROFILE_ZONE("MapRegionStorage::writePendingChunk");
+
+    const std::vector<uint8_t> payload = encode(*blocks);
+
+    // taken before checking the pending write, so an older save can't be written after a newer one
+    std::unique_lock<std::mutex> fileLock(m_fileMutex);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // a later save of the same chunk supersedes this one
+        auto pending = m_pendingWrites.find(pos);
+        if (pending == m_pendingWrites.end() || pending->second != blocks) return;
+    }
+
+    try
+    {
+        writeChunk(pos, payload);
+    }
+    catch (std::exception& e)
+    {
+        Logger::instance().log(Logger::Priority::Error, std::string("Could not save chunk: ") + e.what());
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // the mapping may not cover the new contents
+    m_mappedRegions.erase(regionPosOf(pos));
+
+    // loads use the pending blocks until the chunk is in the file, a later save keeps its own
+    auto pending = m_pendingWrites.find(pos);
+    if (pending != m_pendingWrites.end() && pending->second == blocks)
+    {
+        m_pendingWrites.erase(pending);
+    }
+}
+void MapRegionStorage::writeChunk(const ls::Vec3I& pos, const std::vector<uint8_t>& payload)
+{
+    const ls::Vec3I regionPos = regionPosOf(pos);
+    const std::string path = regionPath(regionPos);
+
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open())
+    {
+        std::ofstream newFile(path, std::ios::binary);
+        const RegionHeader header{ m_magic, m_version };
+        const std::vector<ChunkTableEntry> table(m_numChunksInRegion, ChunkTableEntry{ 0, 0 });
+        newFile.write(reinterpret_cast<const char*>(&header), sizeof(RegionHeader));
+        newFile.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(ChunkTableEntry));
+        newFile.close();
+
+        file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error("Could not create region file " + path);
+    }
+
+    RegionHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(RegionHeader));
+    if (!file || header.magic != m_magic || header.version != m_version) throw std::runtime_error("Unsupported region file " + path);
+
+    std::vector<ChunkTableEntry> table(m_numChunksInRegion);
+    file.seekg(m_chunkTableOffset);
+    file.read(reinterpret_cast<char*>(table.data()), table.size() * sizeof(ChunkTableEntry));
+    if (!file) throw std::runtime_error("Truncated region file " + path);
+
+    const size_t index = chunkIndexInRegion(pos);
+    const std::streamoff entryOffset = static_cast<std::streamoff>(m_chunkTableOffset + index * sizeof(ChunkTableEntry));
+    ChunkTableEntry entry = table[index];
+
+    // the old place is reused if the chunk still fits there, otherwise the space left by chunks that moved
+    if (payload.size() > entry.size)
+    {
+        entry.offset = findFreeSpace(table, index, payload.size());
+    }
+    entry.size = static_cast<uint32_t>(payload.size());
+
+    file.seekp(entry.offset);
+    file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    file.seekp(entryOffset);
+    file.write(reinterpret_cast<const char*>(&entry), sizeof(ChunkTableEntry));
+
+    if (!file) throw std::runtime_error("Could not write to region file " + path);
+}
+std::shared_ptr<const MemoryMappedFile> MapRegionStorage::mappedRegion(const ls::Vec3I& regionPos)
+{
+    auto iter = m_mappedRegions.find(regionPos);
+    if (iter != m_mappedRegions.end())
+    {
+        iter->second.lastUse = ++m_mappedRegionUseCounter;
+        return iter->second.file;
+    }
+
+    const std::string path = regionPath(regionPos);
+    if (!std::filesystem::exists(path)) return nullptr;
+
+    if (m_mappedRegions.size() >= m_maxMappedRegions)
+    {
+        auto leastRecentlyUsed = std::min_element(m_mappedRegions.begin(), m_mappedRegions.end(), [](const auto& lhs, const auto& rhs) { return lhs.second.lastUse < rhs.second.lastUse; });
+        m_mappedRegions.erase(leastRecentlyUsed);
+    }
+
+    auto region = std::make_shared<const MemoryMappedFile>(path);
+    m_mappedRegions.emplace(regionPos, MappedRegion{ region, ++m_mappedRegionUseCounter });
+    return region;
+}
+std::string MapRegionStorage::regionPath(const ls::Vec3I& regionPos) const
+{
+    return m_directory + "/r." + std::to_string(regionPos.x) + "." + std::to_string(regionPos.y) + "." + std::to_string(regionPos.z) + ".region";
+}
+
+void MapRegionStorage::decode(const uint8_t* data, size_t size, MapChunkBlockStorage& blocks)
+{
+    size_t offset = 0;
+
+    const uint16_t paletteSize = readBytes<uint16_t>(data, size, offset);
+    std::vector<const BlockFactory*> palette;
+    palette.reserve(paletteSize);
+    for (uint16_t i = 0; i < paletteSize; ++i)
+    {
+        const uint8_t nameLength = readBytes<uint8_t>(data, size, offset);
+        if (offset + nameLength > size) throw std::runtime_error("Truncated chunk payload");
+        const std::string name(reinterpret_cast<const char*>(data + offset), nameLength);
+        offset += nameLength;
+
+        // empty name is an empty container
+        palette.push_back(name.empty() ? nullptr : findBlockFactory(name));
+    }
+
+    auto instantiate = [&palette](uint16_t paletteIndex) -> BlockContainer
+    {
+        if (paletteIndex >= palette.size()) throw std::runtime_error("Palette index out of range");
+        return palette[paletteIndex] ? palette[paletteIndex]->instantiate() : BlockContainer();
+    };
+
+    const uint32_t numRuns = readBytes<uint32_t>(data, size, offset);
+    size_t blockIndex = 0;
+    for (uint32_t i = 0; i < numRuns; ++i)
+    {
+        const uint16_t paletteIndex = readBytes<uint16_t>(data, size, offset);
+        const uint16_t length = readBytes<uint16_t>(data, size, offset);
+        if (blockIndex + length > MapChunkBlockStorage::size) throw std::runtime_error("Too many blocks in chunk payload");
+
+        BlockContainer block = instantiate(paletteIndex);
+        const bool isStateless = !block.isStateful();
+        if (numRuns == 1 && isStateless)
+        {
+            // stays uniform
+            blocks.fill(std::move(block));
+            blockIndex += length;
+            continue;
+        }
+
+        for (uint16_t j = 0; j < length; ++j, ++blockIndex)
+        {
+            const size_t x = blockIndex / (MapChunkBlockStorage::height * MapChunkBlockStorage::depth);
+            const size_t y = blockIndex / MapChunkBlockStorage::depth % MapChunkBlockStorage::height;
+            const size_t z = blockIndex % MapChunkBlockStorage::depth;
+            blocks.set(x, y, z, isStateless ? BlockContainer(block) : instantiate(paletteIndex));
+        }
+    }
+
+    if (blockIndex != MapChunkBlockStorage::size) throw std::runtime_error("Too few blocks in chunk payload");
+}
+const BlockFactory* MapRegionStorage::findBlockFactory(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(m_blockFactoryMutex);
+
+    auto iter = m_blockFactories.find(name);
+    if (iter != m_blockFactories.end()) return iter->second;
+
+    const ResourceHandle<BlockFactory> handle = ResourceManager<BlockFactory>::instance().get(name);
+    const BlockFactory* factory = handle.operator->();
+    if (factory == nullptr) throw std::runtime_error("Unknown block " + name + " in chunk payload");
+
+    m_blockFactories.emplace(name, factory);
+    return factory;
+}
+
+ls::Vec3I MapRegionStorage::regionPosOf(const ls::Vec3I& chunkPos)
+{
+    // rounds towards negative infinity
+    auto floorDiv = [](int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); };
+
+    return ls::Vec3I(floorDiv(chunkPos.x, m_regionWidth), floorDiv(chunkPos.y, m_regionHeight), floorDiv(chunkPos.z, m_regionDepth));
+}
+size_t MapRegionStorage::chunkIndexInRegion(const ls::Vec3I& chunkPos)
+{
+    const ls::Vec3I regionPos = regionPosOf(chunkPos);
+    const ls::Vec3I localPos = chunkPos - regionPos * ls::Vec3I(m_regionWidth, m_regionHeight, m_regionDepth);
+
+    return (static_cast<size_t>(localPos.x) * m_regionHeight + localPos.y) * m_regionDepth + localPos.z;
+}
+uint32_t MapRegionStorage::findFreeSpace(const std::vector<ChunkTableEntry>& table, size_t skippedIndex, size_t size)
+{
+    std::vector<ChunkTableEntry> used;
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        if (i != skippedIndex && table[i].size != 0) used.push_back(table[i]);
+    }
+    std::sort(used.begin(), used.end(), [](const ChunkTableEntry& lhs, const ChunkTableEntry& rhs) { return lhs.offset < rhs.offset; });
+
+    // past the last chunk when no gap is big enough, space freed at the end of the file is reused too
+    size_t offset = m_chunkPayloadsOffset;
+    for (const auto& entry : used)
+    {
+        if (entry.offset >= offset + size) break;
+        offset = std::max(offset, static_cast<size_t>(entry.offset) + entry.size);
+    }
+
+    return static_cast<uint32_t>(offset);
+}
+std::vector<uint8_t> MapRegionStorage::encode(const MapChunkBlockStorage& blocks)
+{
+    static_assert(MapChunkBlockStorage::size <= 0xFFFF, "a run has to fit in 16 bits");
+
+    // blocks are identified by the factory, state is not kept
+    std::vector<const BlockFactory*> palette;
+    std::vector<std::pair<uint16_t, uint16_t>> runs;
+
+    const Block* previousBlock = nullptr;
+    uint16_t previousPaletteIndex = 0;
+    for (size_t x = 0; x < MapChunkBlockStorage::width; ++x)
+    {
+        for (size_t y = 0; y < MapChunkBlockStorage::height; ++y)
+        {
+            for (size_t z = 0; z < MapChunkBlockStorage::depth; ++z)
+            {
+                const auto& blockCont = blocks.at(x, y, z);
+                const Block* block = blockCont.isEmpty() ? nullptr : &blockCont.block();
+
+                uint16_t paletteIndex = previousPaletteIndex;
+                if (block != previousBlock || runs.empty())
+                {
+                    const BlockFactory* factory = block ? &block->factory() : nullptr;
+                    auto iter = std::find(palette.begin(), palette.end(), factory);
+                    paletteIndex = static_cast<uint16_t>(iter - palette.begin());
+                    if (iter == palette.end()) palette.push_back(factory);
+
+                    previousBlock = block;
+                    previousPaletteIndex = paletteIndex;
+                }
+
+                if (!runs.empty() && runs.back().first == paletteIndex) ++runs.back().second;
+                else runs.emplace_back(paletteIndex, 1);
+            }
+        }
+    }
+
+    std::vector<uint8_t> bytes;
+    appendBytes(bytes, static_cast<uint16_t>(palette.size()));
+    for (const BlockFactory* factory : palette)
+    {
+        const std::string name = factory ? factory->name() : std::string();
+        if (name.size() > 0xFF) throw std::runtime_error("Block name " + name + " is too long to be saved");
+
+        appendBytes(bytes, static_cast<uint8_t>(name.size()));
+        bytes.insert(bytes.end(), name.begin(), name.end());
+    }
+
+    appendBytes(bytes, static_cast<uint32_t>(runs.size()));
+    for (const auto& run : runs)
+    {
+        appendBytes(bytes, run.first);
+        appendBytes(bytes, run.second);
+    }
+
+    return bytes;
+}
+
+template <class T>
+void MapRegionStorage::appendBytes(std::vector<uint8_t>& bytes, const T& value)
+{
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(&value);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+template <class T>
+T MapRegionStorage::readBytes(const uint8_t* data, size_t size, size_t& offset)
+{
+    if (offset + sizeof(T) > size) throw std::runtime_error("Truncated chunk payload");
+
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return value;
+}
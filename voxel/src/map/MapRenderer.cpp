@@ -4,33 +4,46 @@
 #include "map/Map.h"
 #include "map/MapChunkRenderQueue.h"
 
+#include "Profiler.h"
+
 #include "../LibS/OpenGL/Camera.h"
 #include "../LibS/Shapes/Vec3.h"
 #include "../LibS/Shapes/Plane3.h"
 #include "../LibS/Shapes/Frustum3.h"
 #include "../LibS/Shapes/Sphere3.h"
+#include "../LibS/Collisions/FrustumCulling3.h"
 
 #include "ResourceManager.h"
 #include "sprite/Spritesheet.h"
 
-MapRenderer::MapRenderer()
+MapRenderer::MapRenderer() :
+    m_lastDrawStats{ 0, 0, 0, 0 },
+    m_visibilityFloodFill(m_maxDistanceToRenderedChunk)
 {
-    m_texture = &(ResourceManager<Spritesheet>::instance().get("Spritesheet").get().texture());
+    const Spritesheet& spritesheet = ResourceManager<Spritesheet>::instance().get("Spritesheet").get();
+    m_texture = &(spritesheet.texture());
     m_shader = &(ResourceManager<ls::gl::ShaderProgram>::instance().get("Terrain").get());
     m_uModelViewProjection = m_shader->uniformView("uModelViewProjection");    
     m_shader->uniformView("tex0").set(0);
+    m_shader->uniformView("uChunkOrigins").set(static_cast<int>(m_chunkOriginsTextureUnit - GL_TEXTURE0));
+    m_shader->uniformView("uVerticesPerChunkOrigin").set(static_cast<int>(MapChunkMeshArena::vertexGranularity));
+    m_shader->uniformView("uTileSize").set(spritesheet.gridSizeToTexSizeF({ 1, 1 }));
+    m_shader->uniformView("uTileStride").set(spritesheet.gridCoordsToTexCoordsF({ 1, 1 }));
 }
 void MapRenderer::draw(Map& map, const ls::gl::Camera& camera, float dt)
 {
+    PROFILE_ZONE("MapRenderer::draw");
+
     glEnable(GL_DEPTH_TEST);    
     glDepthFunc(GL_LEQUAL);
     glEnable(GL_CULL_FACE);
     
     m_texture->bind(GL_TEXTURE0);
     m_shader->bind();
-    m_uModelViewProjection.set(camera.projectionMatrix() * camera.viewMatrix());
+    const ls::Matrix4x4F viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+    m_uModelViewProjection.set(viewProjection);
     
-    ls::Frustum3F frustum = ls::Frustum3F::fromMatrix(camera.projectionMatrix() * camera.viewMatrix());
+    ls::Frustum3F frustum = ls::Frustum3F::fromMatrix(viewProjection);
     for (auto& p : frustum.planes)
     {
         p.normalize();
@@ -38,34 +51,86 @@ void MapRenderer::draw(Map& map, const ls::gl::Camera& camera, float dt)
 
     const ls::Vec3I cameraChunk = map.worldToChunk(camera.position());
 
-    MapChunkRenderQueue queue(m_maxDistanceToRenderedChunk);
-    for (auto& p : map.chunks())
+    m_renderQueue.beginFrame(camera.position());
+    m_visibilityFloodFill.beginFrame(cameraChunk);
+    m_occlusionCuller.beginFrame(camera.position(), viewProjection);
+    m_chunksInFrustum.clear();
+
+    // all bounding spheres are tested at once, the indices come in iteration order
+    m_chunkIndicesInFrustum.resize(map.chunks().size());
+    const size_t numChunksInFrustum = ls::cullSpheres(frustum, map.chunks().boundingSpheres(), m_chunkIndicesInFrustum.data());
+    size_t nextChunkInFrustum = 0;
+    uint32_t chunkIndex = 0;
+    for (auto& chunk : map.chunks())
     {
-        auto& chunk = p.second;
+        const bool isInFrustum = nextChunkInFrustum < numChunksInFrustum && m_chunkIndicesInFrustum[nextChunkInFrustum] == chunkIndex;
+        if (isInFrustum) ++nextChunkInFrustum;
+        ++chunkIndex;
+
         const int dist = Map::distanceBetweenChunks(cameraChunk, chunk.pos());
         if (shouldForgetChunk(chunk, dist))
         {
             chunk.tooFarToDraw(dt);
         }
-        else if(shouldDrawChunk(camera, frustum, chunk))
+        else if(isInFrustum)
         {
-            queue.enqueueDraw(chunk, dist);
+            // occluded chunks are kept as recently seen, they may show up again with any step
+            map.markChunkVisible(chunk.pos());
+            m_chunksInFrustum.emplace_back(&chunk);
+            m_visibilityFloodFill.addChunk(chunk);
+            if (dist <= MapOcclusionCuller::maxOccluderDistance)
+            {
+                m_occlusionCuller.addOccluder(chunk);
+            }
         }
         else
         {
-            queue.enqueueCull(chunk);
+            m_renderQueue.enqueueCull(chunk);
         }
     }
+    m_visibilityFloodFill.run(frustum);
+    m_occlusionCuller.finishOccluders();
 
-    queue.draw(dt);
+    // occluded chunks still get their meshes updated, like the ones outside of the frustum,
+    // but the ones that can't be seen from the camera chunk at all don't
+    for (MapChunk* chunk : m_chunksInFrustum)
+    {
+        if (!m_visibilityFloodFill.isReached(*chunk))
+        {
+            chunk->unreached(dt);
+        }
+        else if (m_occlusionCuller.isOccluded(*chunk))
+        {
+            m_renderQueue.enqueueCull(*chunk);
+        }
+        else
+        {
+            m_renderQueue.enqueueDraw(*chunk);
+        }
+    }
+
+    m_lastDrawStats = m_renderQueue.draw(dt, m_chunkOriginsTextureUnit);
 
     //std::cout << "Rendered chunks: " << numRenderedChunks << '/' << map.chunks().size() << '\n';
 }
 
-bool MapRenderer::shouldDrawChunk(const ls::gl::Camera& camera, const ls::Frustum3F& frustum, const MapChunk& chunk)
+size_t MapRenderer::numDrawnVertices() const
+{
+    return m_lastDrawStats.numDrawnVertices;
+}
+const MapChunkRenderQueue::DrawStats& MapRenderer::lastDrawStats() const
 {
-    return intersect(frustum, chunk.boundingSphere());
+    return m_lastDrawStats;
 }
+MapOcclusionCuller::Stats MapRenderer::lastOcclusionStats() const
+{
+    return m_occlusionCuller.stats();
+}
+const MapVisibilityFloodFill::Stats& MapRenderer::lastVisibilityStats() const
+{
+    return m_visibilityFloodFill.stats();
+}
+
 bool MapRenderer::shouldForgetChunk(const MapChunk& chunk, int dist)
 {
     return dist > m_maxDistanceToRenderedChunk;
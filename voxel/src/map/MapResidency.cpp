@@ -0,0 +1,100 @@
+#include "map/MapResidency.h"
+
+size_t MapChunkMemoryUsage::total() const
+{
+    return blocks + opacity + cpuMesh + gpuMesh;
+}
+
+bool MapChunkMemoryUsage::operator==(const MapChunkMemoryUsage& other) const
+{
+    return blocks == other.blocks && opacity == other.opacity && cpuMesh == other.cpuMesh && gpuMesh == other.gpuMesh;
+}
+bool MapChunkMemoryUsage::operator!=(const MapChunkMemoryUsage& other) const
+{
+    return !(*this == other);
+}
+MapChunkMemoryUsage& MapChunkMemoryUsage::operator+=(const MapChunkMemoryUsage& other)
+{
+    blocks += other.blocks;
+    opacity += other.opacity;
+    cpuMesh += other.cpuMesh;
+    gpuMesh += other.gpuMesh;
+
+    return *this;
+}
+MapChunkMemoryUsage& MapChunkMemoryUsage::operator-=(const MapChunkMemoryUsage& other)
+{
+    blocks -= other.blocks;
+    opacity -= other.opacity;
+    cpuMesh -= other.cpuMesh;
+    gpuMesh -= other.gpuMesh;
+
+    return *this;
+}
+
+MapResidency::MapResidency(size_t budget) :
+    m_resident{ 0, 0, 0, 0 },
+    m_budget(budget),
+    m_numEvictedChunks(0)
+{
+}
+
+void MapResidency::setBudget(size_t budget)
+{
+    m_budget = budget;
+}
+size_t MapResidency::budget() const
+{
+    return m_budget;
+}
+bool MapResidency::isOverBudget() const
+{
+    return m_resident.total() > m_budget;
+}
+
+void MapResidency::add(const ls::Vec3I& pos, const MapChunkMemoryUsage& usage)
+{
+    m_recency.push_front(pos);
+    m_entries.emplace(pos, m_recency.begin());
+    m_resident += usage;
+}
+void MapResidency::remove(const ls::Vec3I& pos, const MapChunkMemoryUsage& usage)
+{
+    auto iter = m_entries.find(pos);
+    if (iter == m_entries.end()) return;
+
+    m_recency.erase(iter->second);
+    m_entries.erase(iter);
+    m_resident -= usage;
+}
+void MapResidency::update(const ls::Vec3I& pos, const MapChunkMemoryUsage& previousUsage, const MapChunkMemoryUsage& usage)
+{
+    if (m_entries.find(pos) == m_entries.end()) return;
+
+    m_resident -= previousUsage;
+    m_resident += usage;
+}
+void MapResidency::markVisible(const ls::Vec3I& pos)
+{
+    auto iter = m_entries.find(pos);
+    if (iter == m_entries.end()) return;
+
+    m_recency.splice(m_recency.begin(), m_recency, iter->second);
+}
+
+bool MapResidency::leastRecentlyVisible(ls::Vec3I& pos) const
+{
+    if (m_recency.empty()) return false;
+
+    pos = m_recency.back();
+    return true;
+}
+void MapResidency::onEvicted()
+{
+    ++m_numEvictedChunks;
+}
+
+MapResidency::Stats MapResidency::stats() const
+{
+    return Stats{ m_resident, m_entries.size(), m_budget, m_numEvictedChunks };
+}
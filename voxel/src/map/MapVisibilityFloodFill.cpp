@@ -0,0 +1,136 @@
+#include "map/MapVisibilityFloodFill.h"
+
+#include "map/MapChunk.h"
+#include "map/Map.h"
+
+#include "CubeSide.h"
+
+#include "../LibS/Collisions/FrustumCulling3.h"
+
+#include <algorithm>
+#include <chrono>
+
+MapVisibilityFloodFill::MapVisibilityFloodFill(int maxDistance) :
+    m_maxDistance(maxDistance),
+    m_gridSize(maxDistance * 2 + 1),
+    m_cameraChunk(0, 0, 0),
+    m_reachesAll(true),
+    m_cells(static_cast<size_t>(m_gridSize) * m_gridSize * m_gridSize),
+    m_stats{ 0, 0, 0, 0 }
+{
+}
+
+void MapVisibilityFloodFill::beginFrame(const ls::Vec3I& cameraChunk)
+{
+    m_cameraChunk = cameraChunk;
+    m_reachesAll = true;
+    m_stats = Stats{ 0, 0, 0, 0 };
+
+    for (auto& cell : m_cells)
+    {
+        cell.chunk = nullptr;
+        cell.walkedDirections.fill(m_notEntered);
+        cell.isReached = false;
+    }
+}
+
+void MapVisibilityFloodFill::addChunk(const MapChunk& chunk)
+{
+    const int index = cellIndex(chunk.pos() - m_cameraChunk + ls::Vec3I(m_maxDistance, m_maxDistance, m_maxDistance));
+    if (index < 0) return;
+
+    m_cells[index].chunk = &chunk;
+    ++m_stats.numCandidates;
+}
+
+void MapVisibilityFloodFill::run(const ls::Frustum3F& frustum)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const ls::Vec3I cameraCell(m_maxDistance, m_maxDistance, m_maxDistance);
+    Cell& cameraCellData = m_cells[cellIndex(cameraCell)];
+    m_reachesAll = cameraCellData.chunk == nullptr;
+    if (m_reachesAll)
+    {
+        m_stats.numReached = m_stats.numCandidates;
+        return;
+    }
+
+    // the camera can be anywhere in its chunk, so all of its faces are open
+    m_visits.clear();
+    m_visits.push_back(Visit{ cameraCell, m_noSide, 0 });
+    cameraCellData.isReached = true;
+    m_stats.numReached = 1;
+
+    // breadth first, visits are appended while iterating
+    for (size_t i = 0; i < m_visits.size(); ++i)
+    {
+        const Visit visit = m_visits[i];
+        const Cell& cell = m_cells[cellIndex(visit.cell)];
+        ++m_stats.numVisits;
+
+        for (const auto& side : CubeSide::values())
+        {
+            if ((visit.walkedDirections >> side.opposite().ordinal()) & 1u) continue;
+            // cells without a chunk connect all of their faces
+            if (visit.entrySide != m_noSide && cell.chunk != nullptr && !cell.chunk->faceConnectivity().areConnected(CubeSide::values()[visit.entrySide], side)) continue;
+
+            const ls::Vec3I nextCell = visit.cell + side.direction();
+            const int nextIndex = cellIndex(nextCell);
+            if (nextIndex < 0) continue;
+
+            Cell& next = m_cells[nextIndex];
+            if (next.chunk == nullptr && !isWalkableWithoutChunk(nextCell, frustum)) continue;
+
+            // a walk with fewer directions taken can go anywhere a walk with more of them can,
+            // so a face is walked again only when some direction is no longer taken,
+            // merging the walks keeps the number of visits bounded and only reaches more
+            // without a chunk the face doesn't matter, all walks through the cell are merged
+            const int entrySide = side.opposite().ordinal();
+            uint8_t& walked = next.walkedDirections[next.chunk != nullptr ? entrySide : 0];
+            const uint8_t merged = walked & static_cast<uint8_t>(visit.walkedDirections | (1u << side.ordinal()));
+            if (merged == walked) continue;
+
+            walked = merged;
+            if (next.chunk != nullptr && !next.isReached)
+            {
+                next.isReached = true;
+                ++m_stats.numReached;
+            }
+            m_visits.push_back(Visit{ nextCell, entrySide, merged });
+        }
+    }
+
+    m_stats.timeUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+bool MapVisibilityFloodFill::isReached(const MapChunk& chunk) const
+{
+    if (m_reachesAll) return true;
+
+    const int index = cellIndex(chunk.pos() - m_cameraChunk + ls::Vec3I(m_maxDistance, m_maxDistance, m_maxDistance));
+    if (index < 0) return false;
+
+    const Cell& cell = m_cells[index];
+    return cell.isReached && cell.chunk == &chunk;
+}
+
+const MapVisibilityFloodFill::Stats& MapVisibilityFloodFill::stats() const
+{
+    return m_stats;
+}
+
+int MapVisibilityFloodFill::cellIndex(const ls::Vec3I& cell) const
+{
+    if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= m_gridSize || cell.y >= m_gridSize || cell.z >= m_gridSize) return -1;
+
+    return (cell.x * m_gridSize + cell.y) * m_gridSize + cell.z;
+}
+bool MapVisibilityFloodFill::isWalkableWithoutChunk(const ls::Vec3I& cell, const ls::Frustum3F& frustum) const
+{
+    // the whole grid is within the loading range, so only the height of the world limits what can be loaded
+    const ls::Vec3I pos = cell + m_cameraChunk - ls::Vec3I(m_maxDistance, m_maxDistance, m_maxDistance);
+    if (!Map::isValidChunkPos(pos)) return false;
+
+    return ls::isSphereInFrustum(frustum, MapChunk::computeBoundingSphere(pos));
+}
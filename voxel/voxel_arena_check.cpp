@@ -0,0 +1,184 @@
+// Check of the chunk mesh arena against a real GL context: placement of meshes in pages,
+// in place uploads, the data that ends up in the buffers, drawing and shutdown.
+// Only opens a hidden context, without a GPU it runs on Mesa, e.g. LIBGL_ALWAYS_SOFTWARE=1 xvfb-run voxel_arena_check
+// Has to be run from the directory with the assets, failures are written to stderr and the exit code is 1.
+// usage: voxel_arena_check
+
+#include "map/MapChunkMeshArena.h"
+
+#include "ShaderResourceLoader.h"
+
+#include <SFML/Window.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace
+{
+    using Allocation = MapChunkMeshArena::Allocation;
+
+    constexpr GLenum chunkOriginsTextureUnit = GL_TEXTURE1;
+
+    int numFailures = 0;
+
+    void check(bool condition, const std::string& what)
+    {
+        if (condition) return;
+
+        std::cerr << "failed: " << what << '\n';
+        ++numFailures;
+    }
+
+    // quads with vertices that differ between meshes of different seeds
+    struct Mesh
+    {
+        std::vector<BlockVertex> vertices;
+        std::vector<uint32_t> indices;
+
+        Mesh(size_t numQuads, int seed)
+        {
+            for (size_t i = 0; i < numQuads; ++i)
+            {
+                const int x = static_cast<int>(i % 32);
+                const int y = static_cast<int>(i / 32 % 32);
+                const int z = static_cast<int>(i / 1024 % 32);
+                const ls::Vec2I tile(seed, static_cast<int>(i / 32768));
+                const uint32_t firstVertex = static_cast<uint32_t>(vertices.size());
+
+                vertices.emplace_back(ls::Vec3I(x, y, z), ls::Vec2I(0, 0), tile);
+                vertices.emplace_back(ls::Vec3I(x + 1, y, z), ls::Vec2I(1, 0), tile);
+                vertices.emplace_back(ls::Vec3I(x + 1, y + 1, z), ls::Vec2I(1, 1), tile);
+                vertices.emplace_back(ls::Vec3I(x, y + 1, z), ls::Vec2I(0, 1), tile);
+                indices.insert(indices.end(), { firstVertex, firstVertex + 1, firstVertex + 2, firstVertex, firstVertex + 2, firstVertex + 3 });
+            }
+        }
+    };
+
+    void checkContents(const MapChunkMeshArena& arena, const Allocation& allocation, const Mesh& mesh, const ls::Vec3I& chunkOrigin, const std::string& name)
+    {
+        std::vector<BlockVertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<ls::Vec3I> chunkOrigins;
+        arena.readBack(allocation, vertices, indices, chunkOrigins);
+
+        bool areVerticesEqual = vertices.size() == mesh.vertices.size();
+        for (size_t i = 0; areVerticesEqual && i < vertices.size(); ++i)
+        {
+            areVerticesEqual = vertices[i].packedPosUv == mesh.vertices[i].packedPosUv && vertices[i].packedTile == mesh.vertices[i].packedTile;
+        }
+        check(areVerticesEqual, name + ": vertices read back");
+        check(indices == mesh.indices, name + ": indices read back");
+
+        bool areOriginsEqual = chunkOrigins.size() == allocation.vertices.size / MapChunkMeshArena::vertexGranularity;
+        for (const auto& origin : chunkOrigins)
+        {
+            areOriginsEqual = areOriginsEqual && origin == chunkOrigin;
+        }
+        check(areOriginsEqual, name + ": chunk origins read back");
+    }
+
+    // primitives are counted before clipping, so nothing has to be visible
+    GLuint countDrawnTriangles(MapChunkMeshArena& arena, const MapChunkMeshArena::DrawList& meshes, MapChunkMeshArena::DrawStats& drawStats)
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+        drawStats = arena.draw(meshes, chunkOriginsTextureUnit);
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+
+        GLuint numTriangles = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &numTriangles);
+        glDeleteQueries(1, &query);
+
+        return numTriangles;
+    }
+
+    void run()
+    {
+        MapChunkMeshArena& arena = MapChunkMeshArena::instance();
+        check(arena.stats().numPages == 0, "no pages before the first upload");
+
+        // small meshes share the first page
+        const Mesh small(100, 1);
+        const Mesh other(200, 2);
+        Allocation smallAllocation = arena.upload(small.vertices, small.indices, { 0, 0, 0 }, Allocation::makeInvalid());
+        Allocation otherAllocation = arena.upload(other.vertices, other.indices, { 32, 0, -32 }, Allocation::makeInvalid());
+        check(smallAllocation.page == 0 && otherAllocation.page == 0, "small meshes are placed in the first page");
+        check(arena.stats().numPages == 1, "small meshes use a single page");
+        // known once the first page exists
+        std::cout << (arena.usesMultiDrawIndirect() ? "multi draw indirect" : "multi draw base vertex") << '\n';
+        checkContents(arena, smallAllocation, small, { 0, 0, 0 }, "small mesh");
+        checkContents(arena, otherAllocation, other, { 32, 0, -32 }, "other mesh");
+
+        // a mesh bigger than a page gets a page of its own
+        const Mesh big(MapChunkMeshArena::verticesPerPage / 4 + 1, 3);
+        Allocation bigAllocation = arena.upload(big.vertices, big.indices, { -64, 96, 0 }, Allocation::makeInvalid());
+        check(bigAllocation.page != 0, "a mesh bigger than a page gets its own page");
+        check(arena.stats().numPages == 2, "a page is added for the big mesh");
+        checkContents(arena, bigAllocation, big, { -64, 96, 0 }, "big mesh");
+
+        // a slightly smaller mesh reuses the range
+        const Mesh shrunk(90, 4);
+        const Allocation previousSmallAllocation = smallAllocation;
+        const uint64_t numInPlaceUploads = arena.stats().numInPlaceUploads;
+        smallAllocation = arena.upload(shrunk.vertices, shrunk.indices, { 0, 32, 0 }, smallAllocation);
+        check(smallAllocation.page == previousSmallAllocation.page
+            && smallAllocation.vertices.offset == previousSmallAllocation.vertices.offset
+            && smallAllocation.indices.offset == previousSmallAllocation.indices.offset, "a smaller mesh is uploaded in place");
+        check(arena.stats().numInPlaceUploads == numInPlaceUploads + 1, "in place uploads are counted");
+        checkContents(arena, smallAllocation, shrunk, { 0, 32, 0 }, "mesh uploaded in place");
+        checkContents(arena, otherAllocation, other, { 32, 0, -32 }, "mesh next to the one uploaded in place");
+
+        // every mesh is drawn whole, with one draw call per page
+        auto shader = ResourceLoader<ls::gl::ShaderProgram>::load("assets/shaders/terrain.vert", "assets/shaders/terrain.frag").second;
+        check(shader != nullptr, "terrain shader loads");
+        if (shader != nullptr)
+        {
+            shader->bind();
+            shader->uniformView("uChunkOrigins").set(static_cast<int>(chunkOriginsTextureUnit - GL_TEXTURE0));
+            shader->uniformView("uVerticesPerChunkOrigin").set(static_cast<int>(MapChunkMeshArena::vertexGranularity));
+
+            MapChunkMeshArena::DrawStats drawStats{};
+            const GLuint numTriangles = countDrawnTriangles(arena, { smallAllocation, otherAllocation, bigAllocation }, drawStats);
+            check(glGetError() == GL_NO_ERROR, "drawing raises no GL error");
+            check(drawStats.numDrawCalls == 2 && drawStats.numMeshes == 3, "meshes are drawn with one call per page");
+            check(numTriangles == (shrunk.indices.size() + other.indices.size() + big.indices.size()) / 3, "all triangles of the meshes are drawn");
+        }
+
+        // only pages other than the first are dropped when empty
+        arena.free(bigAllocation);
+        check(arena.stats().numPages == 1, "the page of the big mesh is dropped");
+        arena.free(smallAllocation);
+        check(arena.stats().numPages == 1, "the first page is kept");
+
+        arena.shutdown();
+        check(arena.stats().numPages == 0, "shutdown deletes all pages");
+        arena.free(otherAllocation);
+        check(!otherAllocation.isValid() && arena.stats().numPages == 0, "allocations freed after shutdown are ignored");
+        check(glGetError() == GL_NO_ERROR, "shutdown raises no GL error");
+    }
+}
+
+int main()
+{
+    // the context is destroyed at the end of the scope, after the arena shut down
+    {
+        sf::Context context(sf::ContextSettings(24, 8, 0, 3, 3), 1, 1);
+        glewInit();
+
+        std::cout << "GL " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << '\n';
+
+        run();
+    }
+
+    if (numFailures > 0)
+    {
+        std::cerr << numFailures << " checks failed\n";
+        return 1;
+    }
+
+    std::cout << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,965 @@
+// Headless benchmark of the world pipeline, doesn't open a window or need a GL context.
+// Measures the batched noise, the frustum culling and the chunk index, then runs generation, opacity, snapshots, meshing and region storage on a grid of chunks,
+// then streams the map along a scripted camera path and replays a camera path through the visibility and occlusion culling.
+// Has to be run from the directory with the assets, the results are written to stdout as json.
+// usage: voxel_bench [seed] [numTicks] [memoryBudgetMiB] [cameraPath]
+// camera paths are recorded in the game with F11, a built-in one is used when none is given
+
+#include "map/Map.h"
+#include "map/MapChunk.h"
+#include "map/MapChunkIndex.h"
+#include "map/MapChunkSnapshot.h"
+#include "map/MapChunkStorageReserve.h"
+#include "map/MapChunkRenderer.h"
+#include "map/MapChunkMeshArena.h"
+#include "map/MapGenerator.h"
+#include "map/MapRegionStorage.h"
+#include "map/MapOcclusionCuller.h"
+#include "map/MapVisibilityFloodFill.h"
+#include "map/MapRenderer.h"
+
+#include "block/Block.h"
+#include "block/BlockMemoryPool.h"
+
+#include "GameResourceLoader.h"
+#include "CameraPath.h"
+#include "Logger.h"
+
+#include "LibS/Json.h"
+#include "LibS/Noise/BatchedSimplexNoise.h"
+#include "LibS/OpenGL/Camera.h"
+#include "LibS/Shapes/Frustum3.h"
+#include "LibS/Shapes/SphereArray3.h"
+#include "LibS/Collisions/FrustumCulling3.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <set>
+#include <map>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int gridSize = 8; // columns of chunks along x and z
+    constexpr int worldHeightInChunks = 8;
+    constexpr float tickTime = 1.0f / 20.0f; // same as the game
+    constexpr float cameraSpeed = 64.0f;
+    constexpr float cameraHeight = 100.0f;
+    // same as the game
+    constexpr int renderDistance = 12;
+    constexpr float cameraFov = 45.0f;
+    constexpr float cameraAspect = 1024.0f / 768.0f;
+
+    struct StageStats
+    {
+        std::string name;
+        std::vector<double> samples; // in microseconds
+        uint64_t numChunks = 0;
+        uint64_t numFaces = 0;
+
+        explicit StageStats(std::string n) :
+            name(std::move(n))
+        {
+        }
+
+        // returns the duration in microseconds
+        template <class Func>
+        double measure(Func&& func)
+        {
+            const auto start = Clock::now();
+            func();
+            const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            samples.push_back(us);
+            return us;
+        }
+
+        double total() const
+        {
+            double sum = 0.0;
+            for (double s : samples) sum += s;
+            return sum;
+        }
+
+        ls::json::Value toJson() const
+        {
+            std::vector<double> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            const double totalUs = total();
+
+            ls::json::Value result(ls::json::Value::Object{});
+            result.addMember("samples", ls::json::Value(static_cast<int64_t>(sorted.size())));
+            result.addMember("p50Us", ls::json::Value(percentile(sorted, 0.5)));
+            result.addMember("p99Us", ls::json::Value(percentile(sorted, 0.99)));
+            result.addMember("meanUs", ls::json::Value(sorted.empty() ? 0.0 : totalUs / sorted.size()));
+            result.addMember("totalUs", ls::json::Value(totalUs));
+            if (numChunks > 0)
+            {
+                result.addMember("chunks", ls::json::Value(static_cast<int64_t>(numChunks)));
+                result.addMember("chunksPerSec", ls::json::Value(perSecond(numChunks, totalUs)));
+            }
+            if (numFaces > 0)
+            {
+                result.addMember("faces", ls::json::Value(static_cast<int64_t>(numFaces)));
+                result.addMember("facesPerSec", ls::json::Value(perSecond(numFaces, totalUs)));
+            }
+            return result;
+        }
+
+        static double percentile(const std::vector<double>& sorted, double p)
+        {
+            if (sorted.empty()) return 0.0;
+
+            const size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+            return sorted[std::min(i, sorted.size() - 1)];
+        }
+
+        static double perSecond(uint64_t count, double us)
+        {
+            if (us <= 0.0) return 0.0;
+
+            return static_cast<double>(count) * 1e6 / us;
+        }
+    };
+
+    size_t peakResidentSetSize()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024u; // in kilobytes on linux
+#endif
+#endif
+    }
+
+    size_t numFaces(const MapChunkRenderer::Mesh& mesh)
+    {
+        return mesh.indices.size() / 6;
+    }
+
+    // raw throughput of the batched noise in both modes, the results have to be bit-for-bit the same
+    template <class VecF, class VecI>
+    ls::json::Value benchNoiseGrid(uint32_t seed, const VecI& size, size_t numPoints, int numGrids)
+    {
+        ls::BatchedSimplexNoise noise(seed);
+        std::vector<float> vectorResult(numPoints);
+        std::vector<float> scalarResult(numPoints);
+
+        StageStats vectorStats("vector");
+        StageStats scalarStats("scalar");
+        bool isBitExact = true;
+        for (int i = 0; i < numGrids; ++i)
+        {
+            const VecF origin(static_cast<float>(i) * 13.37f - 1000.0f);
+            const VecF step(0.04f);
+
+            noise.setMode(ls::BatchedSimplexNoise::Mode::Vector);
+            vectorStats.measure([&]() { noise.rawGrid(origin, step, size, vectorResult.data()); });
+
+            noise.setMode(ls::BatchedSimplexNoise::Mode::Scalar);
+            scalarStats.measure([&]() { noise.rawGrid(origin, step, size, scalarResult.data()); });
+
+            isBitExact = isBitExact && std::memcmp(vectorResult.data(), scalarResult.data(), numPoints * sizeof(float)) == 0;
+        }
+
+        const double vectorSamplesPerSec = StageStats::perSecond(numPoints * numGrids, vectorStats.total());
+        const double scalarSamplesPerSec = StageStats::perSecond(numPoints * numGrids, scalarStats.total());
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("points", ls::json::Value(static_cast<int64_t>(numPoints)));
+        result.addMember("vectorSamplesPerSec", ls::json::Value(vectorSamplesPerSec));
+        result.addMember("scalarSamplesPerSec", ls::json::Value(scalarSamplesPerSec));
+        result.addMember("speedup", ls::json::Value(scalarSamplesPerSec > 0.0 ? vectorSamplesPerSec / scalarSamplesPerSec : 0.0));
+        result.addMember("bitExact", ls::json::Value(isBitExact));
+        return result;
+    }
+
+    ls::json::Value benchNoise(uint32_t seed)
+    {
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("laneWidth", ls::json::Value(static_cast<int64_t>(ls::BatchedSimplexNoise::laneWidth())));
+        result.addMember("grid2", benchNoiseGrid<ls::Vec2F>(seed, ls::Vec2I(32, 32), 32 * 32, 2048));
+        result.addMember("grid3", benchNoiseGrid<ls::Vec3F>(seed, ls::Vec3I(32, 32, 32), 32 * 32 * 32, 64));
+        return result;
+    }
+
+    // bounding spheres of chunks laid out like a loaded world, the camera turns around in the middle of it,
+    // the batched test has to give the same indices as one sphere at a time
+    ls::json::Value benchFrustumCullingSize(size_t numSpheres)
+    {
+        static constexpr int numPoses = 16;
+        static constexpr int numRepeats = 20;
+
+        const int width = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(numSpheres) / worldHeightInChunks)));
+        std::vector<ls::Sphere3F> spheres;
+        ls::SphereArray3F sphereArray;
+        sphereArray.reserve(numSpheres);
+        for (size_t i = 0; i < numSpheres; ++i)
+        {
+            const ls::Vec3I pos(static_cast<int>(i / worldHeightInChunks) % width - width / 2, static_cast<int>(i % worldHeightInChunks), static_cast<int>(i / worldHeightInChunks) / width - width / 2);
+            const ls::Vec3F chunkSize(static_cast<float>(MapChunk::width()), static_cast<float>(MapChunk::height()), static_cast<float>(MapChunk::depth()));
+            const ls::Sphere3F sphere((static_cast<ls::Vec3F>(pos) + ls::Vec3F(0.5f, 0.5f, 0.5f)) * chunkSize, chunkSize.length() / 2.0f);
+            spheres.push_back(sphere);
+            sphereArray.push_back(sphere);
+        }
+
+        ls::gl::Camera camera(cameraFov, cameraAspect);
+        camera.setNear(1.0f / 8.0f);
+        camera.setFar(1024.0f);
+        camera.setPosition(ls::Vec3F(0.0f, 140.0f, 0.0f));
+
+        StageStats perSphereStats("perSphere");
+        StageStats scalarStats("scalar");
+        StageStats vectorStats("vector");
+        std::vector<uint32_t> perSphereIndices(numSpheres);
+        std::vector<uint32_t> scalarIndices(numSpheres);
+        std::vector<uint32_t> vectorIndices(numSpheres);
+        uint64_t numVisible = 0;
+        bool isExact = true;
+        for (int i = 0; i < numPoses; ++i)
+        {
+            CameraPath::Pose pose{ camera.position(), 360.0f * i / numPoses, -10.0f };
+            pose.applyTo(camera);
+            ls::Frustum3F frustum = ls::Frustum3F::fromMatrix(camera.projectionMatrix() * camera.viewMatrix());
+            for (auto& p : frustum.planes)
+            {
+                p.normalize();
+            }
+
+            size_t numPerSphereVisible = 0;
+            size_t numScalarVisible = 0;
+            size_t numVectorVisible = 0;
+            for (int r = 0; r < numRepeats; ++r)
+            {
+                perSphereStats.measure([&]() {
+                    numPerSphereVisible = 0;
+                    for (size_t j = 0; j < spheres.size(); ++j)
+                    {
+                        if (MapRenderer::intersect(frustum, spheres[j])) perSphereIndices[numPerSphereVisible++] = static_cast<uint32_t>(j);
+                    }
+                });
+                scalarStats.measure([&]() { numScalarVisible = ls::cullSpheresScalar(frustum, sphereArray, scalarIndices.data()); });
+                vectorStats.measure([&]() { numVectorVisible = ls::cullSpheres(frustum, sphereArray, vectorIndices.data()); });
+            }
+
+            numVisible += numVectorVisible;
+            isExact = isExact
+                && numPerSphereVisible == numVectorVisible
+                && numScalarVisible == numVectorVisible
+                && std::equal(vectorIndices.begin(), vectorIndices.begin() + numVectorVisible, perSphereIndices.begin())
+                && std::equal(vectorIndices.begin(), vectorIndices.begin() + numVectorVisible, scalarIndices.begin());
+        }
+
+        auto nsPerSphere = [numSpheres](const StageStats& stats) { return stats.total() * 1000.0 / (static_cast<double>(numSpheres) * stats.samples.size()); };
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("spheres", ls::json::Value(static_cast<int64_t>(numSpheres)));
+        result.addMember("avgVisible", ls::json::Value(static_cast<double>(numVisible) / numPoses));
+        result.addMember("perSphereNsPerSphere", ls::json::Value(nsPerSphere(perSphereStats)));
+        result.addMember("scalarNsPerSphere", ls::json::Value(nsPerSphere(scalarStats)));
+        result.addMember("vectorNsPerSphere", ls::json::Value(nsPerSphere(vectorStats)));
+        result.addMember("speedup", ls::json::Value(vectorStats.total() > 0.0 ? perSphereStats.total() / vectorStats.total() : 0.0));
+        result.addMember("exact", ls::json::Value(isExact));
+        return result;
+    }
+
+    ls::json::Value benchFrustumCulling()
+    {
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("laneWidth", ls::json::Value(static_cast<int64_t>(ls::frustumCullingLaneWidth())));
+        result.addMember("spheres10k", benchFrustumCullingSize(10000));
+        result.addMember("spheres30k", benchFrustumCullingSize(30000));
+        result.addMember("spheres100k", benchFrustumCullingSize(100000));
+        return result;
+    }
+
+    // empty chunks of a loaded world around the origin are put both into the index and into a std::map,
+    // lookups come in a shuffled order like chunkAt calls during meshing and block updates,
+    // both containers have to find the same chunks
+    ls::json::Value benchChunkIndexRange(Map& map, int range)
+    {
+        static constexpr int numRepeats = 20;
+
+        const MapChunkNeighbours noNeighbours(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+        std::vector<ls::Vec3I> positions;
+        for (int x = -range; x <= range; ++x)
+        {
+            for (int z = -range; z <= range; ++z)
+            {
+                for (int y = 0; y < worldHeightInChunks; ++y)
+                {
+                    positions.emplace_back(x, y, z);
+                }
+            }
+        }
+
+        MapChunkIndex index;
+        std::map<ls::Vec3I, MapChunk> tree;
+        for (const auto& pos : positions)
+        {
+            index.emplace(MapChunk(map, pos, noNeighbours));
+            tree.emplace(pos, MapChunk(map, pos, noNeighbours));
+        }
+
+        std::vector<ls::Vec3I> lookups = positions;
+        std::shuffle(lookups.begin(), lookups.end(), std::mt19937(static_cast<uint32_t>(range)));
+
+        auto findInTree = [&tree](const ls::Vec3I& pos) -> const MapChunk* {
+            auto iter = tree.find(pos);
+            return iter != tree.end() ? &iter->second : nullptr;
+        };
+        const MapChunkIndex& constIndex = index;
+        auto findInIndex = [&constIndex](const ls::Vec3I& pos) { return constIndex.find(pos); };
+
+        // the sums only depend on which chunks are found, not on where they are stored
+        auto lookup = [&](auto& find) {
+            int64_t sum = 0;
+            for (const auto& pos : lookups)
+            {
+                const MapChunk* chunk = find(pos);
+                if (chunk != nullptr) sum += chunk->pos().x + chunk->pos().z;
+            }
+            return sum;
+        };
+        auto lookupNeighbours = [&](auto& find) {
+            int64_t numFound = 0;
+            for (const auto& pos : lookups)
+            {
+                for (const auto& side : CubeSide::values())
+                {
+                    numFound += find(pos + side.direction()) != nullptr ? 1 : 0;
+                }
+            }
+            return numFound;
+        };
+        auto iterate = [](const auto& chunks, auto&& chunkOf) {
+            int64_t sum = 0;
+            for (const auto& entry : chunks)
+            {
+                const MapChunk& chunk = chunkOf(entry);
+                sum += chunk.pos().x + chunk.pos().y + chunk.pos().z;
+            }
+            return sum;
+        };
+
+        StageStats treeLookup("mapLookup");
+        StageStats indexLookup("indexLookup");
+        StageStats treeNeighbours("mapNeighbours");
+        StageStats indexNeighbours("indexNeighbours");
+        StageStats treeIteration("mapIteration");
+        StageStats indexIteration("indexIteration");
+        bool isSame = index.size() == tree.size();
+        for (int r = 0; r < numRepeats; ++r)
+        {
+            int64_t treeSum = 0;
+            int64_t indexSum = 0;
+            treeLookup.measure([&]() { treeSum = lookup(findInTree); });
+            indexLookup.measure([&]() { indexSum = lookup(findInIndex); });
+            isSame = isSame && treeSum == indexSum;
+
+            treeNeighbours.measure([&]() { treeSum = lookupNeighbours(findInTree); });
+            indexNeighbours.measure([&]() { indexSum = lookupNeighbours(findInIndex); });
+            isSame = isSame && treeSum == indexSum;
+
+            treeIteration.measure([&]() { treeSum = iterate(tree, [](const auto& entry) -> const MapChunk& { return entry.second; }); });
+            indexIteration.measure([&]() { indexSum = iterate(constIndex, [](const MapChunk& chunk) -> const MapChunk& { return chunk; }); });
+            isSame = isSame && treeSum == indexSum;
+        }
+
+        auto nsPerChunk = [&positions](const StageStats& stats) { return stats.total() * 1000.0 / (static_cast<double>(positions.size()) * stats.samples.size()); };
+        auto speedup = [](const StageStats& treeStats, const StageStats& indexStats) { return indexStats.total() > 0.0 ? treeStats.total() / indexStats.total() : 0.0; };
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("chunks", ls::json::Value(static_cast<int64_t>(positions.size())));
+        for (const auto& [treeStats, indexStats] : { std::make_pair(&treeLookup, &indexLookup), std::make_pair(&treeNeighbours, &indexNeighbours), std::make_pair(&treeIteration, &indexIteration) })
+        {
+            result.addMember(treeStats->name + "NsPerChunk", ls::json::Value(nsPerChunk(*treeStats)));
+            result.addMember(indexStats->name + "NsPerChunk", ls::json::Value(nsPerChunk(*indexStats)));
+        }
+        result.addMember("lookupSpeedup", ls::json::Value(speedup(treeLookup, indexLookup)));
+        result.addMember("neighboursSpeedup", ls::json::Value(speedup(treeNeighbours, indexNeighbours)));
+        result.addMember("iterationSpeedup", ls::json::Value(speedup(treeIteration, indexIteration)));
+        result.addMember("same", ls::json::Value(isSame));
+        return result;
+    }
+
+    ls::json::Value benchChunkIndex(Map& map)
+    {
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("range14", benchChunkIndexRange(map, 14));
+        result.addMember("range20", benchChunkIndexRange(map, 20));
+        return result;
+    }
+
+    ls::json::Value generatorStatsToJson(const MapGenerator::Stats& stats)
+    {
+        const uint64_t numHeightmapRequests = stats.heightmaps.numHits + stats.heightmaps.numMisses;
+        const uint64_t numCaveSegmentRequests = stats.caveSegments.numHits + stats.caveSegments.numMisses;
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("generatedChunks", ls::json::Value(static_cast<int64_t>(stats.numGeneratedChunks)));
+        result.addMember("generationTimeUs", ls::json::Value(static_cast<int64_t>(stats.generationTimeUs)));
+        result.addMember("heightmapHits", ls::json::Value(static_cast<int64_t>(stats.heightmaps.numHits)));
+        result.addMember("heightmapMisses", ls::json::Value(static_cast<int64_t>(stats.heightmaps.numMisses)));
+        result.addMember("heightmapHitRate", ls::json::Value(numHeightmapRequests > 0 ? static_cast<double>(stats.heightmaps.numHits) / numHeightmapRequests : 0.0));
+        result.addMember("cachedColumns", ls::json::Value(static_cast<int64_t>(stats.heightmaps.numEntries)));
+        result.addMember("caveSegmentHits", ls::json::Value(static_cast<int64_t>(stats.caveSegments.numHits)));
+        result.addMember("caveSegmentMisses", ls::json::Value(static_cast<int64_t>(stats.caveSegments.numMisses)));
+        result.addMember("caveSegmentHitRate", ls::json::Value(numCaveSegmentRequests > 0 ? static_cast<double>(stats.caveSegments.numHits) / numCaveSegmentRequests : 0.0));
+        result.addMember("cachedCaveSegments", ls::json::Value(static_cast<int64_t>(stats.caveSegments.numEntries)));
+        return result;
+    }
+
+    // how the outside opacity was computed before the bit masks, kept as a reference:
+    // opacity of every block through a virtual call into a padded array, then six scattered reads per block
+    void computeNaiveOutsideOpacity(const MapChunkBlockStorage& blocks, ls::Array3<BlockSideOpacity>& outsideOpacity)
+    {
+        const int width = static_cast<int>(MapChunk::width());
+        const int height = static_cast<int>(MapChunk::height());
+        const int depth = static_cast<int>(MapChunk::depth());
+
+        // the border is opaque like the border planes of a chunk without neighbours
+        ls::Array3<BlockSideOpacity> blockOpacity(width + 2, height + 2, depth + 2, BlockSideOpacity::all());
+        for (int x = 0; x < width; ++x)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                for (int z = 0; z < depth; ++z)
+                {
+                    const auto& block = blocks.at(x, y, z);
+                    blockOpacity(x + 1, y + 1, z + 1) = block.isEmpty() ? BlockSideOpacity::none() : block.block().sideOpacity();
+                }
+            }
+        }
+
+        for (int x = 0; x < width; ++x)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                for (int z = 0; z < depth; ++z)
+                {
+                    BlockSideOpacity opacity;
+                    for (const auto& side : CubeSide::values())
+                    {
+                        const ls::Vec3I neighbourPos = ls::Vec3I(x + 1, y + 1, z + 1) + side.direction();
+                        // read as bool, assigning one bit reference to another would only rebind it
+                        const bool isOpaque = blockOpacity(neighbourPos.x, neighbourPos.y, neighbourPos.z)[side.opposite()];
+                        opacity[side] = isOpaque;
+                    }
+                    outsideOpacity(x, y, z) = opacity;
+                }
+            }
+        }
+    }
+
+    bool isSameOutsideOpacity(const ls::Array3<BlockSideOpacity>& outsideOpacity, const std::vector<MapChunk::OutsideOpacityRow>& rows)
+    {
+        for (size_t x = 0; x < MapChunk::width(); ++x)
+        {
+            for (size_t y = 0; y < MapChunk::height(); ++y)
+            {
+                const auto& row = rows[x * MapChunk::height() + y];
+                for (size_t z = 0; z < MapChunk::depth(); ++z)
+                {
+                    const BlockSideOpacity fromRow = MapChunk::outsideOpacityAt(row, static_cast<int>(z));
+                    for (const auto& side : CubeSide::values())
+                    {
+                        if (fromRow[side] != outsideOpacity(x, y, z)[side]) return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // every chunk is isolated, so faces on the chunk borders are treated as covered
+    ls::json::Value benchChunkGrid(Map& map, const std::string& regionDirectory)
+    {
+        MapGenerator generator(map);
+        const MapChunkNeighbours noNeighbours(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+        StageStats generate("generate");
+        StageStats opacity("opacity");
+        StageStats opacityNaive("opacityNaive");
+        StageStats opacityMasks("opacityMasks");
+        StageStats snapshot("snapshot");
+        StageStats meshPerFace("meshPerFace");
+        StageStats meshGreedy("meshGreedy");
+        StageStats regionSave("regionSave");
+        StageStats regionLoad("regionLoad");
+
+        std::vector<ls::Vec3I> positions;
+        for (int x = 0; x < gridSize; ++x)
+        {
+            for (int z = 0; z < gridSize; ++z)
+            {
+                for (int y = 0; y < worldHeightInChunks; ++y)
+                {
+                    positions.emplace_back(x, y, z);
+                }
+            }
+        }
+
+        ls::Array3<BlockSideOpacity> naiveOutsideOpacity(MapChunk::width(), MapChunk::height(), MapChunk::depth());
+        std::vector<MapChunk::OutsideOpacityRow> outsideOpacityRows(MapChunk::width() * MapChunk::height());
+        bool isOpacityExact = true;
+
+        {
+            MapRegionStorage regions(regionDirectory);
+            for (const auto& pos : positions)
+            {
+                MapChunkBlockData blockData(map, pos);
+                generate.measure([&]() { generator.generateChunk(blockData); });
+
+                std::unique_ptr<MapChunk> chunk;
+                opacity.measure([&]() { chunk = std::make_unique<MapChunk>(std::move(blockData), noNeighbours); });
+
+                // both go from the blocks to the outside opacity of every block
+                opacityNaive.measure([&]() { computeNaiveOutsideOpacity(chunk->blocks(), naiveOutsideOpacity); });
+                opacityMasks.measure([&]() {
+                    chunk->updateBlockOpacityMasks();
+                    for (size_t x = 0; x < MapChunk::width(); ++x)
+                    {
+                        for (size_t y = 0; y < MapChunk::height(); ++y)
+                        {
+                            outsideOpacityRows[x * MapChunk::height() + y] = chunk->outsideOpacityRow(static_cast<int>(x), static_cast<int>(y));
+                        }
+                    }
+                });
+                isOpacityExact = isOpacityExact && isSameOutsideOpacity(naiveOutsideOpacity, outsideOpacityRows);
+
+                std::unique_ptr<MapChunkSnapshot> chunkSnapshot;
+                snapshot.measure([&]() { chunkSnapshot = std::make_unique<MapChunkSnapshot>(*chunk); });
+
+                MapChunkRenderer::Mesh perFaceMesh;
+                meshPerFace.measure([&]() { MapChunkRenderer::buildMesh(*chunkSnapshot, MapChunkRenderer::MeshingMode::PerFace, perFaceMesh); });
+                meshPerFace.numFaces += numFaces(perFaceMesh);
+
+                MapChunkRenderer::Mesh greedyMesh;
+                meshGreedy.measure([&]() { MapChunkRenderer::buildMesh(*chunkSnapshot, MapChunkRenderer::MeshingMode::Greedy, greedyMesh); });
+                meshGreedy.numFaces += numFaces(greedyMesh);
+
+                regionSave.measure([&]() { regions.saveChunkAsync(pos, chunk->blocks()); });
+            }
+
+            // the writes are asynchronous, so waiting for them is a part of saving
+            regionSave.measure([&]() { regions.flush(); });
+        }
+
+        {
+            MapRegionStorage regions(regionDirectory);
+            for (const auto& pos : positions)
+            {
+                MapChunkBlockStorage blocks;
+                bool isLoaded = false;
+                regionLoad.measure([&]() { isLoaded = regions.tryLoadChunk(pos, blocks); });
+                if (!isLoaded)
+                {
+                    Logger::instance().log(Logger::Priority::Error, "Saved chunk was not found in the region files");
+                }
+            }
+        }
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("generator", generatorStatsToJson(generator.stats()));
+        for (auto* stage : { &generate, &opacity, &opacityNaive, &opacityMasks, &snapshot, &meshPerFace, &meshGreedy, &regionSave, &regionLoad })
+        {
+            stage->numChunks = positions.size();
+            result.addMember(stage->name, stage->toJson());
+        }
+        result.addMember("opacitySpeedup", ls::json::Value(opacityMasks.total() > 0.0 ? opacityNaive.total() / opacityMasks.total() : 0.0));
+        result.addMember("opacityExact", ls::json::Value(isOpacityExact));
+        return result;
+    }
+
+    ls::json::Value residencyStatsToJson(const MapResidency::Stats& stats)
+    {
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("chunks", ls::json::Value(static_cast<int64_t>(stats.numChunks)));
+        result.addMember("blocksBytes", ls::json::Value(static_cast<int64_t>(stats.resident.blocks)));
+        result.addMember("opacityBytes", ls::json::Value(static_cast<int64_t>(stats.resident.opacity)));
+        result.addMember("cpuMeshBytes", ls::json::Value(static_cast<int64_t>(stats.resident.cpuMesh)));
+        result.addMember("gpuMeshBytes", ls::json::Value(static_cast<int64_t>(stats.resident.gpuMesh)));
+        result.addMember("totalBytes", ls::json::Value(static_cast<int64_t>(stats.resident.total())));
+        result.addMember("budgetBytes", ls::json::Value(static_cast<int64_t>(stats.budget)));
+        result.addMember("evictedChunks", ls::json::Value(static_cast<int64_t>(stats.numEvictedChunks)));
+        return result;
+    }
+
+    ls::json::Value storageReserveStatsToJson(const MapChunkStorageReserve::Stats& stats)
+    {
+        const uint64_t numLoads = stats.numHits + stats.numMisses;
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("hits", ls::json::Value(static_cast<int64_t>(stats.numHits)));
+        result.addMember("misses", ls::json::Value(static_cast<int64_t>(stats.numMisses)));
+        result.addMember("hitRate", ls::json::Value(numLoads > 0 ? static_cast<double>(stats.numHits) / numLoads : 0.0));
+        result.addMember("stored", ls::json::Value(static_cast<int64_t>(stats.numStored)));
+        result.addMember("dropped", ls::json::Value(static_cast<int64_t>(stats.numDropped)));
+        result.addMember("trimmed", ls::json::Value(static_cast<int64_t>(stats.numTrimmed)));
+        result.addMember("retained", ls::json::Value(static_cast<int64_t>(stats.numRetained)));
+        result.addMember("maxRetained", ls::json::Value(static_cast<int64_t>(stats.maxRetained)));
+        result.addMember("bytesRetained", ls::json::Value(static_cast<int64_t>(stats.bytesRetained)));
+        return result;
+    }
+
+    ls::json::Value blockAllocationStatsToJson(const BlockAllocationCounters::Stats& stats, uint64_t numSteadyStateHeapAllocations)
+    {
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("allocations", ls::json::Value(static_cast<int64_t>(stats.numAllocations)));
+        result.addMember("deallocations", ls::json::Value(static_cast<int64_t>(stats.numDeallocations)));
+        result.addMember("heapAllocations", ls::json::Value(static_cast<int64_t>(stats.numHeapAllocations)));
+        result.addMember("steadyStateHeapAllocations", ls::json::Value(static_cast<int64_t>(numSteadyStateHeapAllocations)));
+        result.addMember("capacity", ls::json::Value(static_cast<int64_t>(stats.capacity)));
+        return result;
+    }
+
+    // replays the mesh allocations of the streamed chunks through the page layout of the arena, without GL
+    struct MeshArenaReplay
+    {
+        using RangeAllocator = MapChunkMeshArena::RangeAllocator;
+
+        MapChunkMeshArena::PageAllocator pages;
+        std::map<ls::Vec3I, MapChunkMeshArena::Allocation> meshes;
+        size_t peakPages = 0;
+        size_t peakUsedVertices = 0;
+        uint64_t numDroppedPages = 0;
+        double maxVertexFragmentation = 0.0;
+        double maxIndexFragmentation = 0.0;
+
+        void add(const ls::Vec3I& pos, const MapChunkRenderer::Mesh& mesh)
+        {
+            if (mesh.indices.empty()) return;
+
+            meshes.emplace(pos, pages.allocate(mesh.vertices.size(), mesh.indices.size()));
+            peakPages = std::max(peakPages, pages.numPages());
+            peakUsedVertices = std::max(peakUsedVertices, pages.vertexStats().numUsed);
+        }
+
+        void removeUnloaded(const Map& map)
+        {
+            std::set<ls::Vec3I> loaded;
+            for (const auto& chunk : map.chunks()) loaded.insert(chunk.pos());
+
+            for (auto iter = meshes.begin(); iter != meshes.end();)
+            {
+                if (loaded.count(iter->first) != 0)
+                {
+                    ++iter;
+                    continue;
+                }
+
+                if (pages.free(iter->second)) ++numDroppedPages;
+                iter = meshes.erase(iter);
+            }
+
+            maxVertexFragmentation = std::max(maxVertexFragmentation, pages.vertexStats().fragmentation());
+            maxIndexFragmentation = std::max(maxIndexFragmentation, pages.indexStats().fragmentation());
+        }
+
+        ls::json::Value toJson() const
+        {
+            const RangeAllocator::Stats vertexStats = pages.vertexStats();
+            const RangeAllocator::Stats indexStats = pages.indexStats();
+
+            ls::json::Value result(ls::json::Value::Object{});
+            result.addMember("meshes", ls::json::Value(static_cast<int64_t>(meshes.size())));
+            result.addMember("pages", ls::json::Value(static_cast<int64_t>(pages.numPages())));
+            result.addMember("peakPages", ls::json::Value(static_cast<int64_t>(peakPages)));
+            result.addMember("droppedPages", ls::json::Value(static_cast<int64_t>(numDroppedPages)));
+            result.addMember("usedVertexBytes", ls::json::Value(static_cast<int64_t>(vertexStats.numUsed * sizeof(BlockVertex))));
+            result.addMember("usedIndexBytes", ls::json::Value(static_cast<int64_t>(indexStats.numUsed * sizeof(uint32_t))));
+            result.addMember("peakUsedVertexBytes", ls::json::Value(static_cast<int64_t>(peakUsedVertices * sizeof(BlockVertex))));
+            result.addMember("vertexFreeRanges", ls::json::Value(static_cast<int64_t>(vertexStats.numFreeRanges)));
+            result.addMember("indexFreeRanges", ls::json::Value(static_cast<int64_t>(indexStats.numFreeRanges)));
+            result.addMember("vertexFragmentation", ls::json::Value(vertexStats.fragmentation()));
+            result.addMember("indexFragmentation", ls::json::Value(indexStats.fragmentation()));
+            result.addMember("maxVertexFragmentation", ls::json::Value(maxVertexFragmentation));
+            result.addMember("maxIndexFragmentation", ls::json::Value(maxIndexFragmentation));
+            return result;
+        }
+    };
+
+    // ticks are paced like in the game, chunks are meshed on the main thread once they appear
+    ls::json::Value benchStreaming(Map& map, int numTicks)
+    {
+        StageStats tick("tick");
+        StageStats mesh("mesh");
+
+        std::set<ls::Vec3I> meshedChunks;
+        MeshArenaReplay meshArena;
+        ls::Vec3F cameraPos(0.0f, cameraHeight, 0.0f);
+
+        // the first half fills the block pools
+        BlockAllocationCounters::Stats blockAllocationsAtHalf{};
+
+        const auto start = Clock::now();
+        auto nextTick = start;
+        for (int i = 0; i < numTicks; ++i)
+        {
+            if (i == numTicks / 2) blockAllocationsAtHalf = BlockAllocationCounters::instance().stats();
+
+            std::this_thread::sleep_until(nextTick);
+            nextTick += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(tickTime));
+
+            // goes straight for a while and then turns, so chunks are unloaded on one side
+            const bool isTurning = i >= numTicks / 2;
+            cameraPos += (isTurning ? ls::Vec3F(0.0f, 0.0f, 1.0f) : ls::Vec3F(1.0f, 0.0f, 0.0f)) * (cameraSpeed * tickTime);
+
+            tick.measure([&]() { map.update(cameraPos, tickTime); });
+            meshArena.removeUnloaded(map);
+
+            for (auto& chunk : map.chunks())
+            {
+                if (!meshedChunks.insert(chunk.pos()).second) continue;
+
+                MapChunkRenderer::Mesh chunkMesh;
+                mesh.measure([&]() {
+                    const MapChunkSnapshot snapshot(chunk);
+                    MapChunkRenderer::buildMesh(snapshot, MapChunkRenderer::meshingMode(), chunkMesh);
+                });
+                mesh.numFaces += numFaces(chunkMesh);
+                meshArena.add(chunk.pos(), chunkMesh);
+                ++mesh.numChunks;
+            }
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const BlockAllocationCounters::Stats blockAllocations = BlockAllocationCounters::instance().stats();
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("ticks", ls::json::Value(static_cast<int64_t>(numTicks)));
+        result.addMember("seconds", ls::json::Value(seconds));
+        result.addMember("chunksSpawned", ls::json::Value(static_cast<int64_t>(meshedChunks.size())));
+        result.addMember("chunksPerSec", ls::json::Value(seconds > 0.0 ? meshedChunks.size() / seconds : 0.0));
+        result.addMember("chunksLoaded", ls::json::Value(static_cast<int64_t>(map.chunks().size())));
+        result.addMember("generator", generatorStatsToJson(map.generator().stats()));
+        result.addMember("residency", residencyStatsToJson(map.residency().stats()));
+        result.addMember("storageReserve", storageReserveStatsToJson(MapChunkStorageReserve::instance().stats()));
+        result.addMember("statefulBlocks", blockAllocationStatsToJson(blockAllocations, blockAllocations.numHeapAllocations - blockAllocationsAtHalf.numHeapAllocations));
+        result.addMember("meshArena", meshArena.toJson());
+        result.addMember(tick.name, tick.toJson());
+        result.addMember(mesh.name, mesh.toJson());
+        return result;
+    }
+
+    // above the terrain looking around, then looking down at it, then in a cave of the default seed
+    CameraPath builtInCameraPath()
+    {
+        static constexpr float surfaceHeight = 140.0f;
+        static constexpr float caveHeight = 58.0f;
+
+        CameraPath path;
+        for (int i = 0; i < 72; ++i)
+        {
+            path.add(CameraPath::Pose{ ls::Vec3F(0.0f, surfaceHeight, 0.0f), i * 5.0f, 0.0f });
+        }
+        for (int i = 0; i < 36; ++i)
+        {
+            path.add(CameraPath::Pose{ ls::Vec3F(0.0f, surfaceHeight, 0.0f), i * 10.0f, -60.0f });
+        }
+        for (int i = 0; i < 72; ++i)
+        {
+            path.add(CameraPath::Pose{ ls::Vec3F(0.0f, caveHeight, 0.0f), i * 5.0f, i % 2 == 0 ? 0.0f : -30.0f });
+        }
+        return path;
+    }
+
+    // chunks are selected and culled like in MapRenderer::draw, the map is updated once per pose
+    ls::json::Value benchOcclusion(Map& map, const CameraPath& path)
+    {
+        // chunks around the first pose are loaded before it's measured
+        static constexpr int numWarmUpTicks = 100;
+
+        if (path.isEmpty()) return ls::json::Value(ls::json::Value::Object{});
+
+        StageStats frame("frame");
+        MapVisibilityFloodFill floodFill(renderDistance);
+        MapOcclusionCuller culler;
+        std::map<ls::Vec3I, size_t> meshVertices;
+        ls::gl::Camera camera(cameraFov, cameraAspect);
+        camera.setNear(1.0f / 8.0f);
+        camera.setFar(1024.0f);
+
+        uint64_t numInFrustum = 0;
+        uint64_t numReached = 0;
+        uint64_t numFloodFillVisits = 0;
+        uint64_t numOccluded = 0;
+        uint64_t numOccluders = 0;
+        uint64_t numOccluderFaces = 0;
+        uint64_t numUnreachedVertices = 0;
+        uint64_t numOccludedVertices = 0;
+        uint64_t numVisibleVertices = 0;
+        uint64_t floodFillTimeUs = 0;
+        uint64_t rasterizationTimeUs = 0;
+        uint64_t testTimeUs = 0;
+
+        auto nextTick = Clock::now();
+        for (int i = 0; i < numWarmUpTicks + static_cast<int>(path.poses().size()); ++i)
+        {
+            const CameraPath::Pose& pose = path.poses()[std::max(i - numWarmUpTicks, 0)];
+
+            std::this_thread::sleep_until(nextTick);
+            nextTick += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(tickTime));
+            map.update(pose.position, tickTime);
+            if (i < numWarmUpTicks) continue;
+
+            pose.applyTo(camera);
+            const ls::Matrix4x4F viewProjection = camera.projectionMatrix() * camera.viewMatrix();
+            ls::Frustum3F frustum = ls::Frustum3F::fromMatrix(viewProjection);
+            for (auto& p : frustum.planes)
+            {
+                p.normalize();
+            }
+            const ls::Vec3I cameraChunk = map.worldToChunk(camera.position());
+
+            std::vector<const MapChunk*> chunksInFrustum;
+            std::vector<const MapChunk*> unreachedChunks;
+            std::vector<const MapChunk*> occludedChunks;
+            frame.measure([&]() {
+                floodFill.beginFrame(cameraChunk);
+                culler.beginFrame(camera.position(), viewProjection);
+                for (const auto& chunk : map.chunks())
+                {
+                    const int dist = Map::distanceBetweenChunks(cameraChunk, chunk.pos());
+                    if (dist > renderDistance || !MapRenderer::intersect(frustum, chunk.boundingSphere())) continue;
+
+                    chunksInFrustum.emplace_back(&chunk);
+                    floodFill.addChunk(chunk);
+                    if (dist <= MapOcclusionCuller::maxOccluderDistance)
+                    {
+                        culler.addOccluder(chunk);
+                    }
+                }
+                floodFill.run(frustum);
+                culler.finishOccluders();
+
+                for (const MapChunk* chunk : chunksInFrustum)
+                {
+                    if (!floodFill.isReached(*chunk)) unreachedChunks.emplace_back(chunk);
+                    else if (culler.isOccluded(*chunk)) occludedChunks.emplace_back(chunk);
+                }
+            });
+
+            // what the culling saves, the meshes are built only for that and once per chunk
+            for (const MapChunk* chunk : chunksInFrustum)
+            {
+                auto iter = meshVertices.find(chunk->pos());
+                if (iter == meshVertices.end())
+                {
+                    MapChunkRenderer::Mesh chunkMesh;
+                    MapChunkRenderer::buildMesh(MapChunkSnapshot(*chunk), MapChunkRenderer::meshingMode(), chunkMesh);
+                    iter = meshVertices.emplace(chunk->pos(), chunkMesh.vertices.size()).first;
+                }
+
+                const bool isUnreached = std::find(unreachedChunks.begin(), unreachedChunks.end(), chunk) != unreachedChunks.end();
+                const bool isOccluded = std::find(occludedChunks.begin(), occludedChunks.end(), chunk) != occludedChunks.end();
+                (isUnreached ? numUnreachedVertices : isOccluded ? numOccludedVertices : numVisibleVertices) += iter->second;
+            }
+
+            const MapVisibilityFloodFill::Stats& floodFillStats = floodFill.stats();
+            numInFrustum += floodFillStats.numCandidates;
+            numReached += floodFillStats.numReached;
+            numFloodFillVisits += floodFillStats.numVisits;
+            floodFillTimeUs += floodFillStats.timeUs;
+
+            const MapOcclusionCuller::Stats stats = culler.stats();
+            numOccluded += stats.numOccluded;
+            numOccluders += stats.numOccluders;
+            numOccluderFaces += stats.numOccluderFaces;
+            rasterizationTimeUs += stats.rasterizationTimeUs;
+            testTimeUs += stats.testTimeUs;
+        }
+
+        const size_t numPoses = std::max<size_t>(path.poses().size(), 1);
+
+        ls::json::Value result(ls::json::Value::Object{});
+        result.addMember("poses", ls::json::Value(static_cast<int64_t>(path.poses().size())));
+        result.addMember("avgChunksInFrustum", ls::json::Value(static_cast<double>(numInFrustum) / numPoses));
+        result.addMember("avgReachedChunks", ls::json::Value(static_cast<double>(numReached) / numPoses));
+        result.addMember("unreachedFraction", ls::json::Value(numInFrustum > 0 ? static_cast<double>(numInFrustum - numReached) / numInFrustum : 0.0));
+        result.addMember("avgOccludedChunks", ls::json::Value(static_cast<double>(numOccluded) / numPoses));
+        result.addMember("occludedFraction", ls::json::Value(numInFrustum > 0 ? static_cast<double>(numOccluded) / numInFrustum : 0.0));
+        result.addMember("avgOccluders", ls::json::Value(static_cast<double>(numOccluders) / numPoses));
+        result.addMember("avgOccluderFaces", ls::json::Value(static_cast<double>(numOccluderFaces) / numPoses));
+        result.addMember("avgVisibleVertices", ls::json::Value(static_cast<double>(numVisibleVertices) / numPoses));
+        result.addMember("avgUnreachedVertices", ls::json::Value(static_cast<double>(numUnreachedVertices) / numPoses));
+        result.addMember("avgOccludedVertices", ls::json::Value(static_cast<double>(numOccludedVertices) / numPoses));
+        result.addMember("avgFloodFillVisits", ls::json::Value(static_cast<double>(numFloodFillVisits) / numPoses));
+        result.addMember("avgFloodFillUs", ls::json::Value(static_cast<double>(floodFillTimeUs) / numPoses));
+        result.addMember("avgRasterizationUs", ls::json::Value(static_cast<double>(rasterizationTimeUs) / numPoses));
+        result.addMember("avgTestUs", ls::json::Value(static_cast<double>(testTimeUs) / numPoses));
+        result.addMember(frame.name, frame.toJson());
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // stdout is reserved for the results
+    Logger::instance().setOutput(std::cerr);
+
+    const uint32_t seed = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 321412u;
+    const int numTicks = argc > 2 ? std::atoi(argv[2]) : 400;
+    // only the streaming is limited, zero keeps the default
+    const size_t memoryBudgetMiB = argc > 3 ? static_cast<size_t>(std::strtoull(argv[3], nullptr, 10)) : 0;
+    const CameraPath cameraPath = argc > 4 ? CameraPath::load(argv[4]) : builtInCameraPath();
+
+    GameResourceLoader::loadBlocks();
+
+    // nothing from the game's saves is loaded, and nothing is left behind
+    const std::filesystem::path saveDirectory = std::filesystem::temp_directory_path() / ("voxel_bench_" + std::to_string(seed));
+    std::filesystem::remove_all(saveDirectory);
+
+    ls::json::Document results = ls::json::Document::emptyObject();
+    results.addMember("seed", ls::json::Value(static_cast<int64_t>(seed)));
+    results.addMember("threads", ls::json::Value(static_cast<int64_t>(ThreadPool::instance().numThreads())));
+    results.addMember("noise", benchNoise(seed));
+    results.addMember("frustumCulling", benchFrustumCulling());
+    {
+        Map map(seed, (saveDirectory / "map").string());
+        results.addMember("grid", benchChunkGrid(map, (saveDirectory / "regions").string()));
+    }
+    {
+        Map map(seed, (saveDirectory / "map").string());
+        results.addMember("chunkIndex", benchChunkIndex(map));
+    }
+    {
+        Map map(seed, (saveDirectory / "map").string());
+        if (memoryBudgetMiB > 0) map.setMemoryBudget(memoryBudgetMiB << 20);
+        results.addMember("streaming", benchStreaming(map, numTicks));
+    }
+    {
+        Map map(seed, (saveDirectory / "map").string());
+        results.addMember("occlusion", benchOcclusion(map, cameraPath));
+    }
+    std::filesystem::remove_all(saveDirectory);
+    results.addMember("peakRssBytes", ls::json::Value(static_cast<int64_t>(peakResidentSetSize())));
+
+    std::cout << results.stringify() << '\n';
+}